@@ -0,0 +1,366 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014  S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <thread>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <cctype>
+#include <sys/resource.h>
+#include "clsASM.h"
+#include "DataGenerators/clsIncrementalSequenceGenerator.hpp"
+#include "DataGenerators/clsFlashCardGenerator.hpp"
+#include "DataGenerators/clsZipfianGenerator.hpp"
+#include "DataGenerators/clsRandomWalkGenerator.hpp"
+
+using namespace AdaptiveSequenceMemorizer;
+
+/// Endless generators are split to sequences of this length by NULL inputs
+static const size_t SEQUENCE_LENGTH = 16;
+
+/**
+ * @brief The stuRecord struct is a single result line: a workload run and it's measured metrics
+ */
+struct stuRecord{
+    std::string                                   Workload;
+    ColID_t                                       Alphabet;
+    size_t                                        Steps;
+    unsigned                                      Threads;
+    std::vector<std::pair<std::string, double> >  Metrics;
+};
+
+static std::vector<stuRecord> Records;
+
+/**
+ * @brief peakResidentMemory returns peak resident set size of the process in bytes. As workloads are run
+ * one after the other it is the peak of all the workloads run so far.
+ */
+static size_t peakResidentMemory()
+{
+    struct rusage Usage;
+    getrusage(RUSAGE_SELF, &Usage);
+    return (size_t)Usage.ru_maxrss * 1024;
+}
+
+/**
+ * @brief benchConfigs returns the default configs scaled down on builds which can not store them
+ * (ASM_PERMANENCE_BITS=8) so all the builds can be benchmarked
+ */
+static clsASM::Configs benchConfigs(bool _concurrentLearning = false)
+{
+    Permanence_t Scale = clsASM::maxPermanence() < 500 ? 5 : 1;
+    return clsASM::Configs(500 / Scale, 300 / Scale, 50 / Scale, 1, false, _concurrentLearning);
+}
+
+static double secondsSince(const std::chrono::steady_clock::time_point& _start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+}
+
+/**
+ * @brief fileSize returns size of the file in bytes or zero if it can not be read
+ */
+static size_t fileSize(const char* _filePath)
+{
+    std::ifstream File(_filePath, std::ios::binary | std::ios::ate);
+    std::streamoff Size = File.tellg();
+    return Size > 0 ? (size_t)Size : 0;
+}
+
+/**
+ * @brief percentile returns _p-th percentile of the samples. Samples will be reordered
+ */
+static double percentile(std::vector<uint32_t>& _samples, double _p)
+{
+    if (_samples.empty())
+        return 0;
+    size_t Index = std::min(_samples.size() - 1, (size_t)(_p * _samples.size()));
+    std::nth_element(_samples.begin(), _samples.begin() + Index, _samples.end());
+    return _samples[Index];
+}
+
+/**
+ * @brief The clsWorkload class makes a reproducible input stream from a generator. Generators are created
+ * again after a NULL input when they reach their end so all the workloads are endless. NULL input is also
+ * inserted after each SEQUENCE_LENGTH inputs of endless generators.
+ */
+class clsWorkload
+{
+public:
+    clsWorkload(const std::string& _name, ColID_t _alphabet){
+        this->Name = _name;
+        this->Alphabet = _alphabet;
+        this->restart();
+    }
+
+    void restart(){
+        this->Random.seed(this->Alphabet);
+        this->Step = 0;
+        std::vector<ColID_t> Inputs;
+        if (this->Name == "incremental"){
+            for (size_t i = 0; i < 64; ++i)
+                Inputs.push_back(1 + this->Random() % this->Alphabet);
+            this->Factory = [Inputs](){ return new clsIncrementalSequenceGenerator(Inputs); };
+        }else if (this->Name == "flashcard"){
+            for (size_t i = 0; i < 256; ++i)
+                Inputs.push_back(1 + this->Random() % this->Alphabet);
+            this->Factory = [Inputs](){ return new clsFlashCardGenerator(Inputs, 2); };
+        }else if (this->Name == "zipf"){
+            ColID_t Alphabet = this->Alphabet;
+            this->Factory = [Alphabet](){ return new clsZipfianGenerator(Alphabet, 1.1, Alphabet); };
+        }else if (this->Name == "randomwalk"){
+            ColID_t Alphabet = this->Alphabet;
+            this->Factory = [Alphabet](){ return new clsRandomWalkGenerator(Alphabet, 8, Alphabet); };
+        }else
+            this->Factory = NULL;
+        this->Generator.reset(this->Factory ? this->Factory() : NULL);
+    }
+
+    inline ColID_t next(){
+        this->Step++;
+        if (this->Name == "incremental"){
+            ColID_t Input = this->Generator->next();
+            if (Input != NOT_ASSIGNED)
+                return Input;
+            this->Generator.reset(this->Factory());
+            return 0;
+        }
+        if (this->Step % SEQUENCE_LENGTH == 0)
+            return 0;
+        return this->Generator ? this->Generator->next() : 1 + this->Random() % this->Alphabet;
+    }
+
+private:
+    std::string                          Name;
+    ColID_t                              Alphabet;
+    size_t                               Step;
+    std::mt19937                         Random;
+    std::function<intfInputIterator*()>  Factory;
+    std::unique_ptr<intfInputIterator>   Generator;
+};
+
+/**
+ * @brief runTimed executes _steps inputs of the workload and records steps per second and executeOnce latency
+ * percentiles prefixed by _phase
+ */
+static void runTimed(clsASM& _asm, clsWorkload& _workload, size_t _steps,
+                     clsASM::enuLearningLevel _learningLevel, const std::string& _phase, stuRecord& _record)
+{
+    std::vector<uint32_t> Latencies(_steps);
+    size_t Predictions = 0;
+    auto Start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < _steps; ++i){
+        ColID_t Input = _workload.next();
+        auto StepStart = std::chrono::steady_clock::now();
+        Predictions += _asm.executeOnce(Input, NULL, 0, _learningLevel);
+        Latencies[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - StepStart).count();
+    }
+    double Seconds = secondsSince(Start);
+
+    _record.Metrics.push_back(std::make_pair(_phase + "_steps_per_sec", _steps / Seconds));
+    _record.Metrics.push_back(std::make_pair(_phase + "_p50_ns", percentile(Latencies, 0.5)));
+    _record.Metrics.push_back(std::make_pair(_phase + "_p99_ns", percentile(Latencies, 0.99)));
+    _record.Metrics.push_back(std::make_pair(_phase + "_p999_ns", percentile(Latencies, 0.999)));
+    _record.Metrics.push_back(std::make_pair(_phase + "_predictions_per_step", (double)Predictions / _steps));
+}
+
+/**
+ * @brief benchWorkload learns a workload, infers the same stream on the frozen model and measures save and
+ * load throughput of the learnt model in all the formats
+ */
+static void benchWorkload(const std::string& _name, ColID_t _alphabet, size_t _steps)
+{
+    stuRecord Record = {_name, _alphabet, _steps, 1, {}};
+    clsWorkload Workload(_name, _alphabet);
+    clsASM ASM(benchConfigs());
+
+    runTimed(ASM, Workload, _steps, clsASM::LearningFull, "learn", Record);
+    clsASM::Stats Stats = ASM.stats();
+    Record.Metrics.push_back(std::make_pair("cells", Stats.Cells));
+    Record.Metrics.push_back(std::make_pair("pool_bytes", Stats.PoolBytes));
+
+    Workload.restart();
+    runTimed(ASM, Workload, _steps, clsASM::LearningFrozen, "infer", Record);
+
+    struct { const char* Name; const char* FilePath; clsASM::enuFileFormat Format; } Formats[] = {
+        {"text",   "bench_model.txt", clsASM::FormatText},
+        {"binary", "bench_model.bin", clsASM::FormatBinary},
+    };
+    //Metrics of failed saves and loads are skipped so they are not reported as measured
+    for (auto& Format : Formats){
+        auto Start = std::chrono::steady_clock::now();
+        bool Saved = ASM.save(Format.FilePath, Format.Format);
+        double SaveSeconds = secondsSince(Start);
+        size_t FileBytes = Saved ? fileSize(Format.FilePath) : 0;
+        if (FileBytes == 0){
+            std::cerr<<"Unable to save "<<Format.Name<<" model of "<<_name<<" workload"<<std::endl;
+            continue;
+        }
+        double FileMB = FileBytes / (1024.0 * 1024.0);
+        Record.Metrics.push_back(std::make_pair(std::string(Format.Name) + "_mb", FileMB));
+        Record.Metrics.push_back(std::make_pair(std::string("save_") + Format.Name + "_mb_per_sec", FileMB / SaveSeconds));
+
+        clsASM Loaded(benchConfigs());
+        Start = std::chrono::steady_clock::now();
+        if (Loaded.load(Format.FilePath))
+            Record.Metrics.push_back(std::make_pair(std::string("load_") + Format.Name + "_mb_per_sec",
+                                                    FileMB / secondsSince(Start)));
+        else
+            std::cerr<<"Unable to load "<<Format.Name<<" model of "<<_name<<" workload"<<std::endl;
+    }
+
+    clsASM Mapped(benchConfigs());
+    auto Start = std::chrono::steady_clock::now();
+    if (fileSize(Formats[1].FilePath) && Mapped.load(Formats[1].FilePath, false, clsASM::LoadMapped))
+        Record.Metrics.push_back(std::make_pair("map_binary_ms", secondsSince(Start) * 1000));
+    else
+        std::cerr<<"Unable to map binary model of "<<_name<<" workload"<<std::endl;
+
+    for (auto& Format : Formats)
+        std::remove(Format.FilePath);
+    Record.Metrics.push_back(std::make_pair("peak_rss_bytes", peakResidentMemory()));
+    Records.push_back(Record);
+}
+
+/**
+ * @brief benchConcurrentLearning Learns independent uniform random streams on a shared model using 1 to
+ * _maxThreads threads (each one with it's own session) and records learned steps per second
+ */
+static void benchConcurrentLearning(ColID_t _alphabet, size_t _steps, unsigned _maxThreads)
+{
+    for (unsigned Threads = 1; Threads <= _maxThreads; Threads *= 2){
+        clsASM ASM(benchConfigs(true));
+        std::vector<std::thread> Workers;
+        auto Start = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < Threads; ++i)
+            Workers.push_back(std::thread([&ASM, _alphabet, _steps, Threads, i](){
+                std::mt19937 Random(_alphabet + i);
+                clsASM::Session Session;
+                for (size_t Step = 0; Step < _steps / Threads; ++Step)
+                    ASM.executeOnce(Session, Step % SEQUENCE_LENGTH ? 1 + Random() % _alphabet : 0, NULL, 0);
+            }));
+        for (auto WorkerIter = Workers.begin(); WorkerIter != Workers.end(); WorkerIter++)
+            WorkerIter->join();
+        double Seconds = secondsSince(Start);
+
+        stuRecord Record = {"concurrent", _alphabet, _steps / Threads * Threads, Threads, {}};
+        Record.Metrics.push_back(std::make_pair("learn_steps_per_sec", (_steps / Threads * Threads) / Seconds));
+        Record.Metrics.push_back(std::make_pair("peak_rss_bytes", peakResidentMemory()));
+        Records.push_back(Record);
+    }
+}
+
+static void printJSON()
+{
+    std::cout<<"["<<std::endl;
+    for (size_t i = 0; i < Records.size(); ++i){
+        std::cout<<"  {\"workload\":\""<<Records[i].Workload<<"\""<<
+                   ",\"alphabet\":"<<Records[i].Alphabet<<
+                   ",\"steps\":"<<Records[i].Steps<<
+                   ",\"threads\":"<<Records[i].Threads;
+        for (auto& Metric : Records[i].Metrics)
+            std::cout<<",\""<<Metric.first<<"\":"<<Metric.second;
+        std::cout<<"}"<<(i + 1 < Records.size() ? "," : "")<<std::endl;
+    }
+    std::cout<<"]"<<std::endl;
+}
+
+/**
+ * @brief printCSV prints one metric per line so records with different metrics share the same columns
+ */
+static void printCSV()
+{
+    std::cout<<"workload,alphabet,steps,threads,metric,value"<<std::endl;
+    for (auto& Record : Records)
+        for (auto& Metric : Record.Metrics)
+            std::cout<<Record.Workload<<","<<
+                       Record.Alphabet<<","<<
+                       Record.Steps<<","<<
+                       Record.Threads<<","<<
+                       Metric.first<<","<<
+                       Metric.second<<std::endl;
+}
+
+/**
+ * @brief parseCount parses a decimal count not less than @see _min
+ * @return false if @see _arg is not such a number
+ */
+static bool parseCount(const char* _arg, unsigned long _min, unsigned long& _value)
+{
+    char* End;
+    errno = 0;
+    _value = std::strtoul(_arg, &End, 10);
+    return isdigit((unsigned char)_arg[0]) && *End == '\0' && errno == 0 && _value >= _min;
+}
+
+static int usage(const char* _program)
+{
+    std::cerr<<"Usage: "<<_program<<" [Steps] [MaxThreads] [csv|json]"<<std::endl<<
+               "  Steps       inputs learnt by the largest models, at least 10 (default: 200000)"<<std::endl<<
+               "  MaxThreads  greatest number of threads of concurrent learning (default: hardware threads)"<<std::endl;
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned long Steps = 200000;
+    unsigned long MaxThreads = std::max(1U, std::thread::hardware_concurrency());
+    if (argc > 4 ||
+        (argc > 1 && parseCount(argv[1], 10, Steps) == false) ||
+        (argc > 2 && parseCount(argv[2], 1, MaxThreads) == false) ||
+        (argc > 3 && strcmp(argv[3], "csv") && strcmp(argv[3], "json")))
+        return usage(argv[0]);
+    bool CSV = argc > 3 && strcmp(argv[3], "csv") == 0;
+
+    const char* Workloads[] = {"uniform", "zipf", "randomwalk", "flashcard", "incremental"};
+    //Alphabets are limited to ColIDs which can be stored on cells of this build (ASM_COLID_BITS)
+    std::vector<ColID_t> Alphabets;
+    for (ColID_t Alphabet : {1024, 65536})
+        if (Alphabets.empty() || Alphabets.back() < std::min(Alphabet, clsASM::maxColID()))
+            Alphabets.push_back(std::min(Alphabet, clsASM::maxColID()));
+
+    //Each workload is learnt on two model sizes
+    for (size_t ModelSteps : {Steps / 10, Steps})
+        for (ColID_t Alphabet : Alphabets)
+            for (const char* Workload : Workloads)
+                benchWorkload(Workload, Alphabet, ModelSteps);
+    benchConcurrentLearning(Alphabets.back(), Steps, MaxThreads);
+
+    std::cout<<std::setprecision(10);
+    if (CSV)
+        printCSV();
+    else
+        printJSON();
+    return 0;
+}
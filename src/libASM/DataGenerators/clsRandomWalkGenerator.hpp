@@ -0,0 +1,59 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014  S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ */
+
+#include "clsASM.h"
+#include <random>
+
+namespace AdaptiveSequenceMemorizer {
+
+/**
+ * @brief The clsRandomWalkGenerator class generates an endless stream of input IDs in [1, _alphabet] where
+ * each ID is at most _maxStep away from the previous one wrapping around the alphabet boundaries. This models
+ * slowly drifting streams (e.g. quantized sensor values) where neighbouring transitions repeat often.
+ * Stream is reproducible for the same seed.
+ */
+class clsRandomWalkGenerator : public intfInputIterator
+{
+public:
+
+    clsRandomWalkGenerator(ColID_t _alphabet, ColID_t _maxStep = 1, uint32_t _seed = 1) :
+        Random(_seed)
+    {
+        this->Alphabet = _alphabet;
+        this->MaxStep = _maxStep;
+        this->Position = this->Random() % _alphabet;
+    }
+
+    ColID_t next(){
+        int64_t Step = std::uniform_int_distribution<int64_t>(-(int64_t)this->MaxStep, this->MaxStep)(this->Random);
+        this->Position = (ColID_t)(((int64_t)this->Position + Step % this->Alphabet + this->Alphabet) % this->Alphabet);
+        return this->Position + 1;
+    }
+
+private:
+    ColID_t      Alphabet;
+    ColID_t      MaxStep;
+    ColID_t      Position;
+    std::mt19937 Random;
+};
+
+}
@@ -0,0 +1,62 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014  S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ */
+
+#include "clsASM.h"
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+namespace AdaptiveSequenceMemorizer {
+
+/**
+ * @brief The clsZipfianGenerator class generates an endless stream of input IDs in [1, _alphabet] where
+ * probability of the k-th ID is proportional to 1/k^_exponent. This models real world streams in which few
+ * inputs are very frequent and most of them are rare. Stream is reproducible for the same seed.
+ */
+class clsZipfianGenerator : public intfInputIterator
+{
+public:
+
+    clsZipfianGenerator(ColID_t _alphabet, double _exponent = 1.0, uint32_t _seed = 1) :
+        Random(_seed)
+    {
+        this->CDF.resize(_alphabet);
+        double Sum = 0;
+        for (ColID_t i = 0; i < _alphabet; ++i)
+            this->CDF[i] = (Sum += 1.0 / std::pow(i + 1, _exponent));
+        for (ColID_t i = 0; i < _alphabet; ++i)
+            this->CDF[i] /= Sum;
+    }
+
+    ColID_t next(){
+        double Value = std::uniform_real_distribution<double>(0, 1)(this->Random);
+        size_t Rank = std::lower_bound(this->CDF.begin(), this->CDF.end(), Value) - this->CDF.begin();
+        return (ColID_t)(Rank < this->CDF.size() ? Rank : this->CDF.size() - 1) + 1;
+    }
+
+private:
+    std::vector<double> CDF;
+    std::mt19937        Random;
+};
+
+}
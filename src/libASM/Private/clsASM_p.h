@@ -24,13 +24,198 @@
 #define CLSASM_P_H
 
 #include <list>
+#include <stdexcept>
+#include <memory>
+#include <string>
+#include <algorithm>
 #include <vector>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <chrono>
 #include "clsASM.h"
 #include "clsCell.h"
+#include "clsCellPool.h"
+#include "clsSnapshot.h"
+#include "clsJournal.h"
+#include "clsWAL.h"
+#include "clsColumnDirectory.h"
+#include "clsStats.h"
 
 namespace AdaptiveSequenceMemorizer {
 
-typedef std::vector<clsCell*> clsColumn;
+class clsFrozenASMPrivate;
+
+/**
+ * @brief The clsSessionPrivate class keeps state of a single input stream on the model. Prediction state is
+ * kept just in the session (and not on the cells) so sessions never write to the shared model while predicting.
+ * Cells are referenced by their global index which is the same for in-memory and mapped models.
+ */
+class clsSessionPrivate
+{
+public:
+    struct stuPredictedCell{
+        ColID_t     ColID;
+        CellIndex_t Index;
+
+        stuPredictedCell(ColID_t _colID, CellIndex_t _index) :
+            ColID(_colID), Index(_index)
+        {}
+    };
+
+    /**
+     * @brief The stuAheadNode struct is a step of a path expanded by predictAhead. Parent is the index of the
+     * previous step in the node buffer
+     */
+    struct stuAheadNode{
+        CellIndex_t Cell;
+        uint32_t    Parent;
+        uint32_t    Depth;
+        ColID_t     ColID;
+        uint64_t    SumPermanence;
+    };
+
+public:
+    clsSessionPrivate(){
+        this->Generation = 0;
+        this->CompactionEpoch = 0;
+        this->WALEpoch = 0;
+        this->WALSessionID = 0;
+        this->restart();
+    }
+
+    /**
+     * @brief restart clears sequence history as if a NULL input has been seen
+     */
+    inline void restart(){
+        this->LastLearningCell = INVALID_CELL_INDEX;
+        this->PredictedCells.clear();
+        this->PredictedCols.clear();
+        this->PredictionListStale = true;
+        this->FirstPattern = true;
+        this->LastActiveColumn = 0;
+        this->PathItems = 0;
+        this->SumPathPermanence = 0;
+    }
+
+    /**
+     * @brief predictedCell returns predicted cell on the specified column with least ZIndex or NULL if
+     * column has not been predicted. Cells of a column are kept in pool order so it has the least index too.
+     * @param _isLive filters out predicted cells which have been removed since they were predicted
+     */
+    template <typename Fn_t>
+    inline const stuPredictedCell* predictedCell(ColID_t _colID, Fn_t _isLive) const{
+        const stuPredictedCell* Predicted = NULL;
+        for(auto CellIter = this->PredictedCells.begin();
+            CellIter != this->PredictedCells.end();
+            CellIter ++)
+            if (CellIter->ColID == _colID && (Predicted == NULL || CellIter->Index < Predicted->Index) &&
+                    _isLive(CellIter->Index))
+                Predicted = &*CellIter;
+        return Predicted;
+    }
+
+    inline const stuPredictedCell* predictedCell(ColID_t _colID) const{
+        return this->predictedCell(_colID, [](CellIndex_t){ return true; });
+    }
+
+    /**
+     * @brief predictionList returns predictions as a list for the list based API. The list is rebuilt just
+     * when predictions have changed and it's nodes are recycled so it allocates only when it grows.
+     */
+    inline const clsASM::Prediction_t& predictionList(){
+        if (this->PredictionListStale == false)
+            return this->PredictionList;
+
+        auto PredIter = this->PredictedCols.begin();
+        auto ListIter = this->PredictionList.begin();
+        for (; PredIter != this->PredictedCols.end() && ListIter != this->PredictionList.end(); ++PredIter, ++ListIter)
+            *ListIter = *PredIter;
+        this->SpareListNodes.splice(this->SpareListNodes.end(), this->PredictionList, ListIter, this->PredictionList.end());
+        for (; PredIter != this->PredictedCols.end(); ++PredIter){
+            if (this->SpareListNodes.empty())
+                this->PredictionList.push_back(*PredIter);
+            else{
+                this->PredictionList.splice(this->PredictionList.end(), this->SpareListNodes, this->SpareListNodes.begin());
+                this->PredictionList.back() = *PredIter;
+            }
+        }
+        this->PredictionListStale = false;
+        return this->PredictionList;
+    }
+
+    /**
+     * @brief addPrediction adds a prediction of the current step. When @see _maxPredictions is set predictions
+     * are kept as a heap whose root is the worst kept one so each prediction costs at most log(_maxPredictions)
+     */
+    inline void addPrediction(const clsASM::stuPrediction& _prediction, uint32_t _maxPredictions){
+        if (_maxPredictions == 0)
+            this->PredictedCols.push_back(_prediction);
+        else if (this->PredictedCols.size() < _maxPredictions){
+            this->PredictedCols.push_back(_prediction);
+            std::push_heap(this->PredictedCols.begin(), this->PredictedCols.end(), isBetterPrediction);
+        }else if (isBetterPrediction(_prediction, this->PredictedCols.front())){
+            std::pop_heap(this->PredictedCols.begin(), this->PredictedCols.end(), isBetterPrediction);
+            this->PredictedCols.back() = _prediction;
+            std::push_heap(this->PredictedCols.begin(), this->PredictedCols.end(), isBetterPrediction);
+        }
+    }
+
+    /**
+     * @brief rankPredictions orders predictions kept by addPrediction when they are bounded
+     */
+    inline void rankPredictions(uint32_t _maxPredictions){
+        if (_maxPredictions)
+            std::sort(this->PredictedCols.begin(), this->PredictedCols.end(), isBetterPrediction);
+    }
+
+    static inline bool isBetterPrediction(const clsASM::stuPrediction& _first,
+                                          const clsASM::stuPrediction& _second){
+        return _first.PathPermanence > _second.PathPermanence ||
+                (_first.PathPermanence == _second.PathPermanence && _first.ColID < _second.ColID);
+    }
+
+    inline clsASM::PredictionSpan predictionSpan() const{
+        return clsASM::PredictionSpan(this->PredictedCols.data(), this->PredictedCols.size());
+    }
+
+    /**
+     * @brief copyPredictions copies up to _capacity predictions to _output
+     * @return number of predictions
+     */
+    inline size_t copyPredictions(clsASM::stuPrediction* _output, size_t _capacity) const{
+        std::copy(this->PredictedCols.begin(),
+                  this->PredictedCols.begin() + std::min(_capacity, this->PredictedCols.size()),
+                  _output);
+        return this->PredictedCols.size();
+    }
+
+public:
+    CellIndex_t                        LastLearningCell;
+    ColID_t                            LastActiveColumn;
+    bool                               FirstPattern;
+    std::vector<stuPredictedCell>      PredictedCells;
+    /// Predictions of the last step. Capacity is kept between steps so steps do not allocate once it has grown
+    std::vector<clsASM::stuPrediction> PredictedCols;
+    bool                               PredictionListStale;
+    clsASM::Prediction_t               PredictionList;
+    /// Nodes released by PredictionList kept to be reused
+    clsASM::Prediction_t               SpareListNodes;
+    u_int64_t                          SumPathPermanence;
+    u_int32_t                          PathItems;
+    /// Generation of the model which session is positioned on
+    uint64_t                           Generation;
+    /// Number of compactions on the model which cell indexes of the session are valid for
+    uint64_t                           CompactionEpoch;
+    /// Scratch buffers of predictAhead kept to be reused by next calls
+    std::vector<stuAheadNode>          AheadNodes;
+    std::vector<uint32_t>              AheadLeaves;
+    std::vector<ColID_t>               AheadColIDs;
+    std::vector<clsASM::stuPathPrediction> AheadPaths;
+    /// Epoch of the WAL which session has been logged on and it's ID on that WAL
+    uint64_t                           WALEpoch;
+    uint32_t                           WALSessionID;
+};
 
 class clsASMPrivate
 {
@@ -38,43 +223,321 @@ public:
     clsASMPrivate(clsASM::Configs _configs);
     ~clsASMPrivate();
 
-    void executeOnce(ColID_t _activeColIndex, clsASM::enuLearningLevel _learningLevel);
-    inline const clsASM::Prediction_t& predictedCols() const{
-        return this->PredictedCols;
+    /**
+     * @brief executeOnce executes a step logging it's input when WAL has been started
+     */
+    inline void executeOnce(clsSessionPrivate& _session,
+                            ColID_t _activeColIndex,
+                            clsASM::enuLearningLevel _learningLevel){
+        this->checkInputs(&_activeColIndex, 1, _learningLevel);
+        if (this->WAL.isOpen())
+            this->logSteps(_session, &_activeColIndex, 1, _learningLevel);
+        this->executeStep(_session, _activeColIndex, _learningLevel);
+        _session.rankPredictions(this->Configs.MaxPredictions);
     }
-    bool load(const char* _filePath, bool _throw = false);
-    bool save(const char* _filePath);
-    void feedback(ColID_t _colID, double _score);
+    void executeStep(clsSessionPrivate& _session,
+                     ColID_t _activeColIndex,
+                     clsASM::enuLearningLevel _learningLevel);
+    void executeBulk(clsSessionPrivate& _session,
+                     const ColID_t* _inputs,
+                     size_t _count,
+                     clsASM::enuLearningLevel _learningLevel);
+    inline clsSessionPrivate& defaultSession(){
+        return this->DefaultSession;
+    }
+    bool load(const char* _filePath, bool _throw = false, clsASM::enuLoadMode _mode = clsASM::LoadToMemory);
+    bool save(const char* _filePath, clsASM::enuFileFormat _format = clsASM::FormatText);
+    bool checkpoint(const char* _basePath, bool _fold);
+    std::future<bool> saveAsync(const char* _filePath,
+                                clsASM::enuFileFormat _format,
+                                std::function<void(bool)> _onDone);
+    bool startWAL(const char* _snapshotPath,
+                  const char* _walPath,
+                  clsASM::enuFileFormat _format,
+                  uint32_t _groupCommitSize,
+                  bool _syncOnCommit);
+    bool commitWAL();
+    bool stopWAL();
+    bool recover(const char* _snapshotPath, const char* _walPath, bool _throw);
+    void feedback(clsSessionPrivate& _session, ColID_t _colID, double _score);
+    clsASM::PathPredictionSpan predictAhead(clsSessionPrivate& _session, uint32_t _steps, uint32_t _beamWidth);
+    void compact();
+    clsASM::MaintenanceReport maintain(Permanence_t _decay);
+    void merge(clsASMPrivate& _other, clsASM::enuMergePolicy _policy);
+    /**
+     * @brief freeze compiles the model to a frozen image keeping just the connections which can be predicted
+     */
+    clsFrozenASMPrivate* freeze();
+    clsASM::Stats stats();
 
 private:
-    void award(ColID_t _colID, Permanence_t _pVal);
-    void punish(ColID_t _colID, Permanence_t _pVal);
+    /**
+     * @brief checkInputs throws when a learnt input can not be stored on cells (@see ASM_COLID_BITS). Inputs
+     * are checked before being logged so WAL never holds an input which can not be replayed.
+     */
+    inline void checkInputs(const ColID_t* _inputs, size_t _count, clsASM::enuLearningLevel _learningLevel){
+        if (MAX_COLID == UINT32_MAX || _learningLevel == clsASM::LearningFrozen)
+            return;
+        for (size_t i = 0; i < _count; ++i)
+            if (_inputs[i] > MAX_COLID)
+                throw std::logic_error("ColID must not exceed " + std::to_string(MAX_COLID) +
+                                       " on this build (ASM_COLID_BITS): " + std::to_string(_inputs[i]));
+    }
+    /**
+     * @brief checkConfigs throws when configured permanence values can not be stored on cells
+     */
+    void checkConfigs();
+    void award(clsSessionPrivate& _session, ColID_t _colID, Permanence_t _pVal);
+    void punish(clsSessionPrivate& _session, ColID_t _colID, Permanence_t _pVal);
 
     void reset();
-    void setPredictionState(clsCell *_activeCell);
-    void removeOldPredictions();
-    void removeCell(clsCell::stuLocation& _loc);
-    inline clsCell* cell(const clsCell::stuLocation& _loc) const{
-        return this->column(_loc.ColID)->at(_loc.ZIndex);
+    /**
+     * @brief setPredictionState adds successors of the active cell to the predictions of the session
+     * @return number of successors scanned
+     */
+    CellIndex_t setPredictionState(clsSessionPrivate& _session, CellIndex_t _activeCell);
+    void loadText(const char* _filePath);
+    void saveText(const char* _filePath);
+    /**
+     * @return header of the written snapshot
+     */
+    stuSnapshotHeader saveBinary(const char* _filePath);
+    /**
+     * @brief writeSnapshot writes the binary snapshot to a file or to a clsSnapshotImage
+     * @param _connectedOnly keep just the successors which can be predicted (@see SNAPSHOT_FLAG_CONNECTED_SUCCESSORS)
+     */
+    template <typename Stream_t>
+    stuSnapshotHeader writeSnapshot(Stream_t& _stream, bool _connectedOnly);
+    /**
+     * @brief snapshotCell returns a cell as it is stored on snapshots. Destination is kept as pool index
+     */
+    stuSnapshotCell snapshotCell(CellIndex_t _index);
+    stuJournalCell journalCell(CellIndex_t _index);
+    /**
+     * @brief writeCheckpointBase writes a fresh base snapshot and an empty journal for it
+     */
+    void writeCheckpointBase(const char* _basePath);
+    /**
+     * @brief replayJournal applies journal of the base snapshot which has just been loaded
+     */
+    void replayJournal(const char* _basePath, const stuSnapshotHeader& _base);
+    void loadSnapshot(const clsMappedSnapshot& _snapshot);
+    void logSteps(clsSessionPrivate& _session,
+                  const ColID_t* _inputs,
+                  size_t _count,
+                  clsASM::enuLearningLevel _learningLevel);
+    void logFeedback(clsSessionPrivate& _session, ColID_t _colID, double _score);
+    /**
+     * @brief logToWAL logs position of the session if it has not been logged on the current WAL yet and calls
+     * _fn(SessionID) to append a record holding WAL lock
+     */
+    template <typename Fn_t>
+    void logToWAL(clsSessionPrivate& _session, Fn_t _fn);
+    /**
+     * @brief restoreSession positions a session replayed from WAL
+     */
+    void restoreSession(clsSessionPrivate& _session,
+                        const stuWALSession& _state,
+                        const stuWALLocation* _predicted,
+                        uint32_t _predictedCount);
+    CellIndex_t walCell(const stuWALLocation& _loc);
+    /**
+     * @brief executeOnceMapped executes a frozen step directly on the mapped snapshot
+     * @return number of cells scanned
+     */
+    CellIndex_t executeOnceMapped(clsSessionPrivate& _session, ColID_t _activeColIndex);
+    CellIndex_t setPredictionStateMapped(clsSessionPrivate& _session, CellIndex_t _activeCell);
+    void ensureInMemory();
+    /**
+     * @brief copyInLock returns a point in time copy of the in-memory model which can be used from another
+     * thread. Model must not change while it is being copied.
+     */
+    std::unique_ptr<clsASMPrivate> copyInLock();
+    /**
+     * @brief forEachSuccessor calls _fn(SuccessorIndex, ColID, Permanence) on successors of the cell either on
+     * the in-memory model or on the mapped snapshot. Removed cells which wait for compaction are skipped.
+     */
+    template <typename Fn_t>
+    inline void forEachSuccessor(CellIndex_t _cell, Fn_t _fn){
+        if (this->Snapshot){
+            for (const CellIndex_t* SuccessorIter = this->Snapshot->successorsBegin(_cell);
+                 SuccessorIter != this->Snapshot->successorsEnd(_cell);
+                 ++SuccessorIter){
+                const stuSnapshotCell& Successor = this->Snapshot->cell(*SuccessorIter);
+                _fn(*SuccessorIter, Successor.ColID, Successor.Permanence);
+            }
+            return;
+        }
+        for(CellIndex_t SuccessorIndex = this->cell(_cell)->firstSuccessor();
+            SuccessorIndex != INVALID_CELL_INDEX;
+            SuccessorIndex = this->cell(SuccessorIndex)->nextSibling()){
+            clsCell* Successor = this->cell(SuccessorIndex);
+            if (Successor->isRemoved() == false)
+                _fn(SuccessorIndex, Successor->colID(), Successor->permanence());
+        }
+    }
+
+    void appendSuccessor(CellIndex_t _destCell, CellIndex_t _successorIndex);
+    void buildSuccessorIndex();
+    /**
+     * @brief removeCell tombstones the cell
+     * @return false if cell had already been removed
+     */
+    bool removeCell(CellIndex_t _index);
+    void compactInLock();
+    /**
+     * @brief compactOnRequest compacts the model on a user request logging the compaction on WAL
+     */
+    void compactOnRequest();
+    void compactIfNeeded(std::shared_lock<std::shared_mutex>& _modelLock);
+    bool isCompactionNeeded();
+    CellIndex_t compactionThreshold() const;
+    /**
+     * @brief evictIfNeeded removes cells while the model exceeds Configs::MaxCells
+     * @param _protected cell which must not be evicted as the new cell is going to be connected to it
+     */
+    void evictIfNeeded(CellIndex_t _protected);
+    /**
+     * @brief maintainInLock decays all the connections while model is locked exclusively
+     */
+    clsASM::MaintenanceReport maintainInLock(Permanence_t _decay);
+    void syncSession(clsSessionPrivate& _session);
+    inline clsCell* cell(CellIndex_t _index) const{
+        return &this->Pool.at(_index);
+    }
+
+    /**
+     * @brief markDirty records a changed cell so it will be journaled by the next checkpoint
+     */
+    inline void markDirty(CellIndex_t _index){
+        if (this->Columns.isTrackingDirty() == false)
+            return;
+        clsCell* Cell = this->cell(_index);
+        Cell->markDirty();
+        this->Columns.markDirty(Cell->colID());
+    }
+
+    /**
+     * @brief location finds column and ZIndex of a cell. Cells of each column are kept in pool order so ZIndex
+     * is found by a binary search on the column.
+     */
+    inline clsCell::stuLocation location(CellIndex_t _index){
+        ColID_t ColID = this->cell(_index)->colID();
+        const clsColumn* Column = this->Columns.find(ColID, true);
+        return clsCell::stuLocation(ColID, std::lower_bound(Column->begin(), Column->end(), _index) - Column->begin());
+    }
+
+    /**
+     * @brief lockedLocation same as location but holds lock of the column on concurrent learning so it can be
+     * used while the model is locked shared and cells may be added to the column meanwhile
+     */
+    inline clsCell::stuLocation lockedLocation(CellIndex_t _index){
+        std::unique_lock<std::mutex> ColumnLock(this->columnLock(this->cell(_index)->colID()), std::defer_lock);
+        if (this->Configs.ConcurrentLearning)
+            ColumnLock.lock();
+        return this->location(_index);
+    }
+
+    /**
+     * @brief cellAt returns global index of the cell on a location or INVALID_CELL_INDEX if there is no such cell
+     */
+    inline CellIndex_t cellAt(const clsCell::stuLocation& _loc){
+        const clsColumn* Column = this->Columns.find(_loc.ColID, true);
+        return Column && _loc.ZIndex < Column->size() ? Column->at(_loc.ZIndex) : INVALID_CELL_INDEX;
     }
 
-    inline clsColumn* column(ColID_t _col) const{
-        return this->Columns[_col - 1];
+    /**
+     * @brief column returns column by its ID or NULL if nothing has been learnt on the column
+     */
+    inline clsColumn* column(ColID_t _col){
+        return this->Columns.find(_col);
+    }
+
+    inline const clsColumn* column(ColID_t _col) const{
+        return this->Columns.find(_col);
+    }
+
+    /**
+     * @brief learnCell adds a cell learnt by a step evicting cells if model is on it's budget
+     */
+    CellIndex_t learnCell(clsColumn& _column, ColID_t _colID, CellIndex_t _destination, Permanence_t _permanence);
+    CellIndex_t addCell(clsColumn& _column,
+                        ColID_t _colID,
+                        uint8_t _states = 0,
+                        CellIndex_t _destination = INVALID_CELL_INDEX,
+                        Permanence_t _permanence = 0);
+
+    inline std::mutex& columnLock(ColID_t _colID){
+        return this->ColumnLocks[_colID % COLUMN_LOCK_STRIPES].Mutex;
+    }
+
+    /**
+     * @brief exclusively runs _fn holding model lock exclusively. If @see _sharedLock is owned it will be
+     * released while running _fn and acquired again afterwards so anything found under the shared lock must
+     * be looked up again.
+     */
+    template <typename Fn_t>
+    inline void exclusively(std::shared_lock<std::shared_mutex>& _sharedLock, Fn_t _fn){
+        if (_sharedLock.owns_lock() == false)
+            return _fn();
+        _sharedLock.unlock();
+        {
+            std::unique_lock<std::shared_mutex> Lock(this->ModelLock);
+            _fn();
+        }
+        _sharedLock.lock();
     }
 
 private:
-    clsCell::stuLocation               LastLearningCell;
-    clsCell::stuLocation               LastPredictiveCell;
-    ColID_t                            LastActiveColumn;
-    bool                               FirstPattern;
-    std::list<clsCell::stuLocation>    PredictedCells;
-    clsASM::Prediction_t               PredictedCols;
-    u_int64_t                          SumPathPermanence;
-    u_int32_t                          PathItems;
-    std::vector<clsColumn*>            Columns;
-    clsASM::Configs Configs;
+    enum { COLUMN_LOCK_STRIPES = 64 };
 
-    unsigned int ActiveCol;
+    struct alignas(64) stuColumnLock{
+        std::mutex Mutex;
+    };
+
+    /**
+     * @brief The stuCheckpoint struct keeps the base which next checkpoint will be appended to. Base must be
+     * written again when the model has been reloaded or compacted since the base has been written.
+     */
+    struct stuCheckpoint{
+        std::string BasePath;
+        uint64_t    Generation;
+        uint64_t    CompactionEpoch;
+        uint64_t    BaseSize;
+        /// Size of the valid part of the journal
+        uint64_t    JournalSize;
+    };
+
+    clsSessionPrivate                  DefaultSession;
+    std::atomic<uint64_t>              Generation;
+    std::atomic<CellIndex_t>           RemovedCells;
+    uint64_t                           CompactionEpoch;
+    /// New index of each cell of the pool before last compaction or INVALID_CELL_INDEX if it has been removed
+    std::vector<CellIndex_t>           CompactionRemap;
+    /// Position of the eviction sweep on the pool (Guarded by PoolLock on concurrent learning)
+    CellIndex_t                        EvictionHand;
+    /// Learning steps counted for scheduled maintenance since the model has been loaded or WAL has been started
+    std::atomic<uint64_t>              MaintenanceSteps;
+    std::chrono::steady_clock::time_point CreationTime;
+#ifdef ASM_STATS
+    clsStats                           Stats;
+#endif
+    /// Held shared by each step and exclusively to change the structure of the model (Just on concurrent learning)
+    std::shared_mutex                  ModelLock;
+    /// Serializes cell appends on concurrent learning
+    std::mutex                         PoolLock;
+    /// Serializes checkpoints and loads. Taken before ModelLock
+    std::mutex                         CheckpointLock;
+    stuCheckpoint                      Checkpoint;
+    /// Guards WAL on concurrent learning. Taken after ModelLock
+    std::mutex                         WALLock;
+    clsWAL                             WAL;
+    /// Guards cells of the columns on concurrent learning
+    stuColumnLock                      ColumnLocks[COLUMN_LOCK_STRIPES];
+    clsColumnDirectory                 Columns;
+    clsCellPool                        Pool;
+    clsMappedSnapshot*                 Snapshot;
+    clsASM::Configs Configs;
 };
 }
 #endif // CLSASM_P_H
@@ -23,7 +23,10 @@
 #ifndef CLSCELL_H
 #define CLSCELL_H
 
-#include "clsASM_p.h"
+#include <climits>
+#include <limits>
+#include <type_traits>
+#include "clsASM.h"
 
 #ifndef NULL
 #define NULL 0
@@ -31,15 +34,58 @@
 
 namespace AdaptiveSequenceMemorizer{
 
-static inline void setBit(uint8_t& _var, bool _set, const uint8_t& _bitenum) {
-    _var = (_set ? _var | _bitenum : _var & ~_bitenum);
-}
+typedef uint32_t ZIndex_t;
+typedef uint32_t CellIndex_t;
+static const CellIndex_t INVALID_CELL_INDEX = UINT32_MAX;
+
+/**
+ * Widths of ColID and connection permanence stored on cells are selected at build time (ASM_COLID_BITS and
+ * ASM_PERMANENCE_BITS cmake options). ColID_t and Permanence_t of the API and saved models are not changed so
+ * narrower builds just reject columns and permanence values which do not fit on their cells.
+ */
+#ifndef ASM_COLID_BITS
+#define ASM_COLID_BITS 32
+#endif
+#ifndef ASM_PERMANENCE_BITS
+#define ASM_PERMANENCE_BITS 16
+#endif
 
-typedef uint16_t ZIndex_t;
+template <int Bits> struct stuUnsignedOfWidth;
+template <> struct stuUnsignedOfWidth<8>  { typedef uint8_t  Type; };
+template <> struct stuUnsignedOfWidth<16> { typedef uint16_t Type; };
+template <> struct stuUnsignedOfWidth<32> { typedef uint32_t Type; };
+
+typedef stuUnsignedOfWidth<ASM_COLID_BITS>::Type      ColIDStorage_t;
+typedef stuUnsignedOfWidth<ASM_PERMANENCE_BITS>::Type PermanenceStorage_t;
+static_assert(sizeof(ColIDStorage_t) <= sizeof(ColID_t), "ASM_COLID_BITS must be 8, 16 or 32");
+static_assert(sizeof(PermanenceStorage_t) <= sizeof(Permanence_t), "ASM_PERMANENCE_BITS must be 8 or 16");
+
+/// Greatest ColID which can be stored on cells
+static const ColID_t      MAX_COLID = std::numeric_limits<ColIDStorage_t>::max();
+/// Permanence saturates on the greatest signed value of it's width so sums of two permanences never overflow.
+/// Greater values are rejected too as learning would lower them and eviction scores rely on this bound.
+static const Permanence_t MAX_PERMANENCE = std::numeric_limits<std::make_signed<PermanenceStorage_t>::type>::max();
+
+/**
+ * @brief fitsCell checks whether a ColID and a permanence can be stored on cells of this build
+ */
+static inline bool fitsCell(ColID_t _colID, Permanence_t _permanence){
+    return _colID <= MAX_COLID && _permanence <= MAX_PERMANENCE;
+}
 
+/**
+ * @brief The clsCell class is a packed cell of the pool. States, runtime flags and connection permanence share
+ * a single word and connection destination is the global index of the destination cell. Location of the cell
+ * (ColID and ZIndex) is not stored as it's ZIndex can be found on it's column (@see clsColumn) so just ColID
+ * which is needed on each prediction is kept.
+ */
 class clsCell
 {
 public:
+    /**
+     * @brief The stuLocation struct addresses a cell by it's column and position on the column. It is used just
+     * on saved models and logs as global indexes change when the model is compacted or reloaded.
+     */
     struct stuLocation{
         ColID_t ColID;
         ZIndex_t ZIndex;
@@ -56,92 +102,177 @@ public:
         inline bool operator!=(const stuLocation& _loc) const {
             return ! (*this == _loc);
         }
-
-        stuLocation& operator = (const stuLocation& _loc){
-            this->ColID = _loc.ColID;
-            this->ZIndex = _loc.ZIndex;
-            return *this;
-        }
-
-        inline void clear(){
-            this->ColID = NOT_ASSIGNED;
-        }
-
-        inline bool isEmpty(){
-            return this->ColID == NOT_ASSIGNED;
-        }
-    };
-
-    struct stuConnection
-    {
-        stuLocation       Destination;
-        Permanence_t      Permanence;
-
-        stuConnection(ColID_t _destCol = NOT_ASSIGNED, ZIndex_t _destZIndex = 0, Permanence_t  _perm = 0){
-            Destination.ColID = _destCol;
-            Destination.ZIndex = _destZIndex;
-            this->Permanence = _perm;
-        }
-
-        stuConnection& operator = (const stuConnection& _con){
-            this->Destination = _con.Destination;
-            this->Permanence = _con.Permanence;
-            return *this;
-        }
     };
 
 private:
+    /**
+     * @brief Active, Predicting, Learning and their previous step bits are never set as prediction state is kept
+     * on each session (@see clsSessionPrivate::PredictedCells). They are kept just as bits of saved models.
+     */
     enum enuState
     {
         STATE_Active        = 0x01,
         STATE_Predicting    = 0x02,
         STATE_Learning      = 0x04,
+        STATE_Referenced    = 0x08,
         STATE_WasActive     = 0x10,
         STATE_WasPredicting = 0x20,
-        STATE_WasLearning   = 0x40
+        STATE_WasLearning   = 0x40,
+        STATE_Removed       = 0x80
+    };
+
+    /**
+     * @brief Runtime flags which are never stored. They share the word of States and Permanence
+     */
+    enum enuFlag
+    {
+        FLAG_Dirty          = 0x01
     };
 
 public:
     clsCell(ColID_t _colID,
-            ZIndex_t _zIndex,
-            char _states = 0,
-            const stuConnection& _connection = stuConnection()){
-        this->Loc.ColID = _colID;
-        this->Loc.ZIndex = _zIndex;
+            uint8_t _states = 0,
+            CellIndex_t _destination = INVALID_CELL_INDEX,
+            Permanence_t _permanence = 0){
         this->States = _states;
-        this->Connection = _connection;
+        this->Flags = 0;
+        this->Permanence = (PermanenceStorage_t)_permanence;
+        this->ColID = (ColIDStorage_t)_colID;
+        this->Destination = _destination;
+        this->FirstSuccessor = INVALID_CELL_INDEX;
+        this->NextSibling = INVALID_CELL_INDEX;
     }
 
-    inline bool isActive() {return this->States & STATE_Active;}
-    inline void setActiveState(bool _value){setBit(this->States, _value, STATE_Active);}
-
-    inline bool isPredicting() {return this->States & STATE_Active;}
-    inline void setPredictingState(bool _value){setBit(this->States, _value, STATE_Predicting);}
+    /**
+     * @brief Removed cells are just tombstoned and will be reclaimed by compaction
+     */
+    inline bool isRemoved() {return __atomic_load_n(&this->States, __ATOMIC_RELAXED) & STATE_Removed;}
+    /**
+     * @brief markRemoved tombstones the cell
+     * @return false if cell has already been removed
+     */
+    inline bool markRemoved(){
+        return (__atomic_fetch_or(&this->States, (uint8_t)STATE_Removed, __ATOMIC_RELAXED) & STATE_Removed) == 0;
+    }
 
-    inline bool isLearning() {return this->States & STATE_Learning;}
-    inline void setLearningState(bool _value){setBit(this->States, _value, STATE_Learning);}
+    /**
+     * @brief Referenced bit is set each time a learning step uses the cell and cleared by eviction sweep so
+     * cells which have not been used since the last pass of the sweep are the eviction candidates.
+     * It is checked before being set so hot cells do not get their cache line written on each step.
+     */
+    inline bool isReferenced() {return __atomic_load_n(&this->States, __ATOMIC_RELAXED) & STATE_Referenced;}
+    inline void touch(){
+        if (this->isReferenced() == false)
+            __atomic_fetch_or(&this->States, (uint8_t)STATE_Referenced, __ATOMIC_RELAXED);
+    }
+    inline void clearReferenced(){
+        __atomic_fetch_and(&this->States, (uint8_t)~STATE_Referenced, __ATOMIC_RELAXED);
+    }
 
-    inline bool wasActive()     {return this->States & STATE_WasActive;}
-    inline void setWasActiveState(bool _value){setBit(this->States, _value, STATE_WasActive);}
-    inline bool wasPredicting() {return this->States & STATE_WasPredicting;}
-    inline void setWasPredictingState(bool _value){setBit(this->States, _value, STATE_WasPredicting);}
-    inline bool wasLearning()   {return this->States & STATE_WasLearning;}
-    inline void setWasLearningState(bool _value){setBit(this->States, _value, STATE_WasLearning);}
+    /**
+     * @brief Dirty flag marks cells changed since the last checkpoint (@see clsASM::checkpoint)
+     */
+    inline void markDirty(){
+        if ((__atomic_load_n(&this->Flags, __ATOMIC_RELAXED) & FLAG_Dirty) == 0)
+            __atomic_fetch_or(&this->Flags, (uint8_t)FLAG_Dirty, __ATOMIC_RELAXED);
+    }
+    /**
+     * @brief takeDirty clears dirty flag
+     * @return true if cell was dirty
+     */
+    inline bool takeDirty(){
+        return __atomic_fetch_and(&this->Flags, (uint8_t)~FLAG_Dirty, __ATOMIC_RELAXED) & FLAG_Dirty;
+    }
 
     inline uint16_t states(){
         return this->States;
     }
 
-    inline bool hasConnection(){return this->Connection.Destination.ColID != NOT_ASSIGNED;}
+    /**
+     * @brief persistentStates states to be stored on saved models. Runtime only bits are masked out
+     */
+    inline uint16_t persistentStates(){
+        return this->states() & ~(STATE_Referenced | STATE_Removed);
+    }
+
+    inline ColID_t colID(){return this->ColID;}
 
-    inline stuConnection& connection(){return this->Connection; }
-    inline const stuLocation& loc(){return this->Loc;}
+    /**
+     * @brief destination global index of the cell which this cell is connected to. Cells which start sequences
+     * have no connection.
+     */
+    inline bool hasConnection(){return this->Destination != INVALID_CELL_INDEX;}
+    inline CellIndex_t destination(){return this->Destination;}
+    inline void setDestination(CellIndex_t _destination){this->Destination = _destination;}
+
+    /**
+     * @brief Connection permanence accessors used while learning. They are atomic so cells shared between
+     * sessions learning concurrently can be updated without locks.
+     */
+    inline Permanence_t permanence(){
+        return __atomic_load_n(&this->Permanence, __ATOMIC_RELAXED);
+    }
+    inline void setPermanence(Permanence_t _value){
+        __atomic_store_n(&this->Permanence, (PermanenceStorage_t)_value, __ATOMIC_RELAXED);
+    }
+    /**
+     * @brief increasePermanence increases permanence by _value saturating on MAX_PERMANENCE
+     */
+    inline void increasePermanence(Permanence_t _value){
+        PermanenceStorage_t Old = __atomic_load_n(&this->Permanence, __ATOMIC_RELAXED);
+        while (__atomic_compare_exchange_n(&this->Permanence, &Old,
+                                           (PermanenceStorage_t)(MAX_PERMANENCE - Old < _value ?
+                                                                     MAX_PERMANENCE : Old + _value),
+                                           true, __ATOMIC_RELAXED, __ATOMIC_RELAXED) == false);
+    }
+    /**
+     * @brief decreasePermanence decreases permanence by _value saturating on zero
+     * @return new permanence value
+     */
+    inline Permanence_t decreasePermanence(Permanence_t _value){
+        PermanenceStorage_t Old = __atomic_load_n(&this->Permanence, __ATOMIC_RELAXED);
+        while (__atomic_compare_exchange_n(&this->Permanence, &Old,
+                                           (PermanenceStorage_t)(Old < _value ? 0 : Old - _value),
+                                           true, __ATOMIC_RELAXED, __ATOMIC_RELAXED) == false);
+        return Old < _value ? 0 : Old - _value;
+    }
+
+    /**
+     * @brief Reverse connection index: cells whose connection destination is this cell are kept in an
+     * intrusive list starting at firstSuccessor() and chained through nextSibling() of each successor.
+     * These are the cells that will be predicted when this cell becomes active. Links are read with acquire
+     * semantic so a successor appended by another thread is completely visible when it's index is seen.
+     */
+    inline CellIndex_t firstSuccessor(){return __atomic_load_n(&this->FirstSuccessor, __ATOMIC_ACQUIRE);}
+    inline CellIndex_t nextSibling(){return __atomic_load_n(&this->NextSibling, __ATOMIC_ACQUIRE);}
+    inline void prependSuccessor(clsCell& _successor, CellIndex_t _successorIndex){
+        _successor.NextSibling = this->FirstSuccessor;
+        this->FirstSuccessor = _successorIndex;
+    }
+    /**
+     * @brief linkSuccessor links _successorIndex after this cell if this cell is the last successor in
+     * the list (or to the list head if _asFirst is set).
+     * @return false if another successor has been linked meanwhile. @see _next will be set to it
+     */
+    inline bool linkSuccessor(bool _asFirst, CellIndex_t _successorIndex, CellIndex_t& _next){
+        _next = INVALID_CELL_INDEX;
+        return __atomic_compare_exchange_n(_asFirst ? &this->FirstSuccessor : &this->NextSibling,
+                                           &_next, _successorIndex,
+                                           false, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE);
+    }
 
 private:
-    uint8_t States;
-    stuConnection Connection;
-    stuLocation   Loc;
+    uint8_t             States;
+    uint8_t             Flags;
+    PermanenceStorage_t Permanence;
+    ColIDStorage_t      ColID;
+    CellIndex_t         Destination;
+    CellIndex_t         FirstSuccessor;
+    CellIndex_t         NextSibling;
 };
 
+static_assert(sizeof(clsCell) == (ASM_COLID_BITS == 8 && ASM_PERMANENCE_BITS == 8 ? 16 : 20),
+              "Cells must stay packed");
+
 }
 #endif // CLSCELL_H
@@ -0,0 +1,147 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014 S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ */
+
+#ifndef CLSCELLPOOL_H
+#define CLSCELLPOOL_H
+
+#include <vector>
+#include <algorithm>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "clsCell.h"
+
+namespace AdaptiveSequenceMemorizer{
+
+/**
+ * @brief The clsCellPool class is an arena storing cells by value in fixed size chunks.
+ * Cells are addressed by a dense global index which remains valid until pool is cleared. As cells
+ * are trivially destructible whole pool is freed by releasing chunks so there is no per cell cost.
+ */
+class clsCellPool
+{
+public:
+    enum {
+        CHUNK_BITS = 16,
+        CHUNK_SIZE = 1 << CHUNK_BITS,
+        CHUNK_MASK = CHUNK_SIZE - 1,
+        MAX_CHUNKS = (size_t)INVALID_CELL_INDEX / CHUNK_SIZE + 1
+    };
+
+public:
+    clsCellPool(){
+        this->Count = 0;
+    }
+
+    ~clsCellPool(){
+        this->clear();
+    }
+
+    /**
+     * @brief append copies a cell to the end of the pool
+     * @return global index of the new cell
+     */
+    inline CellIndex_t append(const clsCell& _cell){
+        if ((this->Count & CHUNK_MASK) == 0 && (this->Count >> CHUNK_BITS) == this->Chunks.size())
+            this->Chunks.push_back(static_cast<clsCell*>(::operator new(sizeof(clsCell) * CHUNK_SIZE)));
+        new (&this->Chunks[this->Count >> CHUNK_BITS][this->Count & CHUNK_MASK]) clsCell(_cell);
+        return this->Count++;
+    }
+
+    /**
+     * @brief reserveChunkTable reserves chunk table for the greatest possible pool so it will never be moved.
+     * This way cells can be read by other threads while new cells are appended (appends must be serialized).
+     * Table pages are not touched until used so it costs just address space.
+     */
+    void reserveChunkTable(){
+        this->Chunks.reserve(MAX_CHUNKS);
+    }
+
+    inline clsCell& at(CellIndex_t _index) const{
+        return this->Chunks[_index >> CHUNK_BITS][_index & CHUNK_MASK];
+    }
+
+    inline CellIndex_t size() const{
+        return this->Count;
+    }
+
+    /**
+     * @brief forEachChunk calls _fn(Cells, FirstIndex, CellCount) on the used part of each chunk in order so
+     * sweeps over the whole pool run on contiguous arrays of cells
+     */
+    template <typename Fn_t>
+    inline void forEachChunk(Fn_t _fn) const{
+        for (uint64_t First = 0; First < this->Count; First += CHUNK_SIZE)
+            _fn(this->Chunks[First >> CHUNK_BITS],
+                (CellIndex_t)First,
+                (CellIndex_t)std::min<uint64_t>(CHUNK_SIZE, this->Count - First));
+    }
+
+    /**
+     * @brief memoryUsage bytes reserved by the pool
+     */
+    inline size_t memoryUsage() const{
+        return this->Chunks.size() * sizeof(clsCell) * CHUNK_SIZE +
+                this->Chunks.capacity() * sizeof(clsCell*);
+    }
+
+    /**
+     * @brief copyFrom replaces cells of the pool by a copy of cells of @see _other keeping their indexes
+     */
+    void copyFrom(const clsCellPool& _other){
+        this->clear();
+        for (CellIndex_t CellIndex = 0; CellIndex < _other.size(); ++CellIndex)
+            this->append(_other.at(CellIndex));
+    }
+
+    /**
+     * @brief swap exchanges cells of two pools in O(1)
+     */
+    void swap(clsCellPool& _other){
+        this->Chunks.swap(_other.Chunks);
+        std::swap(this->Count, _other.Count);
+    }
+
+    /**
+     * @brief clear releases all chunks in O(chunks)
+     */
+    void clear(){
+        for (auto ChunkIter = this->Chunks.begin(); ChunkIter != this->Chunks.end(); ChunkIter++)
+            ::operator delete(*ChunkIter);
+        this->Chunks.clear();
+        this->Count = 0;
+    }
+
+private:
+    clsCellPool(const clsCellPool&);
+    clsCellPool& operator = (const clsCellPool&);
+
+private:
+    std::vector<clsCell*> Chunks;
+    CellIndex_t           Count;
+
+    static_assert(std::is_trivially_destructible<clsCell>::value,
+                  "clsCell must be trivially destructible to be stored in clsCellPool");
+};
+
+}
+#endif // CLSCELLPOOL_H
@@ -0,0 +1,352 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014 S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ */
+
+#ifndef CLSCOLUMNDIRECTORY_H
+#define CLSCOLUMNDIRECTORY_H
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include "clsCell.h"
+
+namespace AdaptiveSequenceMemorizer{
+
+/**
+ * @brief clsColumn Global cell indexes of the cells in a column ordered by their ZIndex
+ */
+typedef std::vector<CellIndex_t> clsColumn;
+
+/**
+ * @brief The clsColumnDirectory class maps column IDs to columns.
+ * In dense mode columns are stored in a vector indexed by ColID so memory is proportional to the greatest
+ * seen ColID. In sparse mode columns are stored in the order they are created and an open addressing hash
+ * table maps ColIDs to them so memory is proportional to the number of live columns.
+ * In both modes a slot is just a pointer to the column which is allocated when the column is created, so unseen
+ * ColIDs of a dense directory cost a single pointer as before sparse mode was added.
+ */
+class clsColumnDirectory
+{
+private:
+    struct stuSlot{
+        ColID_t  ColID;
+        uint32_t Index;
+    };
+
+public:
+    clsColumnDirectory(){
+        this->Sparse = false;
+        this->MaxColID = 0;
+        this->Used = 0;
+        this->TrackDirty = false;
+    }
+
+    /**
+     * @brief operator = makes a deep copy of columns of @see _other
+     */
+    clsColumnDirectory& operator = (const clsColumnDirectory& _other){
+        this->Sparse = _other.Sparse;
+        this->Table = _other.Table;
+        this->Used = _other.Used;
+        this->MaxColID = _other.MaxColID;
+        this->TrackDirty = _other.TrackDirty;
+        this->Dirty = _other.Dirty;
+        this->Columns.clear();
+        this->Columns.reserve(_other.Columns.size());
+        for (auto ColIter = _other.Columns.begin(); ColIter != _other.Columns.end(); ColIter++)
+            this->Columns.emplace_back(*ColIter ? new clsColumn(**ColIter) : NULL);
+        return *this;
+    }
+
+    /**
+     * @brief setSparse changes directory mode. Directory will be cleared
+     */
+    void setSparse(bool _sparse){
+        this->clear();
+        this->Sparse = _sparse;
+    }
+
+    inline bool isSparse() const{
+        return this->Sparse;
+    }
+
+    /**
+     * @brief find returns column by its ID or NULL if nothing has been learnt on the column
+     * @param _includeEmpty return columns which have been created but have no cell
+     */
+    inline clsColumn* find(ColID_t _colID, bool _includeEmpty = false){
+        uint32_t Index = this->Sparse ? this->lookup(_colID) :
+                                        (_colID == 0 || _colID > this->Columns.size() ? NOT_FOUND : _colID - 1);
+        if (Index == NOT_FOUND)
+            return NULL;
+        clsColumn* Column = this->Columns[Index].get();
+        return (Column == NULL || (_includeEmpty == false && Column->empty())) ? NULL : Column;
+    }
+
+    inline const clsColumn* find(ColID_t _colID) const{
+        return const_cast<clsColumnDirectory*>(this)->find(_colID);
+    }
+
+    /**
+     * @brief get returns column by its ID and creates it if it does not exist
+     */
+    inline clsColumn& get(ColID_t _colID){
+        if (this->Sparse == false){
+            if (_colID > this->Columns.size())
+                this->resize(_colID);
+            std::unique_ptr<clsColumn>& Column = this->Columns[_colID - 1];
+            if (Column == NULL)
+                Column.reset(new clsColumn);
+            return *Column;
+        }
+
+        if (_colID > this->MaxColID)
+            this->MaxColID = _colID;
+        uint32_t Index = this->lookup(_colID);
+        if (Index != NOT_FOUND)
+            return *this->Columns[Index];
+
+        if ((this->Used + 1) * 2 > this->Table.size())
+            this->rehash(this->Table.size() ? this->Table.size() * 2 : 16);
+        this->insert(_colID, this->Columns.size());
+        this->resize(this->Columns.size() + 1);
+        this->Columns.back().reset(new clsColumn);
+        return *this->Columns.back();
+    }
+
+    /**
+     * @brief reserve reserves space for columns up to _maxColID. It is ignored in sparse mode
+     */
+    void reserve(ColID_t _maxColID){
+        if (this->Sparse == false && _maxColID > this->Columns.size())
+            this->resize(_maxColID);
+    }
+
+    void clear(){
+        this->Columns.clear();
+        this->Dirty.clear();
+        this->Table.clear();
+        this->Used = 0;
+        this->MaxColID = 0;
+    }
+
+    /**
+     * @brief maxColID greatest column ID that has been requested from directory
+     */
+    inline ColID_t maxColID() const{
+        return this->Sparse ? this->MaxColID : this->Columns.size();
+    }
+
+    /**
+     * @brief forEach calls _fn(ColID, clsColumn&) on all non empty columns ordered by ColID
+     */
+    template <typename Fn_t>
+    void forEach(Fn_t _fn) const{
+        if (this->Sparse == false){
+            for (size_t i = 0; i < this->Columns.size(); ++i)
+                if (this->Columns[i] && this->Columns[i]->size())
+                    _fn((ColID_t)(i + 1), *this->Columns[i]);
+            return;
+        }
+
+        std::vector<stuSlot> Ordered;
+        Ordered.reserve(this->Used);
+        for (auto SlotIter = this->Table.begin(); SlotIter != this->Table.end(); SlotIter++)
+            if (SlotIter->ColID && this->Columns[SlotIter->Index]->size())
+                Ordered.push_back(*SlotIter);
+        std::sort(Ordered.begin(), Ordered.end(),
+                  [](const stuSlot& _a, const stuSlot& _b){return _a.ColID < _b.ColID;});
+        for (auto SlotIter = Ordered.begin(); SlotIter != Ordered.end(); SlotIter++)
+            _fn(SlotIter->ColID, *this->Columns[SlotIter->Index]);
+    }
+
+    /**
+     * @brief forEachUnordered calls _fn(ColID, clsColumn&) on all created columns in storage order
+     */
+    template <typename Fn_t>
+    void forEachUnordered(Fn_t _fn){
+        if (this->Sparse == false){
+            for (size_t i = 0; i < this->Columns.size(); ++i)
+                if (this->Columns[i])
+                    _fn((ColID_t)(i + 1), *this->Columns[i]);
+            return;
+        }
+        for (auto SlotIter = this->Table.begin(); SlotIter != this->Table.end(); SlotIter++)
+            if (SlotIter->ColID)
+                _fn(SlotIter->ColID, *this->Columns[SlotIter->Index]);
+    }
+
+    /**
+     * @brief removeEmpty releases empty columns. Dense directories keep a slot for each ColID so their slots
+     * are just cleared while sparse directories are shrunk.
+     */
+    void removeEmpty(){
+        if (this->Sparse == false){
+            for (auto ColIter = this->Columns.begin(); ColIter != this->Columns.end(); ColIter++)
+                if (*ColIter && (*ColIter)->empty())
+                    ColIter->reset();
+            return;
+        }
+
+        std::vector<stuSlot>                    Live;
+        std::vector<std::unique_ptr<clsColumn>> OldColumns;
+        OldColumns.swap(this->Columns);
+        for (auto SlotIter = this->Table.begin(); SlotIter != this->Table.end(); SlotIter++)
+            if (SlotIter->ColID && OldColumns[SlotIter->Index]->size()){
+                Live.push_back(stuSlot{SlotIter->ColID, (uint32_t)this->Columns.size()});
+                this->Columns.push_back(std::move(OldColumns[SlotIter->Index]));
+            }
+
+        size_t TableSize = 16;
+        while (Live.size() * 2 > TableSize)
+            TableSize *= 2;
+        std::vector<stuSlot>(TableSize, stuSlot{0, 0}).swap(this->Table);
+        this->Used = 0;
+        for (auto SlotIter = Live.begin(); SlotIter != Live.end(); SlotIter++)
+            this->insert(SlotIter->ColID, SlotIter->Index);
+        std::vector<uint64_t>(dirtyWords(this->Columns.size()), 0).swap(this->Dirty);
+    }
+
+    /**
+     * @brief setDirtyTracking enables or disables tracking of changed columns (@see markDirty). All columns
+     * are marked clean.
+     */
+    void setDirtyTracking(bool _enabled){
+        this->TrackDirty = _enabled;
+        std::fill(this->Dirty.begin(), this->Dirty.end(), 0);
+    }
+
+    inline bool isTrackingDirty() const{
+        return this->TrackDirty;
+    }
+
+    /**
+     * @brief markDirty records that cells of the column have changed so it will be journaled by the next
+     * checkpoint. It can be called concurrently while no column is being created.
+     */
+    inline void markDirty(ColID_t _colID){
+        if (this->TrackDirty == false)
+            return;
+        uint32_t Index = this->Sparse ? this->lookup(_colID) : _colID - 1;
+        if (Index >= this->Columns.size())
+            return;
+        uint64_t Bit = 1ULL << (Index & 63);
+        if ((__atomic_load_n(&this->Dirty[Index >> 6], __ATOMIC_RELAXED) & Bit) == 0)
+            __atomic_fetch_or(&this->Dirty[Index >> 6], Bit, __ATOMIC_RELAXED);
+    }
+
+    /**
+     * @brief takeDirty calls _fn(ColID, clsColumn&) on all columns changed since the last call and marks them
+     * clean
+     */
+    template <typename Fn_t>
+    void takeDirty(Fn_t _fn){
+        if (this->Sparse == false){
+            for (size_t Word = 0; Word < this->Dirty.size(); ++Word)
+                for (uint64_t Bits = this->Dirty[Word]; Bits; Bits &= Bits - 1){
+                    size_t Index = Word * 64 + __builtin_ctzll(Bits);
+                    if (this->Columns[Index])
+                        _fn((ColID_t)(Index + 1), *this->Columns[Index]);
+                }
+            std::fill(this->Dirty.begin(), this->Dirty.end(), 0);
+            return;
+        }
+        for (auto SlotIter = this->Table.begin(); SlotIter != this->Table.end(); SlotIter++)
+            if (SlotIter->ColID && (this->Dirty[SlotIter->Index >> 6] & (1ULL << (SlotIter->Index & 63)))){
+                this->Dirty[SlotIter->Index >> 6] &= ~(1ULL << (SlotIter->Index & 63));
+                _fn(SlotIter->ColID, *this->Columns[SlotIter->Index]);
+            }
+    }
+
+    size_t memoryUsage() const{
+        size_t Size = this->Columns.capacity() * sizeof(std::unique_ptr<clsColumn>) +
+                      this->Table.capacity() * sizeof(stuSlot) +
+                      this->Dirty.capacity() * sizeof(uint64_t);
+        for (auto ColIter = this->Columns.begin(); ColIter != this->Columns.end(); ColIter++)
+            if (*ColIter)
+                Size += sizeof(clsColumn) + (*ColIter)->capacity() * sizeof(CellIndex_t);
+        return Size;
+    }
+
+private:
+    static const uint32_t NOT_FOUND = UINT32_MAX;
+
+    static inline size_t dirtyWords(size_t _columns){
+        return (_columns + 63) / 64;
+    }
+
+    /**
+     * @brief resize changes number of column slots keeping one dirty bit for each of them
+     */
+    void resize(size_t _columns){
+        this->Columns.resize(_columns);
+        this->Dirty.resize(dirtyWords(_columns), 0);
+    }
+
+    static inline size_t hash(ColID_t _colID, size_t _mask){
+        //Fibonacci hashing spreads consecutive IDs over whole table
+        return (size_t)(((uint64_t)_colID * 0x9E3779B97F4A7C15ULL) >> 32) & _mask;
+    }
+
+    inline uint32_t lookup(ColID_t _colID) const{
+        if (this->Table.empty())
+            return NOT_FOUND;
+        size_t Mask = this->Table.size() - 1;
+        for (size_t Pos = hash(_colID, Mask); ; Pos = (Pos + 1) & Mask){
+            if (this->Table[Pos].ColID == _colID)
+                return this->Table[Pos].Index;
+            if (this->Table[Pos].ColID == 0)
+                return NOT_FOUND;
+        }
+    }
+
+    inline void insert(ColID_t _colID, uint32_t _index){
+        size_t Mask = this->Table.size() - 1;
+        size_t Pos = hash(_colID, Mask);
+        while (this->Table[Pos].ColID)
+            Pos = (Pos + 1) & Mask;
+        this->Table[Pos].ColID = _colID;
+        this->Table[Pos].Index = _index;
+        this->Used++;
+    }
+
+    void rehash(size_t _size){
+        std::vector<stuSlot> OldTable(_size, stuSlot{0, 0});
+        OldTable.swap(this->Table);
+        this->Used = 0;
+        for (auto SlotIter = OldTable.begin(); SlotIter != OldTable.end(); SlotIter++)
+            if (SlotIter->ColID)
+                this->insert(SlotIter->ColID, SlotIter->Index);
+    }
+
+private:
+    bool                                    Sparse;
+    std::vector<std::unique_ptr<clsColumn>> Columns;
+    std::vector<stuSlot>                    Table;
+    size_t                                  Used;
+    ColID_t                                 MaxColID;
+    bool                                    TrackDirty;
+    /// Changed bit of each column in the same order as Columns
+    std::vector<uint64_t>                   Dirty;
+};
+
+}
+#endif // CLSCOLUMNDIRECTORY_H
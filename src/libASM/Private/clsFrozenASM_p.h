@@ -0,0 +1,68 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014  S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ */
+
+
+#ifndef CLSFROZENASM_P_H
+#define CLSFROZENASM_P_H
+
+#include "clsFrozenASM.h"
+#include "clsASM_p.h"
+
+namespace AdaptiveSequenceMemorizer {
+
+/**
+ * @brief The clsFrozenASMPrivate class predicts on a snapshot image (or a mapped snapshot) which is never
+ * changed after construction. Cursors keep all the state of the steps.
+ */
+class clsFrozenASMPrivate
+{
+public:
+    clsFrozenASMPrivate(uint32_t _maxPredictions);
+
+    /**
+     * @brief open takes ownership of a frozen image written by clsASMPrivate::freeze()
+     */
+    void open(std::vector<char>&& _image);
+    void open(const char* _filePath);
+
+    /**
+     * @brief executeStep executes an input the same way as a LearningFrozen step on a mapped model
+     */
+    void executeStep(clsSessionPrivate& _session, ColID_t _input) const;
+
+private:
+    void setPredictionState(clsSessionPrivate& _session, CellIndex_t _activeCell) const;
+
+private:
+    /// Successors whose cells are prefetched ahead of the one being checked
+    enum { PREFETCH_DISTANCE = 4 };
+
+public:
+    /// Unique for each compiled model so cursors positioned on another one will be restarted
+    uint64_t          ID;
+    uint32_t          MaxPredictions;
+    Permanence_t      MinPermanence2Connect;
+    clsMappedSnapshot Snapshot;
+};
+
+}
+#endif // CLSFROZENASM_P_H
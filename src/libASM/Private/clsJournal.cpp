@@ -0,0 +1,160 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014 S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ */
+
+#include <stdexcept>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "clsJournal.h"
+
+namespace AdaptiveSequenceMemorizer{
+
+/*************************************************************************************************************/
+std::string clsJournal::path(const char *_basePath)
+{
+    return std::string(_basePath) + ".journal";
+}
+
+/*************************************************************************************************************/
+uint64_t clsJournal::create(const std::string &_path, const stuSnapshotHeader &_base)
+{
+    std::ofstream File(_path.c_str(), std::ios::binary | std::ios::trunc);
+    if (File.is_open() == false)
+        throw std::logic_error("Unable to open journal: " + _path);
+
+    stuJournalHeader Header;
+    memset(&Header, 0, sizeof(Header));
+    memcpy(Header.Magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    Header.Version = JOURNAL_VERSION;
+    Header.EndianMark = SNAPSHOT_ENDIAN_MARK;
+    Header.HeaderSize = sizeof(stuJournalHeader);
+    Header.BaseFileSize = _base.FileSize;
+    Header.BaseCellCount = _base.CellCount;
+    File.write((const char*)&Header, sizeof(Header));
+    File.flush();
+    if (File.fail())
+        throw std::logic_error("Unable to write journal: " + _path);
+    return sizeof(Header);
+}
+
+/*************************************************************************************************************/
+uint64_t clsJournal::append(const std::string &_path, uint64_t _validSize, const clsJournalRecord &_record)
+{
+    if (::truncate(_path.c_str(), _validSize) != 0)
+        throw std::logic_error("Unable to truncate journal: " + _path);
+
+    std::ofstream File(_path.c_str(), std::ios::binary | std::ios::app);
+    if (File.is_open() == false)
+        throw std::logic_error("Unable to open journal: " + _path);
+
+    stuJournalRecordHeader Header;
+    memset(&Header, 0, sizeof(Header));
+    Header.ColumnCount = _record.columnCount();
+    Header.PayloadSize = _record.payload().size();
+    Header.Checksum = clsJournal::checksum(_record.payload().data(), _record.payload().size());
+    File.write((const char*)&Header, sizeof(Header));
+    File.write(_record.payload().data(), _record.payload().size());
+    File.flush();
+    if (File.fail())
+        throw std::logic_error("Unable to write journal: " + _path);
+    return _validSize + sizeof(Header) + _record.payload().size();
+}
+
+/*************************************************************************************************************/
+uint64_t clsJournal::replay(const std::string &_path, const stuSnapshotHeader &_base, const ColumnFn_t &_fn)
+{
+    std::ifstream File(_path.c_str(), std::ios::binary | std::ios::ate);
+    if (File.is_open() == false)
+        return 0;
+    uint64_t FileSize = File.tellg();
+    File.seekg(0);
+
+    stuJournalHeader Header;
+    if (File.read((char*)&Header, sizeof(Header)).fail() ||
+            memcmp(Header.Magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0)
+        throw std::logic_error("Invalid journal: " + _path);
+    if (Header.EndianMark != SNAPSHOT_ENDIAN_MARK)
+        throw std::logic_error("Journal has been created on a machine with different endianness: " + _path);
+    if (Header.Version != JOURNAL_VERSION || Header.HeaderSize != sizeof(stuJournalHeader))
+        throw std::logic_error("Unsupported journal version: " + std::to_string(Header.Version));
+    if (Header.BaseFileSize != _base.FileSize || Header.BaseCellCount != _base.CellCount)
+        throw std::logic_error("Journal does not belong to the base snapshot: " + _path);
+
+    uint64_t ValidSize = sizeof(Header);
+    stuJournalRecordHeader RecordHeader;
+    std::vector<char> Payload;
+    while (File.read((char*)&RecordHeader, sizeof(RecordHeader))){
+        if (RecordHeader.PayloadSize > FileSize - ValidSize - sizeof(RecordHeader))
+            break;
+        Payload.resize(RecordHeader.PayloadSize);
+        if (File.read(Payload.data(), Payload.size()).fail() ||
+                clsJournal::checksum(Payload.data(), Payload.size()) != RecordHeader.Checksum)
+            break;
+
+        //Structure of the record is checked completely before it is replayed
+        size_t Offset = 0;
+        for (uint32_t i = 0; i < RecordHeader.ColumnCount; ++i){
+            stuJournalColumn Column;
+            if (Payload.size() - Offset < sizeof(Column))
+                throw std::logic_error("Invalid journal record: " + _path);
+            memcpy(&Column, Payload.data() + Offset, sizeof(Column));
+            Offset += sizeof(Column);
+            if ((Payload.size() - Offset) / sizeof(stuJournalCell) < Column.CellCount)
+                throw std::logic_error("Invalid journal record: " + _path);
+            Offset += Column.CellCount * sizeof(stuJournalCell);
+        }
+        if (Offset != Payload.size())
+            throw std::logic_error("Invalid journal record: " + _path);
+
+        for (Offset = 0; Offset < Payload.size(); ){
+            const stuJournalColumn* Column = (const stuJournalColumn*)(Payload.data() + Offset);
+            Offset += sizeof(stuJournalColumn);
+            _fn(Column->ColID, (const stuJournalCell*)(Payload.data() + Offset), Column->CellCount);
+            Offset += Column->CellCount * sizeof(stuJournalCell);
+        }
+        ValidSize += sizeof(RecordHeader) + Payload.size();
+    }
+    return ValidSize;
+}
+
+/*************************************************************************************************************/
+void clsJournal::remove(const std::string &_path)
+{
+    if (std::remove(_path.c_str()) != 0 && access(_path.c_str(), F_OK) == 0)
+        throw std::logic_error("Unable to remove journal: " + _path);
+}
+
+/*************************************************************************************************************/
+uint32_t clsJournal::checksum(const char *_data, size_t _size)
+{
+    //FNV-1a
+    uint32_t Hash = 2166136261u;
+    for (size_t i = 0; i < _size; ++i)
+        Hash = (Hash ^ (uint8_t)_data[i]) * 16777619u;
+    return Hash;
+}
+
+}
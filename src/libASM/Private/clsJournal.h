@@ -0,0 +1,174 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014 S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ */
+
+#ifndef CLSJOURNAL_H
+#define CLSJOURNAL_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include "clsSnapshot.h"
+
+namespace AdaptiveSequenceMemorizer{
+
+/**
+ * Checkpoint journal layout. A journal belongs to a binary snapshot (the base) and is kept beside it on
+ * <base>.journal. All values are native endian:
+ *  - stuJournalHeader
+ *  - Records appended by each checkpoint, each one as stuJournalRecordHeader followed by PayloadSize bytes of:
+ *    - stuJournalColumn followed by CellCount stuJournalCell of the column ordered by ZIndex, ColumnCount times
+ * Just cells changed since the previous checkpoint are journaled. Cells are never moved between compactions so
+ * a journaled cell either updates permanence and removal of an existing cell or has the next ZIndex of it's
+ * column and is appended to it. Cells are addressed by location as global indexes of the model which writes the
+ * journal differ from the ones of a model loading the base. A record which has not been completely written
+ * (i.e. on a crash while checkpointing) fails it's checksum and is ignored along with anything after it.
+ */
+static const char     JOURNAL_MAGIC[4] = {'A','S','M','J'};
+static const uint32_t JOURNAL_VERSION = 2;
+static const uint8_t  JOURNAL_CELL_REMOVED = 0x01;
+
+struct stuJournalHeader
+{
+    char          Magic[4];
+    uint32_t      Version;
+    uint32_t      EndianMark;
+    uint32_t      HeaderSize;
+    /// FileSize and CellCount of the base snapshot used to detect a journal left from another base
+    uint64_t      BaseFileSize;
+    uint64_t      BaseCellCount;
+};
+
+struct stuJournalRecordHeader
+{
+    uint32_t      ColumnCount;
+    uint32_t      Checksum;
+    uint64_t      PayloadSize;
+};
+
+struct stuJournalColumn
+{
+    ColID_t       ColID;
+    uint32_t      CellCount;
+};
+
+struct stuJournalCell
+{
+    clsCell::stuLocation Loc;
+    /// Location of the destination cell. ColID is NOT_ASSIGNED if cell has no connection
+    clsCell::stuLocation Destination;
+    Permanence_t  Permanence;
+    uint8_t       States;
+    /// JOURNAL_CELL_* flags
+    uint8_t       Flags;
+};
+
+/**
+ * @brief The clsJournalRecord class collects columns changed since the last checkpoint in memory so they can be
+ * written out of the model lock
+ */
+class clsJournalRecord
+{
+public:
+    clsJournalRecord(){
+        this->ColumnCount = 0;
+        this->ColumnOffset = 0;
+    }
+
+    /**
+     * @brief addColumn starts a column. Cells added afterwards belong to it
+     */
+    inline void addColumn(ColID_t _colID){
+        stuJournalColumn Column = {_colID, 0};
+        this->ColumnOffset = this->Payload.size();
+        this->Payload.insert(this->Payload.end(), (const char*)&Column, (const char*)&Column + sizeof(Column));
+        this->ColumnCount++;
+    }
+
+    inline void addCell(const stuJournalCell& _cell){
+        this->Payload.insert(this->Payload.end(), (const char*)&_cell, (const char*)&_cell + sizeof(_cell));
+        ((stuJournalColumn*)&this->Payload[this->ColumnOffset])->CellCount++;
+    }
+
+    inline bool empty() const{
+        return this->ColumnCount == 0;
+    }
+
+    inline uint32_t columnCount() const{
+        return this->ColumnCount;
+    }
+
+    inline const std::vector<char>& payload() const{
+        return this->Payload;
+    }
+
+private:
+    uint32_t          ColumnCount;
+    size_t            ColumnOffset;
+    std::vector<char> Payload;
+};
+
+/**
+ * @brief The clsJournal class reads and writes checkpoint journals. Methods throw std::logic_error on errors
+ */
+class clsJournal
+{
+public:
+    typedef std::function<void(ColID_t _colID, const stuJournalCell* _cells, uint32_t _cellCount)> ColumnFn_t;
+
+    /**
+     * @brief path returns path of the journal of a base snapshot
+     */
+    static std::string path(const char* _basePath);
+
+    /**
+     * @brief create writes an empty journal for the specified base replacing any existing journal
+     * @return size of the journal
+     */
+    static uint64_t create(const std::string& _path, const stuSnapshotHeader& _base);
+
+    /**
+     * @brief append appends a record to the journal. Anything after @see _validSize (a torn record of a failed
+     * checkpoint) is truncated first.
+     * @return new size of the journal
+     */
+    static uint64_t append(const std::string& _path, uint64_t _validSize, const clsJournalRecord& _record);
+
+    /**
+     * @brief replay calls _fn on each column of the journal records in order. Records are verified before
+     * being replayed so a torn record at the end is not replayed.
+     * @return size of the valid part of the journal or 0 if the journal does not exist
+     */
+    static uint64_t replay(const std::string& _path, const stuSnapshotHeader& _base, const ColumnFn_t& _fn);
+
+    /**
+     * @brief remove removes the journal if it exists
+     */
+    static void remove(const std::string& _path);
+
+    /**
+     * @brief checksum FNV-1a checksum used to verify records
+     */
+    static uint32_t checksum(const char* _data, size_t _size);
+};
+
+}
+#endif // CLSJOURNAL_H
@@ -0,0 +1,211 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014  S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ */
+
+#ifndef CLSSHARDEDASM_P_H
+#define CLSSHARDEDASM_P_H
+
+#include <memory>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include "clsShardedASM.h"
+
+namespace AdaptiveSequenceMemorizer {
+
+/// Shard is not selected yet as the stream is at the start of a sequence
+static const uint32_t NO_SHARD = UINT32_MAX;
+
+/**
+ * @brief The clsShardedStreamPrivate class keeps a session on each shard. Session of a shard is used just by
+ * the worker of that shard.
+ */
+class clsShardedStreamPrivate
+{
+public:
+    clsShardedStreamPrivate(uint32_t _shardCount, clsShardedASM::PredictionFn_t _onPrediction) :
+        CurrentShard(NO_SHARD),
+        LastShard(NO_SHARD),
+        LoadGeneration(0),
+        OnPrediction(_onPrediction),
+        Pending(0)
+    {
+        for (uint32_t i = 0; i < _shardCount; ++i)
+            this->Sessions.emplace_back(new clsASM::Session);
+    }
+
+    /**
+     * @brief done is called by the workers when @see _count inputs of the stream have been executed
+     */
+    void done(uint64_t _count){
+        if (this->Pending.fetch_sub(_count, std::memory_order_acq_rel) == _count){
+            std::lock_guard<std::mutex> Lock(this->DoneLock);
+            this->AllDone.notify_all();
+        }
+    }
+
+    /**
+     * @brief fail is called by the workers before done() when a batch of the stream has failed. Just the first
+     * error is kept until it is reported by wait(true).
+     */
+    void fail(std::exception_ptr _error){
+        std::lock_guard<std::mutex> Lock(this->DoneLock);
+        if (this->Error == nullptr)
+            this->Error = _error;
+    }
+
+    /**
+     * @brief wait blocks until queued inputs have been executed. If @see _rethrow is set the first error of the
+     * batches executed since the previous report is rethrown, otherwise it is kept.
+     */
+    void wait(bool _rethrow = false){
+        std::unique_lock<std::mutex> Lock(this->DoneLock);
+        this->AllDone.wait(Lock, [this](){ return this->Pending.load(std::memory_order_acquire) == 0; });
+        if (_rethrow && this->Error){
+            std::exception_ptr Error = nullptr;
+            std::swap(Error, this->Error);
+            std::rethrow_exception(Error);
+        }
+    }
+
+public:
+    std::vector<std::unique_ptr<clsASM::Session>> Sessions;
+    /// Shard of the current sequence
+    uint32_t                      CurrentShard;
+    /// Shard which has received the last inputs
+    uint32_t                      LastShard;
+    /// Shards are reloaded when it differs from the one of the sharded model so the sequence is restarted
+    uint64_t                      LoadGeneration;
+    clsShardedASM::PredictionFn_t OnPrediction;
+    /// Number of queued inputs which have not been executed yet
+    std::atomic<uint64_t>         Pending;
+    std::mutex                    DoneLock;
+    std::condition_variable       AllDone;
+    /// First error of the batches which has not been reported yet. Guarded by DoneLock
+    std::exception_ptr            Error;
+};
+
+/**
+ * @brief The clsShard class owns a model and the worker thread which executes inputs queued to it. Inputs are
+ * queued as batches of consecutive inputs of the same stream and learning level so the worker takes the whole
+ * queue at once and executes each batch with a single call. Tasks (i.e. save and load) are queued in order
+ * with the inputs and run on the worker too.
+ */
+class clsShard
+{
+public:
+    typedef std::function<void(clsASM&)> Task_t;
+
+    clsShard(uint32_t _index, const clsASM::Configs& _configs);
+    ~clsShard();
+
+    void start(bool _pin);
+
+    /**
+     * @brief stop executes queued inputs and tasks and joins the worker
+     */
+    void stop();
+
+    /**
+     * @brief enqueue queues inputs of a stream. It blocks while the queue is full.
+     */
+    void enqueue(clsShardedStreamPrivate* _stream,
+                 clsASM::enuLearningLevel _learningLevel,
+                 const ColID_t* _inputs,
+                 size_t _count);
+
+    /**
+     * @brief run queues a task which is called on the worker after inputs queued before it
+     */
+    void run(Task_t _task);
+
+    /**
+     * @brief rethrowError rethrows the first error of the batches executed since the previous call. It must be
+     * called on the worker (i.e. by a task).
+     */
+    void rethrowError();
+
+private:
+    struct stuBatch{
+        /// NULL marks a task
+        clsShardedStreamPrivate* Stream;
+        uint32_t                 LearningLevel;
+        size_t                   Count;
+    };
+
+    void work();
+    void execute(const stuBatch& _batch, const ColID_t* _inputs);
+
+private:
+    /// Inputs which can be queued on a shard before producers are blocked
+    static const size_t MAX_QUEUED_INPUTS = 64 * 1024;
+
+    uint32_t                Index;
+    clsASM                  ASM;
+    std::thread             Worker;
+    std::mutex              QueueLock;
+    std::condition_variable NotEmpty;
+    std::condition_variable NotFull;
+    std::vector<stuBatch>   Batches;
+    std::vector<ColID_t>    Inputs;
+    std::deque<Task_t>      Tasks;
+    bool                    Stopping;
+    /// First error of the batches executed since the previous rethrowError(). Used just by the worker
+    std::exception_ptr      Error;
+};
+
+class clsShardedASMPrivate
+{
+public:
+    clsShardedASMPrivate(uint32_t _shardCount, clsASM::Configs _configs, bool _pinWorkers);
+    ~clsShardedASMPrivate();
+
+    void executeBulk(clsShardedStreamPrivate& _stream,
+                     const ColID_t* _inputs,
+                     size_t _count,
+                     clsASM::enuLearningLevel _learningLevel);
+
+    /**
+     * @brief runOnAll runs a task on all the shards in parallel and waits for them
+     */
+    void runOnAll(const std::function<void(uint32_t _shard, clsASM&)>& _task);
+
+    inline uint32_t shardOf(ColID_t _colID) const{
+        //Fibonacci hashing spreads consecutive IDs over the shards
+        return (uint32_t)((((uint64_t)_colID * 0x9E3779B97F4A7C15ULL) >> 32) % this->Shards.size());
+    }
+
+    bool save(const char* _filePath, clsASM::enuFileFormat _format);
+    bool load(const char* _filePath, bool _throw);
+
+    static std::string shardPath(const char* _filePath, uint32_t _shard);
+
+public:
+    std::vector<std::unique_ptr<clsShard>> Shards;
+    std::atomic<uint64_t>                  LoadGeneration;
+};
+
+}
+#endif // CLSSHARDEDASM_P_H
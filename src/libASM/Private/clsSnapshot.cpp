@@ -0,0 +1,161 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014 S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ */
+
+#include <stdexcept>
+#include <fstream>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "clsSnapshot.h"
+
+namespace AdaptiveSequenceMemorizer{
+
+/*************************************************************************************************************/
+clsMappedSnapshot::clsMappedSnapshot()
+{
+    this->MappedData = NULL;
+    this->MappedSize = 0;
+    this->Header = NULL;
+    this->ColumnIDs = NULL;
+}
+
+/*************************************************************************************************************/
+clsMappedSnapshot::~clsMappedSnapshot()
+{
+    this->close();
+}
+
+/*************************************************************************************************************/
+void clsMappedSnapshot::open(const char *_filePath)
+{
+    this->close();
+
+    int FD = ::open(_filePath, O_RDONLY);
+    if (FD < 0)
+        throw std::logic_error(std::string("Unable to open snapshot: ") + _filePath);
+
+    struct stat FileStat;
+    if (fstat(FD, &FileStat) != 0 || (size_t)FileStat.st_size < sizeof(stuSnapshotHeader)){
+        ::close(FD);
+        throw std::logic_error(std::string("Invalid snapshot size: ") + _filePath);
+    }
+
+    void* Data = mmap(NULL, FileStat.st_size, PROT_READ, MAP_SHARED, FD, 0);
+    ::close(FD);
+    if (Data == MAP_FAILED)
+        throw std::logic_error(std::string("Unable to map snapshot: ") + _filePath);
+
+    this->MappedData = Data;
+    this->MappedSize = FileStat.st_size;
+    try{
+        this->attach((const char*)Data, this->MappedSize);
+    }catch(...){
+        this->close();
+        throw;
+    }
+}
+
+/*************************************************************************************************************/
+void clsMappedSnapshot::open(std::vector<char> &&_image)
+{
+    this->close();
+    if (_image.size() < sizeof(stuSnapshotHeader))
+        throw std::logic_error("Invalid snapshot size");
+
+    this->Image = std::move(_image);
+    try{
+        this->attach(this->Image.data(), this->Image.size());
+    }catch(...){
+        this->close();
+        throw;
+    }
+}
+
+/*************************************************************************************************************/
+void clsMappedSnapshot::attach(const char *_data, size_t _size)
+{
+    this->Header = (const stuSnapshotHeader*)_data;
+
+    const stuSnapshotHeader& H = *this->Header;
+    const char* Base = _data;
+    if (memcmp(H.Magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+        throw std::logic_error("Invalid snapshot magic");
+    if (H.EndianMark != SNAPSHOT_ENDIAN_MARK)
+        throw std::logic_error("Snapshot has been created on a machine with different endianness");
+    if (H.Version != SNAPSHOT_VERSION || H.HeaderSize != sizeof(stuSnapshotHeader))
+        throw std::logic_error("Unsupported snapshot version: " + std::to_string(H.Version));
+    if (H.FileSize != _size)
+        throw std::logic_error("Snapshot is truncated");
+    if (H.CellCount >= INVALID_CELL_INDEX || H.SuccessorCount >= INVALID_CELL_INDEX)
+        throw std::logic_error("Snapshot is too large");
+
+    //Check bounds of all sections. Content of the sections is trusted in order to keep open time
+    //independent of the model size
+    bool Sparse = H.Flags & SNAPSHOT_FLAG_SPARSE_COLUMNS;
+    struct { uint64_t Offset; uint64_t Size; } Sections[] = {
+        {H.ColumnIDsOffset,      Sparse ? H.ColumnCount * sizeof(ColID_t) : 0},
+        {H.ColumnsOffset,        ((uint64_t)H.ColumnCount + 1) * sizeof(CellIndex_t)},
+        {H.CellsOffset,          H.CellCount * sizeof(stuSnapshotCell)},
+        {H.SuccessorFirstOffset, (H.CellCount + 1) * sizeof(CellIndex_t)},
+        {H.SuccessorsOffset,     H.SuccessorCount * sizeof(CellIndex_t)},
+    };
+    for (size_t i = 0; i < sizeof(Sections) / sizeof(Sections[0]); ++i)
+        if (Sections[i].Offset % 8 || Sections[i].Offset > _size ||
+                Sections[i].Size > _size - Sections[i].Offset)
+            throw std::logic_error("Invalid snapshot section: " + std::to_string(i));
+
+    this->ColumnIDs       = Sparse ? (const ColID_t*)(Base + H.ColumnIDsOffset) : NULL;
+    this->ColumnFirstCell = (const CellIndex_t*)(Base + H.ColumnsOffset);
+    this->Cells           = (const stuSnapshotCell*)(Base + H.CellsOffset);
+    this->SuccessorFirst  = (const CellIndex_t*)(Base + H.SuccessorFirstOffset);
+    this->Successors      = (const CellIndex_t*)(Base + H.SuccessorsOffset);
+
+    if (this->ColumnFirstCell[H.ColumnCount] != H.CellCount ||
+            this->SuccessorFirst[H.CellCount] != H.SuccessorCount)
+        throw std::logic_error("Snapshot sections are inconsistent");
+}
+
+/*************************************************************************************************************/
+void clsMappedSnapshot::close()
+{
+    if (this->MappedData)
+        munmap(this->MappedData, this->MappedSize);
+    this->Image = std::vector<char>();
+    this->MappedData = NULL;
+    this->MappedSize = 0;
+    this->Header = NULL;
+}
+
+/*************************************************************************************************************/
+bool clsMappedSnapshot::isSnapshot(const char *_filePath)
+{
+    std::ifstream File(_filePath, std::ios::binary);
+    char Magic[sizeof(SNAPSHOT_MAGIC)];
+    return File.read(Magic, sizeof(Magic)) && memcmp(Magic, SNAPSHOT_MAGIC, sizeof(Magic)) == 0;
+}
+
+}
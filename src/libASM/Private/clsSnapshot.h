@@ -0,0 +1,217 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014 S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ */
+
+#ifndef CLSSNAPSHOT_H
+#define CLSSNAPSHOT_H
+
+#include <cstddef>
+#include <algorithm>
+#include <vector>
+#include "clsCell.h"
+
+namespace AdaptiveSequenceMemorizer{
+
+/**
+ * Binary snapshot layout. All the sections are flat arrays of native endian values aligned on 8 bytes:
+ *  - stuSnapshotHeader
+ *  - ColumnIDs[ColumnCount]: sorted ColIDs of the columns. Just on sparse snapshots (SNAPSHOT_FLAG_SPARSE_COLUMNS)
+ *  - ColumnFirstCell[ColumnCount + 1]: cells of I'th column are [ColumnFirstCell[I], ColumnFirstCell[I + 1]).
+ *    On dense snapshots ColID of I'th column is I + 1
+ *  - Cells[CellCount]: cells ordered by column and then ZIndex so global index of a cell is it's position and
+ *    ZIndex of a cell is it's distance from the first cell of it's column. Connections refer to global indexes
+ *  - SuccessorFirst[CellCount + 1]: successors of cell I are Successors[SuccessorFirst[I] .. SuccessorFirst[I + 1])
+ *  - Successors[SuccessorCount]: global index of cells connected to each cell in pool order. Frozen images
+ *    (SNAPSHOT_FLAG_CONNECTED_SUCCESSORS) keep just the successors whose permanence is not less than
+ *    MinPermanence2Connect as others are never predicted. Destinations of the cells are complete on both.
+ */
+static const char     SNAPSHOT_MAGIC[4] = {'A','S','M','B'};
+static const uint32_t SNAPSHOT_VERSION = 3;
+static const uint32_t SNAPSHOT_ENDIAN_MARK = 0x01020304;
+static const uint32_t SNAPSHOT_FLAG_SPARSE_COLUMNS = 0x01;
+static const uint32_t SNAPSHOT_FLAG_CONNECTED_SUCCESSORS = 0x02;
+
+struct stuSnapshotHeader
+{
+    char          Magic[4];
+    uint32_t      Version;
+    uint32_t      EndianMark;
+    uint32_t      HeaderSize;
+    Permanence_t  InitialConnectionPermanence;
+    Permanence_t  MinPermanence2Connect;
+    Permanence_t  PermanenceIncVal;
+    Permanence_t  PermanenceDecVal;
+    uint32_t      ColumnCount;
+    uint32_t      Flags;
+    uint64_t      CellCount;
+    uint64_t      SuccessorCount;
+    uint64_t      ColumnIDsOffset;
+    uint64_t      ColumnsOffset;
+    uint64_t      CellsOffset;
+    uint64_t      SuccessorFirstOffset;
+    uint64_t      SuccessorsOffset;
+    uint64_t      FileSize;
+};
+
+struct stuSnapshotCell
+{
+    ColID_t       ColID;
+    /// Global index of the destination cell or INVALID_CELL_INDEX if cell has no connection
+    CellIndex_t   Destination;
+    Permanence_t  Permanence;
+    uint8_t       States;
+    uint8_t       Reserved;
+};
+
+/**
+ * @brief The clsMappedSnapshot class maps a binary snapshot to memory and provides read only access to it's
+ * sections without copying them. Pages will be loaded by OS on demand so opening a snapshot is independent
+ * of model size.
+ */
+class clsMappedSnapshot
+{
+public:
+    clsMappedSnapshot();
+    ~clsMappedSnapshot();
+
+    /**
+     * @brief open maps file and validates header and section bounds. throws std::logic_error on errors
+     */
+    void open(const char* _filePath);
+    /**
+     * @brief open takes ownership of a snapshot written to memory (@see clsSnapshotImage) and validates it
+     */
+    void open(std::vector<char>&& _image);
+    void close();
+
+    /**
+     * @brief isSnapshot checks whether the file starts with the binary snapshot magic
+     */
+    static bool isSnapshot(const char* _filePath);
+
+    inline bool isOpen() const{
+        return this->Header != NULL;
+    }
+
+    inline const stuSnapshotHeader& header() const{
+        return *this->Header;
+    }
+
+    /**
+     * @brief columnCount number of column slots in the snapshot
+     */
+    inline uint32_t columnCount() const{
+        return this->Header->ColumnCount;
+    }
+
+    inline ColID_t slotColID(uint32_t _slot) const{
+        return this->ColumnIDs ? this->ColumnIDs[_slot] : _slot + 1;
+    }
+
+    inline CellIndex_t slotFirstCell(uint32_t _slot) const{
+        return this->ColumnFirstCell[_slot];
+    }
+
+    /**
+     * @brief columnRange finds cells of a column. Sparse snapshots are searched using binary search
+     * @return false if column has no cell
+     */
+    inline bool columnRange(ColID_t _colID, CellIndex_t& _first, CellIndex_t& _end) const{
+        uint32_t Slot;
+        if (this->ColumnIDs){
+            const ColID_t* Found = std::lower_bound(this->ColumnIDs,
+                                                    this->ColumnIDs + this->Header->ColumnCount,
+                                                    _colID);
+            if (Found == this->ColumnIDs + this->Header->ColumnCount || *Found != _colID)
+                return false;
+            Slot = Found - this->ColumnIDs;
+        }else{
+            if (_colID == 0 || _colID > this->Header->ColumnCount)
+                return false;
+            Slot = _colID - 1;
+        }
+        _first = this->ColumnFirstCell[Slot];
+        _end = this->ColumnFirstCell[Slot + 1];
+        return _first != _end;
+    }
+
+    inline const stuSnapshotCell& cell(CellIndex_t _index) const{
+        return this->Cells[_index];
+    }
+
+    inline const CellIndex_t* successorsBegin(CellIndex_t _index) const{
+        return this->Successors + this->SuccessorFirst[_index];
+    }
+
+    inline const CellIndex_t* successorsEnd(CellIndex_t _index) const{
+        return this->Successors + this->SuccessorFirst[_index + 1];
+    }
+
+    /**
+     * @brief align8 Sections of the snapshot are aligned to 8 bytes
+     */
+    static inline uint64_t align8(uint64_t _offset){
+        return (_offset + 7) & ~(uint64_t)7;
+    }
+
+private:
+    clsMappedSnapshot(const clsMappedSnapshot&);
+    clsMappedSnapshot& operator = (const clsMappedSnapshot&);
+
+    /**
+     * @brief attach validates header and section bounds of the data and points sections to it
+     */
+    void attach(const char* _data, size_t _size);
+
+private:
+    void*                    MappedData;
+    size_t                   MappedSize;
+    /// Snapshots opened from memory own their image instead of mapped pages
+    std::vector<char>        Image;
+    const stuSnapshotHeader* Header;
+    const ColID_t*           ColumnIDs;
+    const CellIndex_t*       ColumnFirstCell;
+    const stuSnapshotCell*   Cells;
+    const CellIndex_t*       SuccessorFirst;
+    const CellIndex_t*       Successors;
+};
+
+/**
+ * @brief The clsSnapshotImage class is an output stream writing a snapshot to memory. It provides just the
+ * members used by the snapshot writer so the same writer serves both files and in-memory images.
+ */
+class clsSnapshotImage
+{
+public:
+    inline void write(const char* _data, size_t _size){
+        this->Data.insert(this->Data.end(), _data, _data + _size);
+    }
+
+    inline uint64_t tellp() const{
+        return this->Data.size();
+    }
+
+public:
+    std::vector<char> Data;
+};
+
+}
+#endif // CLSSNAPSHOT_H
@@ -0,0 +1,146 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014 S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ */
+
+#include <sstream>
+#include "clsStats.h"
+
+namespace AdaptiveSequenceMemorizer{
+
+static std::atomic<uint64_t> LastStatsID(0);
+
+/*************************************************************************************************************/
+clsStats::clsStats()
+{
+    this->ID = ++LastStatsID;
+}
+
+/*************************************************************************************************************/
+clsStats::stuThreadStats* clsStats::registerThread()
+{
+    std::lock_guard<std::mutex> Lock(this->Lock);
+    for (auto BlockIter = this->Threads.begin(); BlockIter != this->Threads.end(); BlockIter++)
+        if ((*BlockIter)->Owner == std::this_thread::get_id())
+            return BlockIter->get();
+    this->Threads.push_back(std::unique_ptr<stuThreadStats>(new stuThreadStats));
+    return this->Threads.back().get();
+}
+
+/*************************************************************************************************************/
+void clsStats::aggregate(clsASM::Stats &_stats) const
+{
+    uint64_t Counters[COUNTER_Count] = {0};
+    clsASM::Stats::Histogram* Histograms[HISTOGRAM_Count] = {&_stats.FanOut, &_stats.ScannedCells, &_stats.LatencyNS};
+    for (auto Histogram : Histograms)
+        *Histogram = clsASM::Stats::Histogram();
+
+    std::lock_guard<std::mutex> Lock(this->Lock);
+    for (auto BlockIter = this->Threads.begin(); BlockIter != this->Threads.end(); BlockIter++){
+        const stuThreadStats& Block = **BlockIter;
+        for (int i = 0; i < COUNTER_Count; ++i)
+            Counters[i] += Block.Counters[i].load(std::memory_order_relaxed);
+        for (int i = 0; i < HISTOGRAM_Count; ++i){
+            for (int Bucket = 0; Bucket < clsASM::Stats::Histogram::BUCKETS; ++Bucket){
+                uint64_t Count = Block.Buckets[i][Bucket].load(std::memory_order_relaxed);
+                Histograms[i]->Buckets[Bucket] += Count;
+                Histograms[i]->Count += Count;
+            }
+            Histograms[i]->Sum += Block.Sums[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    _stats.Steps[clsASM::LearningFrozen] = Counters[COUNTER_StepsFrozen];
+    _stats.Steps[clsASM::AwardAndPunishment] = Counters[COUNTER_StepsAwardAndPunishment];
+    _stats.Steps[clsASM::LearningFull] = Counters[COUNTER_StepsFull];
+    _stats.SequenceResets = Counters[COUNTER_SequenceResets];
+    _stats.CellsCreated = Counters[COUNTER_CellsCreated];
+    _stats.CellsRewarded = Counters[COUNTER_CellsRewarded];
+    _stats.CellsPunished = Counters[COUNTER_CellsPunished];
+    _stats.CellsDecayed = Counters[COUNTER_CellsDecayed];
+    _stats.EvictedCells = Counters[COUNTER_CellsEvicted];
+    _stats.PredictionHits = Counters[COUNTER_PredictionHits];
+    _stats.PredictionMisses = Counters[COUNTER_PredictionMisses];
+    _stats.PredictionsEmitted = Counters[COUNTER_PredictionsEmitted];
+    _stats.CellsScanned = Counters[COUNTER_CellsScanned];
+    _stats.Allocations = Counters[COUNTER_Allocations];
+}
+
+/*************************************************************************************************************/
+uint64_t clsASM::Stats::Histogram::percentile(double _p) const
+{
+    if (this->Count == 0)
+        return 0;
+    uint64_t Rank = (uint64_t)(_p * this->Count + 0.5);
+    uint64_t Seen = 0;
+    for (int Bucket = 0; Bucket < BUCKETS; ++Bucket)
+        if ((Seen += this->Buckets[Bucket]) >= Rank && Seen)
+            return upperBound(Bucket);
+    return upperBound(BUCKETS - 1);
+}
+
+/*************************************************************************************************************/
+std::string clsASM::Stats::toText(const std::string &_prefix) const
+{
+    std::ostringstream Text;
+    auto metric = [&Text, &_prefix](const char* _type, const std::string& _name, double _value){
+        Text<<"# TYPE "<<_prefix<<"_"<<_name<<" "<<_type<<"\n"<<_prefix<<"_"<<_name<<" "<<_value<<"\n";
+    };
+    auto histogram = [&Text, &_prefix](const std::string& _name, const Histogram& _histogram){
+        std::string Name = _prefix + "_" + _name;
+        Text<<"# TYPE "<<Name<<" histogram\n";
+        uint64_t Cumulative = 0;
+        for (int Bucket = 0; Bucket < Histogram::BUCKETS - 1; ++Bucket){
+            Cumulative += _histogram.Buckets[Bucket];
+            Text<<Name<<"_bucket{le=\""<<Histogram::upperBound(Bucket)<<"\"} "<<Cumulative<<"\n";
+        }
+        Text<<Name<<"_bucket{le=\"+Inf\"} "<<_histogram.Count<<"\n";
+        Text<<Name<<"_sum "<<_histogram.Sum<<"\n";
+        Text<<Name<<"_count "<<_histogram.Count<<"\n";
+    };
+
+    Text.precision(15);
+    metric("gauge", "cells", this->Cells);
+    metric("gauge", "removed_cells", this->RemovedCells);
+    metric("gauge", "pool_bytes", this->PoolBytes);
+    metric("counter", "compactions_total", this->Compactions);
+    Text<<"# TYPE "<<_prefix<<"_steps_total counter\n";
+    const char* Levels[] = {"frozen", "award_and_punishment", "full"};
+    for (int Level = 0; Level < 3; ++Level)
+        Text<<_prefix<<"_steps_total{level=\""<<Levels[Level]<<"\"} "<<this->Steps[Level]<<"\n";
+    metric("counter", "sequence_resets_total", this->SequenceResets);
+    metric("counter", "cells_created_total", this->CellsCreated);
+    metric("counter", "cells_rewarded_total", this->CellsRewarded);
+    metric("counter", "cells_punished_total", this->CellsPunished);
+    metric("counter", "cells_decayed_total", this->CellsDecayed);
+    metric("counter", "cells_evicted_total", this->EvictedCells);
+    metric("counter", "prediction_hits_total", this->PredictionHits);
+    metric("counter", "prediction_misses_total", this->PredictionMisses);
+    metric("counter", "predictions_emitted_total", this->PredictionsEmitted);
+    metric("counter", "cells_scanned_total", this->CellsScanned);
+    metric("counter", "allocations_total", this->Allocations);
+    histogram("prediction_fanout", this->FanOut);
+    histogram("scanned_cells", this->ScannedCells);
+    histogram("step_latency_ns", this->LatencyNS);
+    metric("gauge", "uptime_seconds", this->Uptime);
+    return Text.str();
+}
+
+}
@@ -0,0 +1,219 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014 S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ */
+
+#ifndef CLSSTATS_H
+#define CLSSTATS_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <memory>
+#include "clsASM.h"
+
+/**
+ * Instrumentation of the hot path is compiled just when ASM_STATS is defined (@see ASM_STATS option in CMake).
+ * Otherwise clsASMPrivate has no statistics member at all and the macros below expand to unevaluated sizeof
+ * operands, so their arguments are not evaluated but variables used just by them are not reported as unused.
+ * Macro arguments must not have side effects as they are evaluated just when statistics are enabled.
+ */
+#ifdef ASM_STATS
+#define ASM_STATS_ADD(_counter, _value) this->Stats.local().add(clsStats::_counter, _value)
+#define ASM_STATS_STEP(_learningLevel, _predictions) \
+    clsStats::clsStepScope StatsStep(this->Stats.local(), _learningLevel, _predictions)
+#define ASM_STATS_STEP_ADD(_counter, _value) StatsStep.stats().add(clsStats::_counter, _value)
+#else
+#define ASM_STATS_ADD(_counter, _value) (void)sizeof(_value)
+#define ASM_STATS_STEP(_learningLevel, _predictions) (void)sizeof(_learningLevel, _predictions)
+#define ASM_STATS_STEP_ADD(_counter, _value) (void)sizeof(_value)
+#endif
+
+namespace AdaptiveSequenceMemorizer{
+
+/**
+ * @brief The clsStats class keeps statistics counters of a model. Each thread updates it's own block of counters
+ * so the hot path needs neither atomic read-modify-write nor shared cache lines. Blocks are aggregated when
+ * statistics are read.
+ */
+class clsStats
+{
+public:
+    enum enuCounter{
+        COUNTER_StepsFrozen,
+        COUNTER_StepsAwardAndPunishment,
+        COUNTER_StepsFull,
+        COUNTER_SequenceResets,
+        COUNTER_CellsCreated,
+        COUNTER_CellsRewarded,
+        COUNTER_CellsPunished,
+        COUNTER_CellsDecayed,
+        COUNTER_CellsEvicted,
+        COUNTER_PredictionHits,
+        COUNTER_PredictionMisses,
+        COUNTER_PredictionsEmitted,
+        COUNTER_CellsScanned,
+        COUNTER_Allocations,
+        COUNTER_Count
+    };
+
+    enum enuHistogram{
+        HISTOGRAM_FanOut,
+        HISTOGRAM_CellsScanned,
+        HISTOGRAM_LatencyNS,
+        HISTOGRAM_Count
+    };
+
+    /// Latency is measured on one of each LATENCY_SAMPLING steps of each thread as reading clock costs as much
+    /// as a short step
+    enum { LATENCY_SAMPLING = 16 };
+
+    /// Number of models whose counter blocks are cached by each thread (@see local)
+    enum { CACHED_MODELS = 8 };
+
+    /**
+     * @brief The stuThreadStats struct is the block of counters owned by a single thread. Just the owner
+     * writes to the block so counters are updated by relaxed load and store. Cells scanned are also kept for
+     * the current step of the thread in order to be recorded on the histogram when step finishes.
+     */
+    struct alignas(64) stuThreadStats{
+        std::thread::id        Owner;
+        std::atomic<uint64_t>  Counters[COUNTER_Count];
+        std::atomic<uint64_t>  Buckets[HISTOGRAM_Count][clsASM::Stats::Histogram::BUCKETS];
+        std::atomic<uint64_t>  Sums[HISTOGRAM_Count];
+        uint64_t               StepCellsScanned;
+        uint32_t               StepNumber;
+
+        stuThreadStats(){
+            this->Owner = std::this_thread::get_id();
+            for (auto& Counter : this->Counters)
+                Counter = 0;
+            for (auto& Histogram : this->Buckets)
+                for (auto& Bucket : Histogram)
+                    Bucket = 0;
+            for (auto& Sum : this->Sums)
+                Sum = 0;
+            this->StepCellsScanned = 0;
+            this->StepNumber = 0;
+        }
+
+        inline void add(enuCounter _counter, uint64_t _value){
+            increase(this->Counters[_counter], _value);
+            if (_counter == COUNTER_CellsScanned)
+                this->StepCellsScanned += _value;
+        }
+
+        inline void record(enuHistogram _histogram, uint64_t _value){
+            increase(this->Buckets[_histogram][clsASM::Stats::Histogram::bucket(_value)], 1);
+            increase(this->Sums[_histogram], _value);
+        }
+
+    private:
+        static inline void increase(std::atomic<uint64_t>& _counter, uint64_t _value){
+            _counter.store(_counter.load(std::memory_order_relaxed) + _value, std::memory_order_relaxed);
+        }
+    };
+
+    /**
+     * @brief The clsStepScope class counts a step and records it's latency, prediction fan-out and cells
+     * scanned when the step finishes whatever path it returns from. Counters of the step are updated through
+     * the scope (@see ASM_STATS_STEP_ADD) so thread local storage is looked up once per step.
+     */
+    class clsStepScope
+    {
+    public:
+        clsStepScope(stuThreadStats& _stats,
+                     clsASM::enuLearningLevel _learningLevel,
+                     const std::vector<clsASM::stuPrediction>& _predictions) :
+            Stats(_stats), Predictions(_predictions), StartCapacity(_predictions.capacity())
+        {
+            this->Stats.add((enuCounter)(COUNTER_StepsFrozen + _learningLevel), 1);
+            this->Stats.StepCellsScanned = 0;
+            this->Timed = ++this->Stats.StepNumber % LATENCY_SAMPLING == 0;
+            if (this->Timed)
+                this->Start = std::chrono::steady_clock::now();
+        }
+
+        ~clsStepScope(){
+            if (this->Timed)
+                this->Stats.record(HISTOGRAM_LatencyNS, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                       std::chrono::steady_clock::now() - this->Start).count());
+            size_t FanOut = this->Predictions.size();
+            this->Stats.add(COUNTER_PredictionsEmitted, FanOut);
+            this->Stats.add(COUNTER_Allocations, this->Predictions.capacity() != this->StartCapacity);
+            this->Stats.record(HISTOGRAM_FanOut, FanOut);
+            this->Stats.record(HISTOGRAM_CellsScanned, this->Stats.StepCellsScanned);
+        }
+
+        inline stuThreadStats& stats(){
+            return this->Stats;
+        }
+
+    private:
+        stuThreadStats&                       Stats;
+        const std::vector<clsASM::stuPrediction>& Predictions;
+        size_t                                StartCapacity;
+        bool                                  Timed;
+        std::chrono::steady_clock::time_point Start;
+    };
+
+public:
+    clsStats();
+
+    /**
+     * @brief local returns counters of the calling thread on this model. Blocks of the last CACHED_MODELS models
+     * used by the thread are cached so a thread switching between a few models (e.g. shards) will not look up
+     * it's block under lock on each step.
+     */
+    inline stuThreadStats& local(){
+        thread_local struct{
+            uint64_t        IDs[CACHED_MODELS];
+            stuThreadStats* Blocks[CACHED_MODELS];
+            uint32_t        NextSlot;
+        } Cached = {};
+        for (uint32_t Slot = 0; Slot < CACHED_MODELS; ++Slot)
+            if (Cached.IDs[Slot] == this->ID)
+                return *Cached.Blocks[Slot];
+        //Oldest cached block is replaced, blocks of destroyed models are never matched as IDs are unique
+        uint32_t Slot = Cached.NextSlot++ % CACHED_MODELS;
+        Cached.Blocks[Slot] = this->registerThread();
+        Cached.IDs[Slot] = this->ID;
+        return *Cached.Blocks[Slot];
+    }
+
+    /**
+     * @brief aggregate sums counters of all the threads to _stats
+     */
+    void aggregate(clsASM::Stats& _stats) const;
+
+private:
+    stuThreadStats* registerThread();
+
+private:
+    /// Unique ID of the statistics so cached blocks of a destroyed model will never be used for a new one
+    uint64_t                                     ID;
+    mutable std::mutex                           Lock;
+    std::vector<std::unique_ptr<stuThreadStats>> Threads;
+};
+
+}
+#endif // CLSSTATS_H
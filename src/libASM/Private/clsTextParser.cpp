@@ -0,0 +1,249 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014 S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ */
+
+#include <stdexcept>
+#include <fstream>
+#include <cstring>
+#include <charconv>
+#include <limits>
+#include <thread>
+
+#include "clsTextParser.h"
+
+namespace AdaptiveSequenceMemorizer{
+
+/// Chunks smaller than this will not be parsed on a separate thread
+static const size_t MIN_CHUNK_SIZE = 1 << 20;
+
+/**
+ * @brief parseNumber parses an unsigned decimal number at _pos and moves _pos after it
+ * @return false if there is no number at _pos or number does not fit in _value
+ */
+template <typename T>
+static inline bool parseNumber(const char*& _pos, const char* _end, T& _value)
+{
+    uint64_t Value;
+    std::from_chars_result Result = std::from_chars(_pos, _end, Value);
+    if (Result.ec != std::errc() || Value > std::numeric_limits<T>::max())
+        return false;
+    _value = (T)Value;
+    _pos = Result.ptr;
+    return true;
+}
+
+/*************************************************************************************************************/
+clsTextModelParser::clsTextModelParser()
+{
+    for (int i = 0; i < CONFIG_COUNT; ++i){
+        this->ConfigSeen[i] = false;
+        this->ConfigValues[i] = 0;
+    }
+    this->MaxColumns = 0;
+}
+
+/*************************************************************************************************************/
+void clsTextModelParser::parse(const char *_filePath, unsigned _maxThreads)
+{
+    std::ifstream File(_filePath, std::ios::binary);
+    if (File.is_open() == false)
+        throw std::logic_error(std::string("Unable to open file: ") + _filePath);
+    File.seekg(0, std::ios::end);
+    this->Buffer.resize((size_t)File.tellg());
+    File.seekg(0, std::ios::beg);
+    if (File.read(this->Buffer.data(), this->Buffer.size()).fail())
+        throw std::logic_error(std::string("Unable to read file: ") + _filePath);
+
+    const char* Pos = this->Buffer.data();
+    const char* End = Pos + this->Buffer.size();
+    const size_t SeparatorLength = strlen(::FILE_SEGMENT_SEPARATOR);
+    size_t Line = 0;
+
+    //Parse configs until segment separator
+    while(Pos < End){
+        const char* LineEnd = (const char*)memchr(Pos, '\n', End - Pos);
+        if (LineEnd == NULL)
+            LineEnd = End;
+        Line++;
+
+        if ((size_t)(LineEnd - Pos) == SeparatorLength &&
+                memcmp(Pos, ::FILE_SEGMENT_SEPARATOR, SeparatorLength) == 0){
+            Pos = LineEnd + 1;
+            break;
+        }
+
+        const char* Colon = (const char*)memchr(Pos, ':', LineEnd - Pos);
+        if (Colon == NULL)
+            throw std::logic_error("Colon missing on line: " + std::to_string(Line));
+        std::string Key(Pos, Colon);
+        const char* Value = Colon + 1;
+        if (Key.empty() || Value == LineEnd)
+            throw std::logic_error("Data missing on line: " + std::to_string(Line));
+
+        int ConfigIndex = -1;
+        if (Key == "ICP") ConfigIndex = CONFIG_ICP;
+        else if (Key == "MPC") ConfigIndex = CONFIG_MPC;
+        else if (Key == "PDV") ConfigIndex = CONFIG_PDV;
+        else if (Key == "PIV") ConfigIndex = CONFIG_PIV;
+        else if (Key == "SCD") ConfigIndex = CONFIG_SCD;
+        else if (Key != "MCS")
+            throw std::logic_error("Invalid identifier <" + Key + "> on line: " + std::to_string(Line));
+
+        bool Parsed = ConfigIndex >= 0 ?
+                    parseNumber(Value, LineEnd, this->ConfigValues[ConfigIndex]) :
+                    parseNumber(Value, LineEnd, this->MaxColumns);
+        if (Parsed == false || Value != LineEnd)
+            throw std::logic_error("Invalid value on line: " + std::to_string(Line));
+        if (ConfigIndex >= 0)
+            this->ConfigSeen[ConfigIndex] = true;
+        Pos = LineEnd + 1;
+    }
+
+    if (Pos >= End)
+        return;
+
+    //Split column section to line aligned chunks
+    unsigned Threads = _maxThreads ? _maxThreads : std::thread::hardware_concurrency();
+    size_t MaxChunks = (End - Pos) / MIN_CHUNK_SIZE + 1;
+    if (Threads == 0)
+        Threads = 1;
+    if (Threads > MaxChunks)
+        Threads = MaxChunks;
+
+    this->Chunks.resize(Threads);
+    const char* ChunkBegin = Pos;
+    for (unsigned i = 0; i < Threads; ++i){
+        const char* ChunkEnd = (i == Threads - 1) ? End : Pos + (End - Pos) * (i + 1) / Threads;
+        if (ChunkEnd < ChunkBegin)
+            ChunkEnd = ChunkBegin;
+        if (ChunkEnd < End){
+            ChunkEnd = (const char*)memchr(ChunkEnd, '\n', End - ChunkEnd);
+            ChunkEnd = ChunkEnd ? ChunkEnd + 1 : End;
+        }
+        this->Chunks[i].Begin = ChunkBegin;
+        this->Chunks[i].End = ChunkEnd;
+        this->Chunks[i].Lines = 0;
+        this->Chunks[i].HasError = false;
+        ChunkBegin = ChunkEnd;
+    }
+
+    auto parseSafe = [this](stuChunk& _chunk){
+        try{
+            this->parseChunk(_chunk);
+        }catch(std::exception& e){
+            _chunk.HasError = true;
+            _chunk.ErrorLine = _chunk.Lines;
+            _chunk.Error = e.what();
+        }
+    };
+
+    std::vector<std::thread> Workers;
+    for (unsigned i = 1; i < Threads; ++i)
+        Workers.push_back(std::thread(parseSafe, std::ref(this->Chunks[i])));
+    parseSafe(this->Chunks[0]);
+    for (auto WorkerIter = Workers.begin(); WorkerIter != Workers.end(); WorkerIter++)
+        WorkerIter->join();
+
+    //Report first error in the file
+    for (auto ChunkIter = this->Chunks.begin(); ChunkIter != this->Chunks.end(); ChunkIter++){
+        if (ChunkIter->HasError)
+            throw std::logic_error(ChunkIter->Error + " on line: " +
+                                   std::to_string(Line + ChunkIter->ErrorLine + 1));
+        Line += ChunkIter->Lines;
+    }
+}
+
+/*************************************************************************************************************/
+void clsTextModelParser::parseChunk(stuChunk &_chunk) const
+{
+    const char* Pos = _chunk.Begin;
+    const char* End = _chunk.End;
+    uint32_t ZIndex = 0;
+
+    auto fail = [&](const char* _error, bool _reportCell){
+        _chunk.HasError = true;
+        _chunk.ErrorLine = _chunk.Lines;
+        _chunk.Error = _error;
+        if (_reportCell)
+            _chunk.Error += " for cell: " + std::to_string(ZIndex);
+    };
+
+    while(Pos < End){
+        const char* LineEnd = (const char*)memchr(Pos, '\n', End - Pos);
+        if (LineEnd == NULL)
+            LineEnd = End;
+
+        ZIndex = 0;
+        ColID_t ColID;
+        const char* Colon = (const char*)memchr(Pos, ':', LineEnd - Pos);
+        if (Colon == NULL)
+            return fail("Colon missing at first", false);
+        if (Colon == Pos || Colon + 1 == LineEnd || Colon[1] != '[' || LineEnd[-1] != ']')
+            return fail("Data missing", false);
+        if (parseNumber(Pos, Colon, ColID) == false || Pos != Colon)
+            return fail("Invalid column ID", false);
+        if (ColID == 0 || ColID > this->MaxColumns)
+            return fail("Invalid column ID", false);
+
+        Pos = Colon + 1;
+        while (Pos < LineEnd){
+            stuCell Cell;
+            if (*Pos++ != '[')
+                return fail("Invalid cell", true);
+
+            if (*Pos == ':')
+                return fail("States missing", true);
+            if (parseNumber(Pos, LineEnd, Cell.States) == false)
+                return fail("Invalid states", true);
+            if (*Pos++ != ':')
+                return fail("Colon missing", true);
+
+            Cell.DestColID = NOT_ASSIGNED;
+            if (*Pos != ':' && parseNumber(Pos, LineEnd, Cell.DestColID) == false)
+                return fail("Invalid destination column", true);
+            if (*Pos++ != ':')
+                return fail("Second Colon missing", true);
+
+            Cell.DestZIndex = 0;
+            if (*Pos != ':' && parseNumber(Pos, LineEnd, Cell.DestZIndex) == false)
+                return fail("Invalid destination ZIndex", true);
+            if (*Pos++ != ':')
+                return fail("Third Colon missing", true);
+
+            if (*Pos == ']')
+                return fail("Permanence missing", true);
+            if (parseNumber(Pos, LineEnd, Cell.Permanence) == false)
+                return fail("Invalid permanence", true);
+            if (*Pos++ != ']')
+                return fail("Invalid cell", true);
+
+            _chunk.Cells.push_back(Cell);
+            ZIndex++;
+        }
+
+        _chunk.ColIDs.push_back(ColID);
+        _chunk.CellCounts.push_back(ZIndex);
+        _chunk.Lines++;
+        Pos = LineEnd + 1;
+    }
+}
+
+}
@@ -0,0 +1,98 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014 S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ */
+
+#ifndef CLSTEXTPARSER_H
+#define CLSTEXTPARSER_H
+
+#include <vector>
+#include <string>
+#include "clsCell.h"
+
+extern const char* FILE_SEGMENT_SEPARATOR;
+
+namespace AdaptiveSequenceMemorizer{
+
+/**
+ * @brief The clsTextModelParser class parses models saved in text format.
+ * Whole file is read to a single buffer and after the header, column section is split to line aligned
+ * chunks which are parsed in parallel as each column line is independent of the others. Parsed cells are
+ * kept in file order so they can be added to the model without any further parsing.
+ */
+class clsTextModelParser
+{
+public:
+    struct stuCell{
+        ColID_t       DestColID;
+        ZIndex_t      DestZIndex;
+        Permanence_t  Permanence;
+        uint8_t       States;
+    };
+
+    struct stuChunk{
+        const char*           Begin;
+        const char*           End;
+        size_t                Lines;
+        std::vector<ColID_t>  ColIDs;
+        std::vector<uint32_t> CellCounts;
+        std::vector<stuCell>  Cells;
+        bool                  HasError;
+        size_t                ErrorLine;
+        std::string           Error;
+    };
+
+public:
+    clsTextModelParser();
+
+    /**
+     * @brief parse reads and parses whole file. Throws std::logic_error reporting line and cell of the
+     * first error in the file.
+     * @param _maxThreads maximum number of threads used to parse columns. 0 means all available cores
+     */
+    void parse(const char* _filePath, unsigned _maxThreads = 0);
+
+    inline bool hasConfig(int _index) const {return this->ConfigSeen[_index];}
+    inline Permanence_t config(int _index) const {return this->ConfigValues[_index];}
+    inline size_t maxColumns() const {return this->MaxColumns;}
+    inline const std::vector<stuChunk>& chunks() const {return this->Chunks;}
+
+    enum enuConfig{
+        CONFIG_ICP,
+        CONFIG_MPC,
+        CONFIG_PDV,
+        CONFIG_PIV,
+        CONFIG_SCD,
+        CONFIG_COUNT
+    };
+
+private:
+    void parseChunk(stuChunk& _chunk) const;
+
+private:
+    std::vector<char>     Buffer;
+    std::vector<stuChunk> Chunks;
+    bool                  ConfigSeen[CONFIG_COUNT];
+    Permanence_t          ConfigValues[CONFIG_COUNT];
+    size_t                MaxColumns;
+};
+
+}
+#endif // CLSTEXTPARSER_H
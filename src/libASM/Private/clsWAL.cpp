@@ -0,0 +1,370 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014 S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ */
+
+#include <stdexcept>
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "clsWAL.h"
+#include "clsJournal.h"
+
+namespace AdaptiveSequenceMemorizer{
+
+/*************************************************************************************************************/
+clsWAL::clsWAL()
+{
+    this->Open = false;
+    this->FD = -1;
+    this->Epoch = 0;
+    this->NextSessionID = 0;
+    this->GroupCommitSize = 0;
+    this->SyncOnCommit = false;
+    this->RecordCount = 0;
+    this->LastStepsOffset = NO_RECORD;
+}
+
+/*************************************************************************************************************/
+clsWAL::~clsWAL()
+{
+    try{
+        this->close();
+    }catch(...){
+    }
+}
+
+/*************************************************************************************************************/
+void clsWAL::open(const std::string &_path,
+                  uint64_t _snapshotFingerprint,
+                  uint32_t _maintenanceInterval,
+                  Permanence_t _maintenanceDecay,
+                  uint32_t _groupCommitSize,
+                  bool _syncOnCommit)
+{
+    this->close();
+    this->FD = ::open(_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (this->FD < 0)
+        throw std::logic_error("Unable to open WAL: " + _path);
+    this->Path = _path;
+
+    stuWALHeader Header;
+    memset(&Header, 0, sizeof(Header));
+    memcpy(Header.Magic, WAL_MAGIC, sizeof(WAL_MAGIC));
+    Header.Version = WAL_VERSION;
+    Header.EndianMark = SNAPSHOT_ENDIAN_MARK;
+    Header.HeaderSize = sizeof(stuWALHeader);
+    Header.SnapshotFingerprint = _snapshotFingerprint;
+    Header.MaintenanceInterval = _maintenanceInterval;
+    Header.MaintenanceDecay = _maintenanceDecay;
+    if (::write(this->FD, &Header, sizeof(Header)) != sizeof(Header) ||
+            (_syncOnCommit && ::fdatasync(this->FD) != 0)){
+        this->closeFile();
+        throw std::logic_error("Unable to write WAL: " + _path);
+    }
+
+    this->Epoch++;
+    this->NextSessionID = 0;
+    this->GroupCommitSize = _groupCommitSize;
+    this->SyncOnCommit = _syncOnCommit;
+    this->Buffer.clear();
+    this->Buffer.reserve(_groupCommitSize + sizeof(stuWALGroupHeader) + sizeof(stuWALRecord));
+    this->RecordCount = 0;
+    this->LastStepsOffset = NO_RECORD;
+    this->Open = true;
+}
+
+/*************************************************************************************************************/
+void clsWAL::close()
+{
+    if (this->isOpen() == false)
+        return;
+    this->commit();
+    this->closeFile();
+}
+
+/*************************************************************************************************************/
+void clsWAL::commit()
+{
+    if (this->isOpen() == false || this->RecordCount == 0)
+        return;
+
+    //Group header is reserved on the start of the buffer so the group is written by a single call
+    stuWALGroupHeader* Header = (stuWALGroupHeader*)this->Buffer.data();
+    Header->RecordCount = this->RecordCount;
+    Header->PayloadSize = this->Buffer.size() - sizeof(stuWALGroupHeader);
+    Header->Checksum = clsJournal::checksum(this->Buffer.data() + sizeof(stuWALGroupHeader), Header->PayloadSize);
+
+    const char* Data = this->Buffer.data();
+    size_t      Remaining = this->Buffer.size();
+    while (Remaining){
+        ssize_t Written = ::write(this->FD, Data, Remaining);
+        if (Written < 0 && errno == EINTR)
+            continue;
+        if (Written <= 0){
+            this->closeFile();
+            throw std::logic_error("Unable to write WAL: " + this->Path);
+        }
+        Data += Written;
+        Remaining -= Written;
+    }
+    if (this->SyncOnCommit && ::fdatasync(this->FD) != 0){
+        this->closeFile();
+        throw std::logic_error("Unable to sync WAL: " + this->Path);
+    }
+
+    this->Buffer.clear();
+    this->RecordCount = 0;
+    this->LastStepsOffset = NO_RECORD;
+}
+
+/*************************************************************************************************************/
+uint32_t clsWAL::appendSession(bool _default, const stuWALSession &_state, const std::vector<stuWALLocation> &_predicted)
+{
+    uint32_t SessionID = this->NextSessionID++;
+    size_t Offset = this->appendRecord(WAL_RECORD_Session,
+                                       _default ? WAL_SESSION_DEFAULT : 0,
+                                       SessionID,
+                                       _predicted.size(),
+                                       sizeof(stuWALSession) + _predicted.size() * sizeof(stuWALLocation));
+    char* Body = this->Buffer.data() + Offset + sizeof(stuWALRecord);
+    memcpy(Body, &_state, sizeof(stuWALSession));
+    if (_predicted.size())
+        memcpy(Body + sizeof(stuWALSession), _predicted.data(), _predicted.size() * sizeof(stuWALLocation));
+    this->commitIfFull();
+    return SessionID;
+}
+
+/*************************************************************************************************************/
+void clsWAL::appendSteps(uint32_t _sessionID, uint8_t _learningLevel, const ColID_t *_inputs, size_t _count)
+{
+    //Large buffers are split so a group never grows much more than group commit size
+    size_t MaxStepsPerGroup = std::max<size_t>(this->GroupCommitSize / sizeof(ColID_t), 1);
+    while (_count){
+        size_t Count = std::min(_count, MaxStepsPerGroup);
+        stuWALRecord* Last = this->LastStepsOffset == NO_RECORD ?
+                                 NULL : (stuWALRecord*)(this->Buffer.data() + this->LastStepsOffset);
+        if (Last &&
+                Last->SessionID == _sessionID &&
+                Last->Flags == _learningLevel &&
+                Last->Count <= UINT32_MAX - Count){
+            //Consecutive steps of a session are kept on a single record
+            Last->Count += Count;
+            this->Buffer.insert(this->Buffer.end(), (const char*)_inputs, (const char*)(_inputs + Count));
+        }else{
+            size_t Offset = this->appendRecord(WAL_RECORD_Steps, _learningLevel, _sessionID, Count,
+                                               Count * sizeof(ColID_t));
+            memcpy(this->Buffer.data() + Offset + sizeof(stuWALRecord), _inputs, Count * sizeof(ColID_t));
+            this->LastStepsOffset = Offset;
+        }
+        _inputs += Count;
+        _count -= Count;
+        this->commitIfFull();
+    }
+}
+
+/*************************************************************************************************************/
+void clsWAL::appendFeedback(uint32_t _sessionID, ColID_t _colID, double _score)
+{
+    stuWALFeedback Feedback;
+    memset(&Feedback, 0, sizeof(Feedback));
+    Feedback.ColID = _colID;
+    Feedback.Score = _score;
+    size_t Offset = this->appendRecord(WAL_RECORD_Feedback, 0, _sessionID, 0, sizeof(Feedback));
+    memcpy(this->Buffer.data() + Offset + sizeof(stuWALRecord), &Feedback, sizeof(Feedback));
+    this->commitIfFull();
+}
+
+/*************************************************************************************************************/
+void clsWAL::appendCompaction()
+{
+    this->appendRecord(WAL_RECORD_Compaction, 0, 0, 0, 0);
+    this->commitIfFull();
+}
+
+/*************************************************************************************************************/
+void clsWAL::appendMaintenance(Permanence_t _decay)
+{
+    this->appendRecord(WAL_RECORD_Maintenance, 0, 0, _decay, 0);
+    this->commitIfFull();
+}
+
+/*************************************************************************************************************/
+size_t clsWAL::appendRecord(uint8_t _type, uint8_t _flags, uint32_t _sessionID, uint32_t _count, size_t _bodySize)
+{
+    if (this->Buffer.empty())
+        this->Buffer.resize(sizeof(stuWALGroupHeader));
+    size_t Offset = this->Buffer.size();
+    this->Buffer.resize(Offset + sizeof(stuWALRecord) + _bodySize);
+    stuWALRecord* Record = (stuWALRecord*)(this->Buffer.data() + Offset);
+    Record->Type = _type;
+    Record->Flags = _flags;
+    Record->Reserved = 0;
+    Record->SessionID = _sessionID;
+    Record->Count = _count;
+    this->RecordCount++;
+    this->LastStepsOffset = NO_RECORD;
+    return Offset;
+}
+
+/*************************************************************************************************************/
+void clsWAL::closeFile()
+{
+    this->Open = false;
+    if (this->FD >= 0)
+        ::close(this->FD);
+    this->FD = -1;
+    this->Buffer.clear();
+    this->RecordCount = 0;
+    this->LastStepsOffset = NO_RECORD;
+}
+
+/*************************************************************************************************************/
+uint64_t clsWAL::replay(const std::string &_path,
+                        uint64_t _snapshotFingerprint,
+                        uint32_t _maintenanceInterval,
+                        Permanence_t _maintenanceDecay,
+                        const RecordFn_t &_fn)
+{
+    std::ifstream File(_path.c_str(), std::ios::binary | std::ios::ate);
+    if (File.is_open() == false)
+        throw std::logic_error("Unable to open WAL: " + _path);
+    uint64_t FileSize = File.tellg();
+    File.seekg(0);
+
+    stuWALHeader Header;
+    if (File.read((char*)&Header, sizeof(Header)).fail() ||
+            memcmp(Header.Magic, WAL_MAGIC, sizeof(WAL_MAGIC)) != 0)
+        throw std::logic_error("Invalid WAL: " + _path);
+    if (Header.EndianMark != SNAPSHOT_ENDIAN_MARK)
+        throw std::logic_error("WAL has been created on a machine with different endianness: " + _path);
+    if (Header.Version != WAL_VERSION || Header.HeaderSize != sizeof(stuWALHeader))
+        throw std::logic_error("Unsupported WAL version: " + std::to_string(Header.Version));
+    if (Header.SnapshotFingerprint != _snapshotFingerprint)
+        throw std::logic_error("WAL does not belong to the snapshot: " + _path);
+    //Scheduled sweeps are not logged so they are repeated just by a model scheduling the same ones
+    if (Header.MaintenanceInterval != _maintenanceInterval ||
+            (_maintenanceInterval && Header.MaintenanceDecay != _maintenanceDecay))
+        throw std::logic_error("WAL has been written with other maintenance configs: " + _path);
+
+    uint64_t Position = sizeof(Header);
+    uint64_t Replayed = 0;
+    stuWALGroupHeader GroupHeader;
+    std::vector<char> Payload;
+    while (File.read((char*)&GroupHeader, sizeof(GroupHeader))){
+        if (GroupHeader.PayloadSize > FileSize - Position - sizeof(GroupHeader))
+            break;
+        Payload.resize(GroupHeader.PayloadSize);
+        if (File.read(Payload.data(), Payload.size()).fail() ||
+                clsJournal::checksum(Payload.data(), Payload.size()) != GroupHeader.Checksum)
+            break;
+
+        //Structure of the group is checked completely before it is replayed
+        size_t Offset = 0;
+        for (uint32_t i = 0; i < GroupHeader.RecordCount; ++i){
+            stuWALRecord Record;
+            if (Payload.size() - Offset < sizeof(Record))
+                throw std::logic_error("Invalid WAL group: " + _path);
+            memcpy(&Record, Payload.data() + Offset, sizeof(Record));
+            Offset += sizeof(Record);
+            size_t BodySize;
+            switch (Record.Type){
+            case WAL_RECORD_Session:
+                BodySize = sizeof(stuWALSession) + (size_t)Record.Count * sizeof(stuWALLocation);
+                break;
+            case WAL_RECORD_Steps:
+                BodySize = (size_t)Record.Count * sizeof(ColID_t);
+                break;
+            case WAL_RECORD_Feedback:
+                BodySize = sizeof(stuWALFeedback);
+                break;
+            case WAL_RECORD_Compaction:
+            case WAL_RECORD_Maintenance:
+                BodySize = 0;
+                break;
+            default:
+                throw std::logic_error("Invalid WAL record type: " + std::to_string(Record.Type));
+            }
+            if (Payload.size() - Offset < BodySize)
+                throw std::logic_error("Invalid WAL group: " + _path);
+            Offset += BodySize;
+        }
+        if (Offset != Payload.size())
+            throw std::logic_error("Invalid WAL group: " + _path);
+
+        for (Offset = 0; Offset < Payload.size(); ++Replayed){
+            const stuWALRecord* Record = (const stuWALRecord*)(Payload.data() + Offset);
+            Offset += sizeof(stuWALRecord);
+            _fn(*Record, Payload.data() + Offset);
+            switch (Record->Type){
+            case WAL_RECORD_Session:
+                Offset += sizeof(stuWALSession) + (size_t)Record->Count * sizeof(stuWALLocation);
+                break;
+            case WAL_RECORD_Steps:
+                Offset += (size_t)Record->Count * sizeof(ColID_t);
+                break;
+            case WAL_RECORD_Feedback:
+                Offset += sizeof(stuWALFeedback);
+                break;
+            default:
+                break;
+            }
+        }
+        Position += sizeof(GroupHeader) + Payload.size();
+    }
+    return Replayed;
+}
+
+/*************************************************************************************************************/
+uint64_t clsWAL::fingerprint(const std::string &_path)
+{
+    std::ifstream File(_path.c_str(), std::ios::binary);
+    if (File.is_open() == false)
+        throw std::logic_error("Unable to open file: " + _path);
+
+    //FNV-1a
+    uint64_t Hash = 14695981039346656037ull;
+    std::vector<char> Buffer(64 * 1024);
+    while (File.read(Buffer.data(), Buffer.size()) || File.gcount())
+        for (std::streamsize i = 0; i < File.gcount(); ++i)
+            Hash = (Hash ^ (uint8_t)Buffer[i]) * 1099511628211ull;
+    if (File.bad())
+        throw std::logic_error("Unable to read file: " + _path);
+    return Hash;
+}
+
+/*************************************************************************************************************/
+void clsWAL::syncFile(const std::string &_path)
+{
+    int FD = ::open(_path.c_str(), O_RDONLY);
+    if (FD < 0)
+        throw std::logic_error("Unable to open file: " + _path);
+    bool Synced = ::fsync(FD) == 0;
+    ::close(FD);
+    if (Synced == false)
+        throw std::logic_error("Unable to sync file: " + _path);
+}
+
+}
@@ -0,0 +1,237 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014 S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ */
+
+#ifndef CLSWAL_H
+#define CLSWAL_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include "clsSnapshot.h"
+
+namespace AdaptiveSequenceMemorizer{
+
+/**
+ * Input write ahead log layout. A WAL belongs to the snapshot written when it has been started and keeps a
+ * fingerprint of the snapshot contents so a WAL left from another snapshot (i.e. on a crash after the snapshot
+ * has been replaced but before the WAL has been truncated) is rejected. All values are native endian:
+ *  - stuWALHeader
+ *  - Groups of records committed together, each one as stuWALGroupHeader followed by PayloadSize bytes of
+ *    RecordCount records. Each record is a stuWALRecord followed by:
+ *    - WAL_RECORD_Session: stuWALSession and Count stuWALLocation of the predicted cells
+ *    - WAL_RECORD_Steps: Count inputs (ColID_t) shown to the session with learning level kept on Flags
+ *    - WAL_RECORD_Feedback: stuWALFeedback
+ *    - WAL_RECORD_Compaction: nothing
+ *    - WAL_RECORD_Maintenance: nothing. Decay of the sweep is kept on Count
+ * Model is a deterministic function of it's inputs so just inputs are logged. Position of each session is
+ * logged before it's first input so sessions which have been in the middle of a sequence are restored too.
+ * Compactions made automatically are repeated by replay but the ones requested by the user are logged as they
+ * renumber cells. Likewise maintenance sweeps scheduled by MaintenanceInterval are repeated by replay as the
+ * step counter is restarted when the WAL is started, while the ones requested by the user are logged. Interval
+ * and decay of the scheduled sweeps are kept on the header so a model with other configs does not replay them. A group
+ * which has not been completely written fails it's checksum and is ignored along with anything after it. Sizes of all the records are multiple of 4 so inputs can be replayed in place.
+ */
+static const char     WAL_MAGIC[4] = {'A','S','M','W'};
+static const uint32_t WAL_VERSION = 4;
+static const uint8_t  WAL_SESSION_DEFAULT = 0x01;
+
+enum enuWALRecord{
+    WAL_RECORD_Session = 1,
+    WAL_RECORD_Steps,
+    WAL_RECORD_Feedback,
+    WAL_RECORD_Compaction,
+    WAL_RECORD_Maintenance
+};
+
+struct stuWALHeader
+{
+    char          Magic[4];
+    uint32_t      Version;
+    uint32_t      EndianMark;
+    uint32_t      HeaderSize;
+    /// Fingerprint of the snapshot which WAL has been started from (@see clsWAL::fingerprint)
+    uint64_t      SnapshotFingerprint;
+    /// Configs::MaintenanceInterval and Configs::MaintenanceDecay of the model which has written the WAL
+    uint32_t      MaintenanceInterval;
+    uint32_t      MaintenanceDecay;
+};
+
+struct stuWALGroupHeader
+{
+    uint32_t      RecordCount;
+    uint32_t      Checksum;
+    uint64_t      PayloadSize;
+};
+
+struct stuWALRecord
+{
+    uint8_t       Type;
+    uint8_t       Flags;
+    uint16_t      Reserved;
+    uint32_t      SessionID;
+    uint32_t      Count;
+};
+
+struct stuWALLocation
+{
+    ColID_t       ColID;
+    ZIndex_t      ZIndex;
+};
+
+struct stuWALSession
+{
+    uint64_t       SumPathPermanence;
+    uint32_t       PathItems;
+    ColID_t        LastActiveColumn;
+    /// Location of the last learning cell. ColID is NOT_ASSIGNED if there is no learning cell
+    stuWALLocation LastLearningCell;
+    uint8_t        FirstPattern;
+    uint8_t        Reserved[7];
+};
+
+struct stuWALFeedback
+{
+    ColID_t       ColID;
+    uint32_t      Reserved;
+    double        Score;
+};
+
+/**
+ * @brief The clsWAL class writes input write ahead logs. Records are buffered and written as a single group
+ * when the buffer exceeds group commit size or commit() is called so cost of the write (and sync) is shared by
+ * all the records of the group. It is not thread safe. Methods throw std::logic_error on errors and the log is
+ * closed on write errors.
+ */
+class clsWAL
+{
+public:
+    typedef std::function<void(const stuWALRecord& _record, const char* _body)> RecordFn_t;
+
+public:
+    clsWAL();
+    ~clsWAL();
+
+    /**
+     * @brief open creates an empty WAL replacing any existing file and starts a new epoch
+     * @param _maintenanceInterval interval of the sweeps scheduled on the model which will be repeated by replay
+     * @param _maintenanceDecay decay of the scheduled sweeps
+     * @param _groupCommitSize buffered bytes which will be committed automatically
+     * @param _syncOnCommit sync each committed group to the disk so it survives a system crash too
+     */
+    void open(const std::string& _path,
+              uint64_t _snapshotFingerprint,
+              uint32_t _maintenanceInterval,
+              Permanence_t _maintenanceDecay,
+              uint32_t _groupCommitSize,
+              bool _syncOnCommit);
+
+    /**
+     * @brief close commits pending records and closes the WAL
+     */
+    void close();
+
+    /**
+     * @brief commit writes buffered records as a group
+     */
+    void commit();
+
+    /**
+     * @brief isOpen can be checked without synchronization to skip logging when WAL is not used
+     */
+    inline bool isOpen() const{
+        return this->Open.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief epoch is increased each time a WAL is opened. Sessions are logged once on each epoch
+     */
+    inline uint64_t epoch() const{
+        return this->Epoch;
+    }
+
+    /**
+     * @brief appendSession logs position of a session which is seen for the first time on this epoch
+     * @return ID which next records of the session must use
+     */
+    uint32_t appendSession(bool _default, const stuWALSession& _state, const std::vector<stuWALLocation>& _predicted);
+    void appendSteps(uint32_t _sessionID, uint8_t _learningLevel, const ColID_t* _inputs, size_t _count);
+    void appendFeedback(uint32_t _sessionID, ColID_t _colID, double _score);
+    void appendCompaction();
+    void appendMaintenance(Permanence_t _decay);
+
+    /**
+     * @brief replay calls _fn on each record of the WAL in order. Groups are verified before being replayed so
+     * a torn group at the end is not replayed.
+     * @param _snapshotFingerprint fingerprint of the snapshot which the WAL must have been started from
+     * @param _maintenanceInterval interval of the sweeps scheduled on the replaying model which must match the
+     * one of the WAL, as well as @see _maintenanceDecay
+     * @return number of replayed records
+     */
+    static uint64_t replay(const std::string& _path,
+                           uint64_t _snapshotFingerprint,
+                           uint32_t _maintenanceInterval,
+                           Permanence_t _maintenanceDecay,
+                           const RecordFn_t& _fn);
+
+    /**
+     * @brief fingerprint returns 64 bit FNV-1a hash of a file contents or throws if it can not be read
+     */
+    static uint64_t fingerprint(const std::string& _path);
+
+    /**
+     * @brief syncFile syncs contents of a file which has been written by other means to the disk
+     */
+    static void syncFile(const std::string& _path);
+
+private:
+    /**
+     * @brief appendRecord appends a record header and reserves @see _bodySize bytes after it
+     * @return offset of the record on the buffer
+     */
+    size_t appendRecord(uint8_t _type, uint8_t _flags, uint32_t _sessionID, uint32_t _count, size_t _bodySize);
+
+    inline void commitIfFull(){
+        if (this->Buffer.size() >= this->GroupCommitSize)
+            this->commit();
+    }
+
+    void closeFile();
+
+private:
+    static const size_t NO_RECORD = SIZE_MAX;
+
+    std::atomic<bool>  Open;
+    int                FD;
+    std::string        Path;
+    uint64_t           Epoch;
+    uint32_t           NextSessionID;
+    uint32_t           GroupCommitSize;
+    bool               SyncOnCommit;
+    std::vector<char>  Buffer;
+    uint32_t           RecordCount;
+    /// Offset of the last record on the buffer if it is a steps record so next inputs extend it
+    size_t             LastStepsOffset;
+};
+
+}
+#endif // CLSWAL_H
@@ -24,47 +24,189 @@
 #include <iostream>
 #include <fstream>
 #include <climits>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <cstring>
 
 #include "clsASM.h"
+#include "clsFrozenASM.h"
 #include "Private/clsASM_p.h"
+#include "Private/clsFrozenASM_p.h"
+#include "Private/clsTextParser.h"
 
 const char* FILE_SEGMENT_SEPARATOR = "**********";
 
 namespace AdaptiveSequenceMemorizer{
+
+/// Removed cells are reclaimed when they are more than this ratio of the pool
+static const CellIndex_t COMPACTION_REMOVED_RATIO = 4;
+/// Small number of removed cells does not worth compaction
+static const CellIndex_t COMPACTION_MIN_REMOVED_CELLS = 4096;
+/// Maximum number of cells visited by eviction sweep to evict a single cell
+static const CellIndex_t EVICTION_SCAN_LIMIT = 32;
+/// Number of unused cells compared by eviction sweep to choose the one with least permanence
+static const CellIndex_t EVICTION_SAMPLES = 4;
+/// Maximum evictions per new cell so models loaded over the budget will converge to it while learning
+static const CellIndex_t EVICTIONS_PER_NEW_CELL = 2;
+
 /*************************************************************************************************************/
 clsASM::clsASM(Configs _configs):
     pPrivate(new clsASMPrivate(_configs))
 {
 }
 
+/*************************************************************************************************************/
+clsASM::Session::Session():
+    pPrivate(new clsSessionPrivate)
+{
+}
+
+/*************************************************************************************************************/
+clsASM::Session::~Session()
+{
+    delete this->pPrivate;
+}
+
+/*************************************************************************************************************/
+const clsASM::Prediction_t& clsASM::Session::predictions() const
+{
+    return this->pPrivate->predictionList();
+}
+
+/*************************************************************************************************************/
+clsASM::PredictionSpan clsASM::Session::predictionSpan() const
+{
+    return this->pPrivate->predictionSpan();
+}
+
 /*************************************************************************************************************/
 const clsASM::Prediction_t& clsASM::executeOnce(ColID_t _input,
                                                 enuLearningLevel _learningLevel)
 {
-    this->pPrivate->executeOnce(_input, _learningLevel);
-    return this->pPrivate->predictedCols();
+    this->pPrivate->executeOnce(this->pPrivate->defaultSession(), _input, _learningLevel);
+    return this->pPrivate->defaultSession().predictionList();
+}
+
+/*************************************************************************************************************/
+const clsASM::Prediction_t& clsASM::executeOnce(Session& _session,
+                                                ColID_t _input,
+                                                enuLearningLevel _learningLevel)
+{
+    this->pPrivate->executeOnce(*_session.pPrivate, _input, _learningLevel);
+    return _session.pPrivate->predictionList();
+}
+
+/*************************************************************************************************************/
+size_t clsASM::executeOnce(ColID_t _input,
+                           stuPrediction* _output,
+                           size_t _capacity,
+                           enuLearningLevel _learningLevel)
+{
+    this->pPrivate->executeOnce(this->pPrivate->defaultSession(), _input, _learningLevel);
+    return this->pPrivate->defaultSession().copyPredictions(_output, _capacity);
+}
+
+/*************************************************************************************************************/
+size_t clsASM::executeOnce(Session& _session,
+                           ColID_t _input,
+                           stuPrediction* _output,
+                           size_t _capacity,
+                           enuLearningLevel _learningLevel)
+{
+    this->pPrivate->executeOnce(*_session.pPrivate, _input, _learningLevel);
+    return _session.pPrivate->copyPredictions(_output, _capacity);
+}
+
+/*************************************************************************************************************/
+clsASM::PredictionSpan clsASM::predictionSpan() const
+{
+    return this->pPrivate->defaultSession().predictionSpan();
 }
 
 /*************************************************************************************************************/
 const clsASM::Prediction_t &clsASM::execute(intfInputIterator *_inputGenerator,
                                             int32_t _ticks,
                                             enuLearningLevel _learningLevel)
+{
+    clsSessionPrivate& DefaultSession = this->pPrivate->defaultSession();
+    ColID_t ColID;
+    this->pPrivate->executeOnce(DefaultSession, 0, _learningLevel);
+
+    if (_ticks > 0)
+        _ticks--;
+    while((ColID = _inputGenerator->next()) != NOT_ASSIGNED)
+    {
+        this->pPrivate->executeOnce(DefaultSession, ColID, _learningLevel);
+
+        if(_ticks == 0)
+            break;
+        else if (_ticks > 0)
+            _ticks--;
+    }
+    return DefaultSession.predictionList();
+}
+
+/*************************************************************************************************************/
+const clsASM::Prediction_t &clsASM::execute(Session& _session,
+                                            intfInputIterator *_inputGenerator,
+                                            int32_t _ticks,
+                                            enuLearningLevel _learningLevel)
 {
     ColID_t ColID;
-    Prediction_t& Predictions = (Prediction_t&)this->executeOnce(0);
+    this->pPrivate->executeOnce(*_session.pPrivate, 0, _learningLevel);
 
     if (_ticks > 0)
         _ticks--;
     while((ColID = _inputGenerator->next()) != NOT_ASSIGNED)
     {
-        Predictions = (Prediction_t&)this->executeOnce(ColID,_learningLevel);
+        this->pPrivate->executeOnce(*_session.pPrivate, ColID, _learningLevel);
 
         if(_ticks == 0)
             break;
         else if (_ticks > 0)
             _ticks--;
     }
-    return Predictions;
+    return _session.predictions();
+}
+
+/*************************************************************************************************************/
+void clsASM::executeBulk(const ColID_t* _inputs, size_t _count, enuLearningLevel _learningLevel)
+{
+    this->executeBulk(NULL, _inputs, _count, _learningLevel);
+}
+
+/*************************************************************************************************************/
+void clsASM::executeBulk(Session& _session,
+                         const ColID_t* _inputs,
+                         size_t _count,
+                         enuLearningLevel _learningLevel)
+{
+    this->executeBulk(&_session, _inputs, _count, _learningLevel);
+}
+
+/*************************************************************************************************************/
+void clsASM::executeBulk(Session* _session,
+                         const ColID_t* _inputs,
+                         size_t _count,
+                         enuLearningLevel _learningLevel)
+{
+    this->pPrivate->executeBulk(_session ? *_session->pPrivate : this->pPrivate->defaultSession(),
+                                _inputs,
+                                _count,
+                                _learningLevel);
+}
+
+/*************************************************************************************************************/
+clsASM::PathPredictionSpan clsASM::predictAhead(uint32_t _steps, uint32_t _beamWidth) const
+{
+    return this->pPrivate->predictAhead(this->pPrivate->defaultSession(), _steps, _beamWidth);
+}
+
+/*************************************************************************************************************/
+clsASM::PathPredictionSpan clsASM::predictAhead(Session& _session, uint32_t _steps, uint32_t _beamWidth) const
+{
+    return this->pPrivate->predictAhead(*_session.pPrivate, _steps, _beamWidth);
 }
 
 /*************************************************************************************************************/
@@ -73,28 +215,146 @@ void clsASM::feedback(ColID_t _colID, double _score)
     if (_colID == 0 && _score > 0)
         return;
 
-    this->pPrivate->feedback(_colID, _score);
+    this->pPrivate->feedback(this->pPrivate->defaultSession(), _colID, _score);
+}
+
+/*************************************************************************************************************/
+void clsASM::feedback(Session& _session, ColID_t _colID, double _score)
+{
+    if (_colID == 0 && _score > 0)
+        return;
+
+    this->pPrivate->feedback(*_session.pPrivate, _colID, _score);
+}
+
+/*************************************************************************************************************/
+bool clsASM::load(const char *_filePath, bool _throw, enuLoadMode _mode)
+{
+    return this->pPrivate->load(_filePath, _throw, _mode);
+}
+
+/*************************************************************************************************************/
+bool clsASM::save(const char *_filePath, enuFileFormat _format)
+{
+    return this->pPrivate->save(_filePath, _format);
+}
+
+/*************************************************************************************************************/
+bool clsASM::checkpoint(const char *_basePath, bool _fold)
+{
+    return this->pPrivate->checkpoint(_basePath, _fold);
+}
+
+/*************************************************************************************************************/
+std::future<bool> clsASM::saveAsync(const char *_filePath, enuFileFormat _format, std::function<void(bool)> _onDone)
+{
+    return this->pPrivate->saveAsync(_filePath, _format, _onDone);
+}
+
+/*************************************************************************************************************/
+bool clsASM::startWAL(const char *_snapshotPath,
+                      const char *_walPath,
+                      enuFileFormat _format,
+                      uint32_t _groupCommitSize,
+                      bool _syncOnCommit)
+{
+    return this->pPrivate->startWAL(_snapshotPath, _walPath, _format, _groupCommitSize, _syncOnCommit);
+}
+
+/*************************************************************************************************************/
+bool clsASM::commitWAL()
+{
+    return this->pPrivate->commitWAL();
+}
+
+/*************************************************************************************************************/
+bool clsASM::stopWAL()
+{
+    return this->pPrivate->stopWAL();
+}
+
+/*************************************************************************************************************/
+bool clsASM::recover(const char *_snapshotPath, const char *_walPath, bool _throw)
+{
+    return this->pPrivate->recover(_snapshotPath, _walPath, _throw);
+}
+
+/*************************************************************************************************************/
+bool clsASM::convert(const char *_inFilePath, const char *_outFilePath, enuFileFormat _outFormat, bool _throw)
+{
+    //Configs are replaced by the loaded ones but defaults may not fit narrow builds (ASM_PERMANENCE_BITS)
+    clsASM ASM(clsASM::Configs(0, 0, 0, 0));
+    return ASM.load(_inFilePath, _throw) && ASM.save(_outFilePath, _outFormat);
+}
+
+/*************************************************************************************************************/
+ColID_t clsASM::maxColID()
+{
+    return MAX_COLID;
+}
+
+/*************************************************************************************************************/
+Permanence_t clsASM::maxPermanence()
+{
+    return MAX_PERMANENCE;
+}
+
+/*************************************************************************************************************/
+void clsASM::compact()
+{
+    this->pPrivate->compact();
+}
+
+/*************************************************************************************************************/
+clsASM::MaintenanceReport clsASM::maintain(Permanence_t _decay)
+{
+    return this->pPrivate->maintain(_decay);
+}
+
+/*************************************************************************************************************/
+void clsASM::merge(const clsASM &_other, enuMergePolicy _policy)
+{
+    this->pPrivate->merge(*_other.pPrivate, _policy);
 }
 
 /*************************************************************************************************************/
-bool clsASM::load(const char *_filePath, bool _throw)
+clsFrozenASM clsASM::freeze()
 {
-    return this->pPrivate->load(_filePath, _throw);
+    return clsFrozenASM(this->pPrivate->freeze());
 }
 
 /*************************************************************************************************************/
-bool clsASM::save(const char *_filePath)
+clsASM::Stats clsASM::stats()
 {
-    return this->pPrivate->save(_filePath);
+    return this->pPrivate->stats();
 }
 
 /*************************************************************************************************************/
 clsASMPrivate::clsASMPrivate(clsASM::Configs _configs)
 {
-    this->LastLearningCell.clear();
     this->Configs = _configs;
-    this->PathItems = 0;
-    this->SumPathPermanence = 0;
+    this->Columns.setSparse(this->Configs.SparseColumns);
+    this->Generation = 0;
+    this->RemovedCells = 0;
+    this->CompactionEpoch = 0;
+    this->EvictionHand = 0;
+    this->MaintenanceSteps = 0;
+    this->CreationTime = std::chrono::steady_clock::now();
+    this->Snapshot = NULL;
+    if (this->Configs.ConcurrentLearning)
+        this->Pool.reserveChunkTable();
+    this->checkConfigs();
+}
+
+/*************************************************************************************************************/
+void clsASMPrivate::checkConfigs()
+{
+    if (std::max({this->Configs.InitialConnectionPermanence,
+                  this->Configs.MinPermanence2Connect,
+                  this->Configs.PermanenceIncVal,
+                  this->Configs.PermanenceDecVal}) > MAX_PERMANENCE)
+        throw std::logic_error("Permanence configs must not exceed " + std::to_string(MAX_PERMANENCE) +
+                               " on this build (ASM_PERMANENCE_BITS)");
 }
 
 /*************************************************************************************************************/
@@ -106,242 +366,266 @@ clsASMPrivate::~clsASMPrivate()
 /*************************************************************************************************************/
 void clsASMPrivate::reset()
 {
-    for (auto ColIter = this->Columns.begin();
-         ColIter != this->Columns.end();
-         ColIter++){
-        if (*ColIter == NULL)
-            continue;
+    this->Columns.clear();
+    this->Pool.clear();
+    delete this->Snapshot;
+    this->Snapshot = NULL;
+    this->RemovedCells = 0;
+    this->EvictionHand = 0;
+    this->MaintenanceSteps = 0;
+    this->CompactionRemap.clear();
+    this->Columns.setDirtyTracking(false);
+    this->Checkpoint.BasePath.clear();
+    //Cell locations kept in sessions are not valid anymore
+    this->Generation++;
+}
 
-        for(auto CellIter = (*ColIter)->begin();
-            CellIter != (*ColIter)->end();
-            CellIter++)
-            delete *CellIter;
-        (*ColIter)->clear();
+/*************************************************************************************************************/
+CellIndex_t clsASMPrivate::addCell(clsColumn& _column,
+                                   ColID_t _colID,
+                                   uint8_t _states,
+                                   CellIndex_t _destination,
+                                   Permanence_t _permanence)
+{
+    if (fitsCell(_colID, _permanence) == false)
+        throw std::logic_error("Cell does not fit on this build (ASM_COLID_BITS, ASM_PERMANENCE_BITS) on column: " +
+                               std::to_string(_colID));
+    CellIndex_t NewCellIndex;
+    {
+        std::unique_lock<std::mutex> PoolLock(this->PoolLock, std::defer_lock);
+        if (this->Configs.ConcurrentLearning)
+            PoolLock.lock();
+        NewCellIndex = this->Pool.append(clsCell(_colID, _states, _destination, _permanence));
     }
-    this->Columns.clear();
+    _column.push_back(NewCellIndex);
+    return NewCellIndex;
+}
+
+/*************************************************************************************************************/
+void clsASMPrivate::executeBulk(clsSessionPrivate& _session,
+                                const ColID_t* _inputs,
+                                size_t _count,
+                                clsASM::enuLearningLevel _learningLevel)
+{
+    this->checkInputs(_inputs, _count, _learningLevel);
+    if (this->WAL.isOpen())
+        this->logSteps(_session, _inputs, _count, _learningLevel);
+    const ColID_t* InputEnd = _inputs + _count;
+    for (const ColID_t* InputIter = _inputs; InputIter != InputEnd; ++InputIter)
+        this->executeStep(_session, *InputIter, _learningLevel);
+    //Just predictions of the last step can be read
+    _session.rankPredictions(this->Configs.MaxPredictions);
+}
+
+/*************************************************************************************************************/
+CellIndex_t clsASMPrivate::learnCell(clsColumn &_column,
+                                     ColID_t _colID,
+                                     CellIndex_t _destination,
+                                     Permanence_t _permanence)
+{
+    this->evictIfNeeded(_destination);
+    ASM_STATS_ADD(COUNTER_Allocations, _column.size() == _column.capacity());
+    CellIndex_t NewCellIndex = this->addCell(_column, _colID, 0, _destination, _permanence);
+    this->cell(NewCellIndex)->touch();
+    this->markDirty(NewCellIndex);
+    ASM_STATS_ADD(COUNTER_CellsCreated, 1);
+    return NewCellIndex;
 }
 
 /*************************************************************************************************************/
-void clsASMPrivate::executeOnce(ColID_t _activeColIndex, clsASM::enuLearningLevel _learningLevel)
+void clsASMPrivate::executeStep(clsSessionPrivate& _session,
+                                ColID_t _activeColIndex,
+                                clsASM::enuLearningLevel _learningLevel)
 {
-    this->PredictedCols.clear();
     //On NULL pattern clear all history
-    if (_activeColIndex == 0)
-    {
-        this->LastLearningCell.clear();
-        this->PredictedCells.clear();
-        this->FirstPattern = true;
-        this->LastActiveColumn = _activeColIndex;
-        this->PathItems = 0;
-        this->SumPathPermanence = 0;
-        return;
+    if (_activeColIndex == 0){
+        ASM_STATS_ADD(COUNTER_SequenceResets, 1);
+        return _session.restart();
+    }
+    ASM_STATS_STEP(_learningLevel, _session.PredictedCols);
+
+    //On concurrent learning each step holds model lock shared so model structure will not change meanwhile
+    std::shared_lock<std::shared_mutex> ModelLock(this->ModelLock, std::defer_lock);
+    if (this->Configs.ConcurrentLearning)
+        ModelLock.lock();
+
+    //Changes to the model structure are made before positioning session as model lock may be released
+    if (this->Snapshot && _learningLevel != clsASM::LearningFrozen)
+        this->exclusively(ModelLock, [this](){ this->ensureInMemory(); });
+
+    //Scheduled sweeps are counted on learning steps so replaying logged inputs repeats them on the same steps
+    if (this->Configs.MaintenanceInterval && _learningLevel != clsASM::LearningFrozen &&
+            (this->MaintenanceSteps.fetch_add(1) + 1) % this->Configs.MaintenanceInterval == 0)
+        this->exclusively(ModelLock, [this](){ this->maintainInLock(this->Configs.MaintenanceDecay); });
+
+    clsColumn* ActiveColumnPtr = this->Snapshot ? NULL : this->Columns.find(_activeColIndex, true);
+    if (this->Snapshot == NULL && ActiveColumnPtr == NULL && _learningLevel != clsASM::LearningFrozen){
+        //Columns are created empty and will get cells when necessary
+        this->exclusively(ModelLock, [this, _activeColIndex](){ this->Columns.get(_activeColIndex); });
+        ASM_STATS_STEP_ADD(COUNTER_Allocations, 1);
+        ActiveColumnPtr = this->Columns.find(_activeColIndex, true);
     }
 
-    this->PathItems++;
+    this->syncSession(_session);
+    _session.PredictedCols.clear();
+    _session.PredictionListStale = true;
+    _session.PathItems++;
+
+    if (this->Snapshot){
+        if (_learningLevel == clsASM::LearningFrozen){
+            CellIndex_t Scanned = this->executeOnceMapped(_session, _activeColIndex);
+            ASM_STATS_STEP_ADD(COUNTER_CellsScanned, Scanned);
+        }
+        return;
+    }
 
     //if input column has not yet been seen do nothing as nothing
     //related has been learnt
-    if (_learningLevel == clsASM::LearningFrozen &&
-            (_activeColIndex > this->Columns.size() ||
-             this->column(_activeColIndex) == NULL))
+    if (ActiveColumnPtr == NULL)
         return;
 
-    //Expand columns if necessary
-    if(_activeColIndex > this->Columns.size())
-        this->Columns.resize(_activeColIndex, NULL);
-
-    //Expansion creates Columns with no cell allocate when necessary
-    if (this->column(_activeColIndex) == NULL)
-        this->Columns[_activeColIndex - 1] = new clsColumn;
+    std::unique_lock<std::mutex> ColumnLock(this->columnLock(_activeColIndex), std::defer_lock);
+    if (ModelLock.owns_lock())
+        ColumnLock.lock();
+    clsColumn& ActiveColumn = *ActiveColumnPtr;
+    if (ActiveColumn.empty() && _learningLevel == clsASM::LearningFrozen)
+        return;
 
     //If this is the first pattern after NULL pattern
-    if (this->FirstPattern)
+    if (_session.FirstPattern)
     {
-        if (this->column(_activeColIndex)->empty())
-            this->column(_activeColIndex)->push_back(
-                    new clsCell(_activeColIndex, this->column(_activeColIndex)->size()));
-
-        for (auto CellIter = this->column(_activeColIndex)->begin();
-             CellIter != this->column(_activeColIndex)->end();
-             CellIter++)
-            this->setPredictionState(*CellIter);
-
-        this->LastLearningCell = this->column(_activeColIndex)->at(0)->loc();
-        this->FirstPattern = false;
-        this->LastActiveColumn = _activeColIndex;
-        return;
-    }
+        //Removed cells are skipped so the first live cell will be used to learn next step
+        CellIndex_t Scanned = ActiveColumn.size();
+        CellIndex_t FirstLiveCell = INVALID_CELL_INDEX;
+        for (auto CellIter = ActiveColumn.begin();
+             CellIter != ActiveColumn.end();
+             CellIter++){
+            if (this->cell(*CellIter)->isRemoved())
+                continue;
+            if (FirstLiveCell == INVALID_CELL_INDEX)
+                FirstLiveCell = *CellIter;
+            Scanned += this->setPredictionState(_session, *CellIter);
+        }
+        ASM_STATS_STEP_ADD(COUNTER_CellsScanned, Scanned);
 
-    clsCell* PredictiveCell = NULL;
-    for(auto CellIter = this->column(_activeColIndex)->begin();
-        CellIter != this->column(_activeColIndex)->end();
-        CellIter++)
-        if (this->cell((*CellIter)->loc())->wasPredicting())
-        {
-            PredictiveCell = (*CellIter);
-            break;
+        if (FirstLiveCell == INVALID_CELL_INDEX){
+            if (_learningLevel == clsASM::LearningFrozen)
+                return;
+            FirstLiveCell = this->learnCell(ActiveColumn, _activeColIndex, INVALID_CELL_INDEX, 0);
         }
+        if (_learningLevel != clsASM::LearningFrozen)
+            this->cell(FirstLiveCell)->touch();
+
+        _session.LastLearningCell = FirstLiveCell;
+        _session.FirstPattern = false;
+        _session.LastActiveColumn = _activeColIndex;
+        return;
+    }
 
-    if (PredictiveCell == NULL)
+    //Predicted cells which have been evicted since the previous step are skipped so the step is handled as a
+    //missed prediction just when no live cell of the column has been predicted
+    const clsSessionPrivate::stuPredictedCell* Predicted = _session.predictedCell(
+                _activeColIndex, [this](CellIndex_t _index){ return this->cell(_index)->isRemoved() == false; });
+    if (Predicted == NULL)
     {
+        if (_learningLevel != clsASM::LearningFrozen)
+            ASM_STATS_STEP_ADD(COUNTER_PredictionMisses, 1);
         if (_learningLevel == clsASM::LearningFull)
         {
             //Learn new prediction
-            clsCell* NewCell =
-                    new clsCell(_activeColIndex, this->column(_activeColIndex)->size());
-            NewCell->connection().Destination = this->LastLearningCell;
-            NewCell->connection().Permanence = this->Configs.InitialConnectionPermanence;
-            this->column(_activeColIndex)->push_back(NewCell);
+            CellIndex_t NewCellIndex = this->learnCell(ActiveColumn,
+                                                       _activeColIndex,
+                                                       _session.LastLearningCell,
+                                                       this->Configs.InitialConnectionPermanence);
+            if (_session.LastLearningCell != INVALID_CELL_INDEX)
+                this->appendSuccessor(_session.LastLearningCell, NewCellIndex);
         }
-        this->removeOldPredictions();
+        _session.PredictedCells.clear();
     }
     else
     {
-        this->LastLearningCell = PredictiveCell->loc();
-        this->SumPathPermanence += PredictiveCell->connection().Permanence;
+        CellIndex_t PredictiveCellIndex = Predicted->Index;
+        clsCell* PredictiveCell = this->cell(PredictiveCellIndex);
+        _session.LastLearningCell = PredictiveCellIndex;
+        _session.SumPathPermanence += PredictiveCell->permanence();
 
         if (_learningLevel != clsASM::LearningFrozen)
         {
+            ASM_STATS_STEP_ADD(COUNTER_PredictionHits, 1);
             //reinforce correct prediction
-            PredictiveCell->connection().Permanence = (
-                        SHRT_MAX - PredictiveCell->connection().Permanence < this->Configs.PermanenceIncVal ?
-                            SHRT_MAX :
-                            PredictiveCell->connection().Permanence + this->Configs.PermanenceIncVal);
-            for(auto CellIter = this->PredictedCells.begin();
-                CellIter != this->PredictedCells.end();
+            PredictiveCell->increasePermanence(this->Configs.PermanenceIncVal);
+            PredictiveCell->touch();
+            this->markDirty(PredictiveCellIndex);
+            ASM_STATS_STEP_ADD(COUNTER_CellsRewarded, 1);
+            for(auto CellIter = _session.PredictedCells.begin();
+                CellIter != _session.PredictedCells.end();
                 CellIter ++)
             {
+                clsCell* Cell = this->cell(CellIter->Index);
                 //weaken incorrect prediction on all cells except the correct predicted one
-                if (this->Configs.PermanenceDecVal && *CellIter != PredictiveCell->loc())
-                    this->cell(*CellIter)->connection().Permanence = (
-                            PredictiveCell->connection().Permanence < this->Configs.PermanenceDecVal ?
-                                0 :
-                                PredictiveCell->connection().Permanence - this->Configs.PermanenceDecVal
-                                );
-                if (this->cell(*CellIter)->connection().Permanence == 0)
-                    this->removeCell(*CellIter);
+                if (this->Configs.PermanenceDecVal && CellIter->Index != PredictiveCellIndex){
+                    Cell->decreasePermanence(this->Configs.PermanenceDecVal);
+                    this->markDirty(CellIter->Index);
+                }
+                if (Cell->permanence() == 0 && this->removeCell(CellIter->Index))
+                    ASM_STATS_STEP_ADD(COUNTER_CellsDecayed, 1);
             }
+            ASM_STATS_STEP_ADD(COUNTER_CellsPunished,
+                               this->Configs.PermanenceDecVal ? _session.PredictedCells.size() - 1 : 0);
         }
-        this->removeOldPredictions();
-        this->setPredictionState(this->cell(this->LastLearningCell));
+        CellIndex_t Scanned = _session.PredictedCells.size();
+        _session.PredictedCells.clear();
+        Scanned += this->setPredictionState(_session, PredictiveCellIndex);
+        ASM_STATS_STEP_ADD(COUNTER_CellsScanned, Scanned);
     }
-    this->LastActiveColumn = _activeColIndex;
+    _session.LastActiveColumn = _activeColIndex;
+
+    if (ColumnLock.owns_lock())
+        ColumnLock.unlock();
+    this->compactIfNeeded(ModelLock);
 }
 
 /*************************************************************************************************************/
-bool clsASMPrivate::load(const char *_filePath, bool _throw)
+bool clsASMPrivate::load(const char *_filePath, bool _throw, clsASM::enuLoadMode _mode)
 {
+    std::lock_guard<std::mutex> CheckpointLock(this->CheckpointLock);
+    std::unique_lock<std::shared_mutex> ModelLock(this->ModelLock, std::defer_lock);
+    if (this->Configs.ConcurrentLearning)
+        ModelLock.lock();
     try{
+        {
+            //Inputs learnt on the loaded model do not belong to the snapshot of the WAL
+            std::unique_lock<std::mutex> WALLock(this->WALLock, std::defer_lock);
+            if (this->Configs.ConcurrentLearning)
+                WALLock.lock();
+            this->WAL.close();
+        }
         this->reset();
 
-        std::ifstream File;
-        File.open(_filePath);
-        if (File.is_open()){
-            std::string Buff,Part1, Part2;
-            size_t SepLoc, Line=0;
-            bool ReadingConfigs = true;
-            while(std::getline(File, Buff)){
-                Line++;
-                if (ReadingConfigs){
-                    if (Buff == FILE_SEGMENT_SEPARATOR){
-                        ReadingConfigs = false;
-                        continue;
-                    }
-                    SepLoc = Buff.find(':');
-                    if (SepLoc == std::string::npos)
-                        throw std::logic_error("Colon missing on line: " + std::to_string(Line));
-
-                    Part1 = Buff.substr(0,SepLoc);
-                    Part2 = Buff.substr(SepLoc+1);
-                    if (Part1.empty() || Part2.empty())
-                        throw std::logic_error("Data missing on line: " + std::to_string(Line));
-
-                    if (Part1 == "ICP"){
-                        this->Configs.InitialConnectionPermanence = std::stoul(Part2);
-                    }else if (Part1 == "MPC"){
-                        this->Configs.MinPermanence2Connect = std::stoul(Part2);
-                    }else if (Part1 == "PDV"){
-                        this->Configs.PermanenceDecVal = std::stoul(Part2);
-                    }else if (Part1 == "PIV"){
-                        this->Configs.PermanenceIncVal = std::stoul(Part2);
-                    }else if (Part1 == "MCS"){
-                        this->Columns.resize(std::stoul(Part2), NULL);
-                    }else
-                        throw std::logic_error("Invalid identifier <" + Part1 + "> on line: " + std::to_string(Line));
-                }else{
-                    SepLoc = Buff.find(':');
-                    if (SepLoc == std::string::npos)
-                        throw std::logic_error("Colon missing at first on line: " + std::to_string(Line));
-
-                    Part1 = Buff.substr(0,SepLoc);
-                    Part2 = Buff.substr(SepLoc+1);
-                    if (Part1.empty() || Part2.empty() || Part2.at(0) != '[' || Part2.at(Part2.size() - 1)!= ']')
-                        throw std::logic_error("Data missing on line: " + std::to_string(Line));
-                    ColID_t ColID = std::stoull(Part1);
-
-                    this->Columns[ColID - 1] = new clsColumn;
-
-                    clsCell::stuConnection Connection;
-                    char States;
-                    size_t NextInfoPos = Part2.find(']');
-                    size_t StartPos = 0;
-                    ZIndex_t ZIndex=0;
-                    std::string InnerPart1, InnerPart2;
-                    do{
-                        Part1 = Part2.substr(StartPos + 1, NextInfoPos - StartPos - 1);
-                        SepLoc = Part1.find(':');
-                        if (SepLoc == std::string::npos)
-                            throw std::logic_error("Colon missing on line: " +
-                                                   std::to_string(Line) +
-                                                   " for cell: " + std::to_string(ZIndex));
-                        InnerPart1 = Part1.substr(0,SepLoc);
-                        InnerPart2 = Part1.substr(SepLoc+1);
-                        if (InnerPart1.empty())
-                            throw std::logic_error("States missing on line: " +
-                                                   std::to_string(Line) +
-                                                   " for cell: " + std::to_string(ZIndex));
-
-                        States = std::stoul(InnerPart1);
-                        SepLoc = InnerPart2.find(':');
-                        if (SepLoc == std::string::npos)
-                            throw std::logic_error("Second Colon missing on line: " +
-                                                   std::to_string(Line) +
-                                                   " for cell: " + std::to_string(ZIndex));
-
-                        InnerPart1 = InnerPart2.substr(0,SepLoc);
-                        InnerPart2 = InnerPart2.substr(SepLoc+1);
-
-                        if (InnerPart1.empty())
-                            Connection.Destination.ColID=NOT_ASSIGNED;
-                        else
-                            Connection.Destination.ColID = std::stoull(InnerPart1);
-
-                        SepLoc = InnerPart2.find(':');
-                        if (SepLoc == std::string::npos)
-                            throw std::logic_error("Third Colon missing on line: " +
-                                                   std::to_string(Line) +
-                                                   " for cell: " + std::to_string(ZIndex));
-
-                        InnerPart1 = InnerPart2.substr(0,SepLoc);
-                        InnerPart2 = InnerPart2.substr(SepLoc+1);
-                        if (InnerPart1.empty())
-                            Connection.Destination.ZIndex = 0;
-                        else
-                            Connection.Destination.ZIndex = std::stoull(InnerPart1);
-                        if (InnerPart2.empty())
-                            throw std::logic_error("Permanence missing on line: " +
-                                                   std::to_string(Line) +
-                                                   " for cell: " + std::to_string(ZIndex));
-                        Connection.Permanence = std::stoul(InnerPart2);
-
-                        this->column(ColID)->push_back(new clsCell(ColID,ZIndex++, States, Connection));
-
-                        StartPos = NextInfoPos + 1;
-                        NextInfoPos = Part2.find(']',StartPos);
-                    }while(NextInfoPos != std::string::npos);
-                }
+        if (clsMappedSnapshot::isSnapshot(_filePath)){
+            std::unique_ptr<clsMappedSnapshot> Snapshot(new clsMappedSnapshot);
+            Snapshot->open(_filePath);
+            this->Configs.InitialConnectionPermanence = Snapshot->header().InitialConnectionPermanence;
+            this->Configs.MinPermanence2Connect = Snapshot->header().MinPermanence2Connect;
+            this->Configs.PermanenceIncVal = Snapshot->header().PermanenceIncVal;
+            this->Configs.PermanenceDecVal = Snapshot->header().PermanenceDecVal;
+            this->checkConfigs();
+            if (Snapshot->header().Flags & SNAPSHOT_FLAG_SPARSE_COLUMNS)
+                this->Configs.SparseColumns = true;
+            this->Columns.setSparse(this->Configs.SparseColumns);
+            //Journal can be replayed just on in-memory models
+            bool HasJournal = std::ifstream(clsJournal::path(_filePath).c_str()).good();
+            if (_mode == clsASM::LoadMapped && HasJournal == false)
+                this->Snapshot = Snapshot.release();
+            else{
+                this->loadSnapshot(*Snapshot);
+                if (HasJournal)
+                    this->replayJournal(_filePath, Snapshot->header());
             }
-        }
+        }else if (_mode == clsASM::LoadMapped)
+            throw std::logic_error(std::string("Just binary snapshots can be mapped: ") + _filePath);
+        else
+            this->loadText(_filePath);
     }catch(std::exception &e){
         if (_throw)
             throw;
@@ -351,140 +635,1470 @@ bool clsASMPrivate::load(const char *_filePath, bool _throw)
         }
     }
 
-    this->executeOnce(0, clsASM::LearningFrozen); // to reset anything.
+    this->executeStep(this->DefaultSession, 0, clsASM::LearningFrozen); // to reset anything.
     return true;
 }
 
 /*************************************************************************************************************/
-bool clsASMPrivate::save(const char *_filePath)
+void clsASMPrivate::loadText(const char *_filePath)
 {
-    std::ofstream File;
-    File.open(_filePath);
-    if (File.is_open()){
-        File<<"ICP:"<<this->Configs.InitialConnectionPermanence<<std::endl;
-        File<<"MPC:"<<this->Configs.MinPermanence2Connect<<std::endl;
-        File<<"PDV:"<<this->Configs.PermanenceDecVal<<std::endl;
-        File<<"PIV:"<<this->Configs.PermanenceIncVal<<std::endl;
-        File<<"MCS:"<<this->Columns.size()<<std::endl;
-        File<<FILE_SEGMENT_SEPARATOR<<std::endl;
-        int ColID = 0;
-        for(auto ColIter : this->Columns){
-            ColID++;
-            if (ColIter && ColIter->size()){
-                File<<ColID<<":";
-                for(auto CellIter : *ColIter){
-                    if (CellIter->hasConnection())
-                        File<<"["<<
-                              CellIter->states()<<":"<<
-                              CellIter->connection().Destination.ColID<<":"<<
-                              CellIter->connection().Destination.ZIndex<<":"<<
-                              CellIter->connection().Permanence<<"]";
-                    else
-                        File<<"["<<
-                              CellIter->states()<<":::"<<
-                              CellIter->connection().Permanence<<"]";
-                }
-                File<<std::endl;
+    clsTextModelParser Parser;
+    Parser.parse(_filePath);
+
+    if (Parser.hasConfig(clsTextModelParser::CONFIG_ICP))
+        this->Configs.InitialConnectionPermanence = Parser.config(clsTextModelParser::CONFIG_ICP);
+    if (Parser.hasConfig(clsTextModelParser::CONFIG_MPC))
+        this->Configs.MinPermanence2Connect = Parser.config(clsTextModelParser::CONFIG_MPC);
+    if (Parser.hasConfig(clsTextModelParser::CONFIG_PDV))
+        this->Configs.PermanenceDecVal = Parser.config(clsTextModelParser::CONFIG_PDV);
+    if (Parser.hasConfig(clsTextModelParser::CONFIG_PIV))
+        this->Configs.PermanenceIncVal = Parser.config(clsTextModelParser::CONFIG_PIV);
+    this->checkConfigs();
+    if (Parser.hasConfig(clsTextModelParser::CONFIG_SCD))
+        this->Configs.SparseColumns = Parser.config(clsTextModelParser::CONFIG_SCD) != 0;
+    this->Columns.setSparse(this->Configs.SparseColumns);
+    this->Columns.reserve(Parser.maxColumns());
+
+    for (auto ChunkIter = Parser.chunks().begin(); ChunkIter != Parser.chunks().end(); ChunkIter++){
+        auto CellIter = ChunkIter->Cells.begin();
+        for (size_t i = 0; i < ChunkIter->ColIDs.size(); ++i){
+            ColID_t ColID = ChunkIter->ColIDs[i];
+            if (this->column(ColID))
+                throw std::logic_error("Duplicate column: " + std::to_string(ColID));
+            clsColumn& Column = this->Columns.get(ColID);
+            Column.reserve(ChunkIter->CellCounts[i]);
+            for (uint32_t Cell = 0; Cell < ChunkIter->CellCounts[i]; ++Cell, ++CellIter)
+                this->addCell(Column, ColID, CellIter->States, INVALID_CELL_INDEX, CellIter->Permanence);
+        }
+    }
+
+    //Destinations may refer to columns stored after the cell so they are resolved when all cells are added
+    for (auto ChunkIter = Parser.chunks().begin(); ChunkIter != Parser.chunks().end(); ChunkIter++){
+        auto CellIter = ChunkIter->Cells.begin();
+        for (size_t i = 0; i < ChunkIter->ColIDs.size(); ++i){
+            const clsColumn* Column = this->column(ChunkIter->ColIDs[i]);
+            for (uint32_t Cell = 0; Cell < ChunkIter->CellCounts[i]; ++Cell, ++CellIter){
+                if (CellIter->DestColID == NOT_ASSIGNED)
+                    continue;
+                CellIndex_t Destination = this->cellAt(clsCell::stuLocation(CellIter->DestColID, CellIter->DestZIndex));
+                if (Destination == INVALID_CELL_INDEX)
+                    throw std::logic_error("Invalid destination: " +
+                                           std::to_string(CellIter->DestColID) + ":" +
+                                           std::to_string(CellIter->DestZIndex) +
+                                           " on column: " + std::to_string(ChunkIter->ColIDs[i]) +
+                                           " for cell: " + std::to_string(Cell));
+                this->cell(Column->at(Cell))->setDestination(Destination);
             }
         }
     }
+    this->buildSuccessorIndex();
 }
 
 /*************************************************************************************************************/
-void clsASMPrivate::feedback(ColID_t _colID, double _score)
+bool clsASMPrivate::save(const char *_filePath, clsASM::enuFileFormat _format)
 {
-    if (_score == 0){
-        this->award(_colID, this->Configs.PermanenceIncVal);
-        this->punish(_colID, this->Configs.PermanenceDecVal);
-    }else if (_score > 0){
-        this->award(_colID, this->Configs.PermanenceIncVal * (2 > _score ? _score : 2.0));
-    }else{
-        this->punish(_colID, this->Configs.PermanenceDecVal * -1 * (-2 > _score ? _score : -2.0));
+    std::lock_guard<std::mutex> CheckpointLock(this->CheckpointLock);
+    std::unique_lock<std::shared_mutex> ModelLock(this->ModelLock, std::defer_lock);
+    if (this->Configs.ConcurrentLearning)
+        ModelLock.lock();
+    //Other models may have mapped the old file (LoadMapped) so it is replaced instead of being truncated
+    std::string TempPath = std::string(_filePath) + ".tmp";
+    try{
+        this->ensureInMemory();
+        this->compactOnRequest();
+        if (_format == clsASM::FormatBinary)
+            this->saveBinary(TempPath.c_str());
+        else
+            this->saveText(TempPath.c_str());
+        //Journal of a checkpoint base which is being overwritten does not belong to it anymore
+        clsJournal::remove(clsJournal::path(_filePath));
+        if (std::rename(TempPath.c_str(), _filePath) != 0)
+            throw std::logic_error(std::string("Unable to replace file: ") + _filePath);
+    }catch(std::exception &e){
+        std::remove(TempPath.c_str());
+        std::cerr<<e.what()<<std::endl;
+        return false;
     }
+    return true;
 }
 
 /*************************************************************************************************************/
-void clsASMPrivate::award(ColID_t _colID, Permanence_t _pVal)
+void clsASMPrivate::saveText(const char *_filePath)
 {
-    //Find cell in prediction list which belongs to the awarded column and reinforce it's connection
-    for(auto CellIter = this->PredictedCells.begin();
-        CellIter != this->PredictedCells.end();
-        CellIter ++)
-        if (CellIter->ColID == _colID){
-            this->cell(*CellIter)->connection().Permanence = (
-                        SHRT_MAX - this->cell(*CellIter)->connection().Permanence < _pVal ?
-                            SHRT_MAX :
-                            this->cell(*CellIter)->connection().Permanence + _pVal);
-            break;
+    std::ofstream File;
+    File.open(_filePath);
+    if (File.is_open() == false)
+        throw std::logic_error(std::string("Unable to open file: ") + _filePath);
+    File<<"ICP:"<<this->Configs.InitialConnectionPermanence<<std::endl;
+    File<<"MPC:"<<this->Configs.MinPermanence2Connect<<std::endl;
+    File<<"PDV:"<<this->Configs.PermanenceDecVal<<std::endl;
+    File<<"PIV:"<<this->Configs.PermanenceIncVal<<std::endl;
+    if (this->Columns.isSparse())
+        File<<"SCD:1"<<std::endl;
+    File<<"MCS:"<<this->Columns.maxColID()<<std::endl;
+    File<<FILE_SEGMENT_SEPARATOR<<std::endl;
+    this->Columns.forEach([this, &File](ColID_t _colID, const clsColumn& _column){
+        File<<_colID<<":";
+        for(CellIndex_t CellIndex : _column){
+            clsCell* CellIter = this->cell(CellIndex);
+            if (CellIter->hasConnection()){
+                clsCell::stuLocation Destination = this->location(CellIter->destination());
+                File<<"["<<
+                      CellIter->persistentStates()<<":"<<
+                      Destination.ColID<<":"<<
+                      Destination.ZIndex<<":"<<
+                      CellIter->permanence()<<"]";
+            }else
+                File<<"["<<
+                      CellIter->persistentStates()<<":::"<<
+                      CellIter->permanence()<<"]";
         }
+        File<<"\n";
+    });
+    if (File.fail())
+        throw std::logic_error(std::string("Unable to write file: ") + _filePath);
 }
 
 /*************************************************************************************************************/
-void clsASMPrivate::punish(ColID_t _colID, Permanence_t _pVal)
+stuSnapshotHeader clsASMPrivate::saveBinary(const char *_filePath)
 {
-    for(auto CellIter = this->PredictedCells.begin();
-        CellIter != this->PredictedCells.end();
-        CellIter ++)
-    {
-        //weaken incorrect prediction on all predicted cells except the cell on specified column
-        if (CellIter->ColID != _colID)
-            this->cell(*CellIter)->connection().Permanence = (
-                    this->cell(*CellIter)->connection().Permanence < _pVal ?
-                        0 :
-                        this->cell(*CellIter)->connection().Permanence - _pVal
-                        );
-        if (this->cell(*CellIter)->connection().Permanence == 0)
-            this->removeCell(*CellIter);
-    }
-}
-
-/*************************************************************************************************************/
-void clsASMPrivate::setPredictionState(clsCell* _activeCell)
-{
-    for (auto ColIter = this->Columns.begin();
-         ColIter != this->Columns.end();
-         ColIter++)
-        if (*ColIter)
-            for(auto CellIter = (*ColIter)->begin();
-                CellIter != (*ColIter)->end();
-                CellIter++)
-                if (*CellIter && this->cell((*CellIter)->loc())->connection().Destination == _activeCell->loc() &&
-                        this->cell((*CellIter)->loc())->connection().Permanence >= this->Configs.MinPermanence2Connect)
-                {
-                    this->cell((*CellIter)->loc())->setWasPredictingState(true);
-                    this->PredictedCells.push_back((*CellIter)->loc());
-                    this->PredictedCols.push_back(clsASM::stuPrediction(
-                                                   (*CellIter)->loc().ColID,
-                                                   (this->SumPathPermanence +
-                                                    this->cell((*CellIter)->loc())->connection().Permanence) /
-                                                      this->PathItems));
-                }
+    std::ofstream File(_filePath, std::ios::binary | std::ios::trunc);
+    if (File.is_open() == false)
+        throw std::logic_error(std::string("Unable to open file: ") + _filePath);
+
+    stuSnapshotHeader Header = this->writeSnapshot(File, false);
+    File.flush();
+    if (File.fail() || (uint64_t)File.tellp() != Header.FileSize)
+        throw std::logic_error(std::string("Unable to write snapshot: ") + _filePath);
+    return Header;
 }
 
 /*************************************************************************************************************/
-void clsASMPrivate::removeOldPredictions()
+template <typename Stream_t>
+stuSnapshotHeader clsASMPrivate::writeSnapshot(Stream_t& _stream, bool _connectedOnly)
 {
-    for(auto CellIter = this->PredictedCells.begin();
-        CellIter != this->PredictedCells.end();
-        CellIter ++)
-        this->cell(*CellIter)->setWasPredictingState(false);
-    this->PredictedCells.clear();
+    //Cells are stored ordered by column and ZIndex. Dense snapshots keep first cell of all columns up to the
+    //greatest ColID while sparse snapshots keep sorted ColIDs of live columns along with their first cell
+    bool Sparse = this->Columns.isSparse();
+    std::vector<ColID_t>     ColumnIDs;
+    std::vector<CellIndex_t> ColumnFirstCell(1, 0);
+    std::vector<CellIndex_t> SnapshotIndex(this->Pool.size(), INVALID_CELL_INDEX);
+    CellIndex_t NextIndex = 0;
+    this->Columns.forEach([&](ColID_t _colID, const clsColumn& _column){
+        if (Sparse)
+            ColumnIDs.push_back(_colID);
+        else
+            ColumnFirstCell.resize(_colID, ColumnFirstCell.back());
+        for(CellIndex_t CellIndex : _column)
+            SnapshotIndex[CellIndex] = NextIndex++;
+        ColumnFirstCell.push_back(NextIndex);
+    });
+
+    //Frozen images drop connections which are too weak to be predicted
+    Permanence_t MinPermanence = _connectedOnly ? this->Configs.MinPermanence2Connect : 0;
+    uint64_t SuccessorCount = 0;
+    for (CellIndex_t CellIndex = 0; CellIndex < this->Pool.size(); ++CellIndex)
+        if (this->cell(CellIndex)->hasConnection() && this->cell(CellIndex)->permanence() >= MinPermanence)
+            SuccessorCount++;
+
+    stuSnapshotHeader Header;
+    memset(&Header, 0, sizeof(Header));
+    memcpy(Header.Magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    Header.Version = SNAPSHOT_VERSION;
+    Header.EndianMark = SNAPSHOT_ENDIAN_MARK;
+    Header.HeaderSize = sizeof(stuSnapshotHeader);
+    Header.InitialConnectionPermanence = this->Configs.InitialConnectionPermanence;
+    Header.MinPermanence2Connect = this->Configs.MinPermanence2Connect;
+    Header.PermanenceIncVal = this->Configs.PermanenceIncVal;
+    Header.PermanenceDecVal = this->Configs.PermanenceDecVal;
+    Header.Flags = (Sparse ? SNAPSHOT_FLAG_SPARSE_COLUMNS : 0) |
+                   (_connectedOnly ? SNAPSHOT_FLAG_CONNECTED_SUCCESSORS : 0);
+    Header.ColumnCount = ColumnFirstCell.size() - 1;
+    Header.CellCount = NextIndex;
+    Header.SuccessorCount = SuccessorCount;
+    Header.ColumnIDsOffset = clsMappedSnapshot::align8(sizeof(stuSnapshotHeader));
+    Header.ColumnsOffset = clsMappedSnapshot::align8(
+                Header.ColumnIDsOffset + ColumnIDs.size() * sizeof(ColID_t));
+    Header.CellsOffset = clsMappedSnapshot::align8(
+                Header.ColumnsOffset + ColumnFirstCell.size() * sizeof(CellIndex_t));
+    Header.SuccessorFirstOffset = clsMappedSnapshot::align8(
+                Header.CellsOffset + Header.CellCount * sizeof(stuSnapshotCell));
+    Header.SuccessorsOffset = clsMappedSnapshot::align8(
+                Header.SuccessorFirstOffset + (Header.CellCount + 1) * sizeof(CellIndex_t));
+    Header.FileSize = Header.SuccessorsOffset + Header.SuccessorCount * sizeof(CellIndex_t);
+
+    auto padTo = [&_stream](uint64_t _offset){
+        static const char Zeros[8] = {0};
+        _stream.write(Zeros, _offset - (uint64_t)_stream.tellp());
+    };
+
+    _stream.write((const char*)&Header, sizeof(Header));
+    padTo(Header.ColumnIDsOffset);
+    _stream.write((const char*)ColumnIDs.data(), ColumnIDs.size() * sizeof(ColID_t));
+    padTo(Header.ColumnsOffset);
+    _stream.write((const char*)ColumnFirstCell.data(), ColumnFirstCell.size() * sizeof(CellIndex_t));
+
+    padTo(Header.CellsOffset);
+    this->Columns.forEach([&](ColID_t, const clsColumn& _column){
+        for(CellIndex_t CellIndex : _column){
+            stuSnapshotCell SnapshotCell = this->snapshotCell(CellIndex);
+            if (SnapshotCell.Destination != INVALID_CELL_INDEX)
+                SnapshotCell.Destination = SnapshotIndex[SnapshotCell.Destination];
+            _stream.write((const char*)&SnapshotCell, sizeof(SnapshotCell));
+        }
+    });
+
+    padTo(Header.SuccessorFirstOffset);
+    CellIndex_t SuccessorFirst = 0;
+    this->Columns.forEach([&](ColID_t, const clsColumn& _column){
+        for(CellIndex_t CellIndex : _column){
+            _stream.write((const char*)&SuccessorFirst, sizeof(SuccessorFirst));
+            for(CellIndex_t SuccessorIndex = this->cell(CellIndex)->firstSuccessor();
+                SuccessorIndex != INVALID_CELL_INDEX;
+                SuccessorIndex = this->cell(SuccessorIndex)->nextSibling())
+                if (this->cell(SuccessorIndex)->permanence() >= MinPermanence)
+                    SuccessorFirst++;
+        }
+    });
+    _stream.write((const char*)&SuccessorFirst, sizeof(SuccessorFirst));
+
+    padTo(Header.SuccessorsOffset);
+    this->Columns.forEach([&](ColID_t, const clsColumn& _column){
+        for(CellIndex_t CellIndex : _column)
+            for(CellIndex_t SuccessorIndex = this->cell(CellIndex)->firstSuccessor();
+                SuccessorIndex != INVALID_CELL_INDEX;
+                SuccessorIndex = this->cell(SuccessorIndex)->nextSibling())
+                if (this->cell(SuccessorIndex)->permanence() >= MinPermanence)
+                    _stream.write((const char*)&SnapshotIndex[SuccessorIndex], sizeof(CellIndex_t));
+    });
+    return Header;
+}
+
+/*************************************************************************************************************/
+clsFrozenASMPrivate* clsASMPrivate::freeze()
+{
+    std::lock_guard<std::mutex> CheckpointLock(this->CheckpointLock);
+    std::unique_lock<std::shared_mutex> ModelLock(this->ModelLock, std::defer_lock);
+    if (this->Configs.ConcurrentLearning)
+        ModelLock.lock();
+    this->ensureInMemory();
+    this->compactOnRequest();
+
+    clsSnapshotImage Image;
+    this->writeSnapshot(Image, true);
+    std::unique_ptr<clsFrozenASMPrivate> Frozen(new clsFrozenASMPrivate(this->Configs.MaxPredictions));
+    Frozen->open(std::move(Image.Data));
+    return Frozen.release();
+}
+
+/*************************************************************************************************************/
+std::future<bool> clsASMPrivate::saveAsync(const char *_filePath,
+                                           clsASM::enuFileFormat _format,
+                                           std::function<void(bool)> _onDone)
+{
+    std::promise<bool> Promise;
+    std::future<bool> Result = Promise.get_future();
+    std::unique_ptr<clsASMPrivate> Copy;
+    try{
+        std::unique_lock<std::shared_mutex> ModelLock(this->ModelLock, std::defer_lock);
+        if (this->Configs.ConcurrentLearning)
+            ModelLock.lock();
+        this->ensureInMemory();
+        Copy = this->copyInLock();
+    }catch(std::exception &e){
+        std::cerr<<e.what()<<std::endl;
+        if (_onDone)
+            _onDone(false);
+        Promise.set_value(false);
+        return Result;
+    }
+
+    //Copy is owned by the writer thread so the thread is independent of the model's lifetime
+    std::thread([Copy = std::move(Copy), Promise = std::move(Promise), FilePath = std::string(_filePath),
+                _format, _onDone]() mutable {
+        bool Saved = Copy->save(FilePath.c_str(), _format);
+        Copy.reset();
+        if (_onDone)
+            _onDone(Saved);
+        Promise.set_value(Saved);
+    }).detach();
+    return Result;
+}
+
+/*************************************************************************************************************/
+std::unique_ptr<clsASMPrivate> clsASMPrivate::copyInLock()
+{
+    clsASM::Configs Configs = this->Configs;
+    Configs.ConcurrentLearning = false;
+    std::unique_ptr<clsASMPrivate> Copy(new clsASMPrivate(Configs));
+    Copy->Columns = this->Columns;
+    Copy->Columns.setDirtyTracking(false);
+    Copy->Pool.copyFrom(this->Pool);
+    //Removed cells must be known so they will be compacted before being saved
+    Copy->RemovedCells = this->RemovedCells.load();
+    return Copy;
+}
+
+/*************************************************************************************************************/
+stuSnapshotCell clsASMPrivate::snapshotCell(CellIndex_t _index)
+{
+    clsCell* Cell = this->cell(_index);
+    stuSnapshotCell SnapshotCell;
+    memset(&SnapshotCell, 0, sizeof(SnapshotCell));
+    SnapshotCell.ColID = Cell->colID();
+    SnapshotCell.Destination = Cell->destination();
+    SnapshotCell.Permanence = Cell->permanence();
+    SnapshotCell.States = Cell->persistentStates();
+    return SnapshotCell;
+}
+
+/*************************************************************************************************************/
+stuJournalCell clsASMPrivate::journalCell(CellIndex_t _index)
+{
+    clsCell* Cell = this->cell(_index);
+    stuJournalCell JournalCell{};
+    JournalCell.Loc = this->location(_index);
+    JournalCell.Destination = Cell->hasConnection() ?
+                                  this->location(Cell->destination()) :
+                                  clsCell::stuLocation(NOT_ASSIGNED, 0);
+    JournalCell.Permanence = Cell->permanence();
+    JournalCell.States = Cell->persistentStates();
+    JournalCell.Flags = Cell->isRemoved() ? JOURNAL_CELL_REMOVED : 0;
+    return JournalCell;
+}
+
+/*************************************************************************************************************/
+bool clsASMPrivate::checkpoint(const char *_basePath, bool _fold)
+{
+    std::lock_guard<std::mutex> CheckpointLock(this->CheckpointLock);
+    std::unique_lock<std::shared_mutex> ModelLock(this->ModelLock, std::defer_lock);
+    if (this->Configs.ConcurrentLearning)
+        ModelLock.lock();
+    try{
+        //Replaying a journal larger than it's base costs more than loading a fresh base. Changes are not tracked
+        //after a maintenance sweep has decayed the connections.
+        if (_fold ||
+                this->Columns.isTrackingDirty() == false ||
+                this->Checkpoint.BasePath != _basePath ||
+                this->Checkpoint.Generation != this->Generation ||
+                this->Checkpoint.CompactionEpoch != this->CompactionEpoch ||
+                this->Checkpoint.JournalSize > this->Checkpoint.BaseSize){
+            this->writeCheckpointBase(_basePath);
+            return true;
+        }
+
+        //Changed columns are copied under the lock and written after it has been released
+        clsJournalRecord Record;
+        this->Columns.takeDirty([this, &Record](ColID_t _colID, const clsColumn& _column){
+            Record.addColumn(_colID);
+            for (CellIndex_t CellIndex : _column)
+                if (this->cell(CellIndex)->takeDirty())
+                    Record.addCell(this->journalCell(CellIndex));
+        });
+        if (ModelLock.owns_lock())
+            ModelLock.unlock();
+        if (Record.empty() == false)
+            this->Checkpoint.JournalSize = clsJournal::append(clsJournal::path(_basePath),
+                                                              this->Checkpoint.JournalSize,
+                                                              Record);
+    }catch(std::exception &e){
+        //Changes which have not been journaled are not tracked anymore so next checkpoint must write a base
+        this->Checkpoint.BasePath.clear();
+        std::cerr<<e.what()<<std::endl;
+        return false;
+    }
+    return true;
 }
 
 /*************************************************************************************************************/
-void clsASMPrivate::removeCell(clsCell::stuLocation &_loc)
+void clsASMPrivate::writeCheckpointBase(const char *_basePath)
 {
-    ///@TODO implement me
-    /*    for (auto ColIter = this->Columns.begin();
-         ColIter != this->Columns.end();
-         ColIter++)
-        if (*ColIter)
-            for(auto CellIter = (*ColIter)->begin();
-                CellIter != (*ColIter)->end();
-                CellIter++)
-                if (*CellIter && this->cell((*CellIter)->loc())->connection().Destination == _loc)
-                    this->removeCell(_loc);
+    this->Checkpoint.BasePath.clear();
+    this->ensureInMemory();
+    this->compactOnRequest();
+
+    //Journal of the old base is removed before the base is replaced so a crash in between leaves the old base
+    std::string TempPath = std::string(_basePath) + ".tmp";
+    std::string JournalPath = clsJournal::path(_basePath);
+    stuSnapshotHeader Header = this->saveBinary(TempPath.c_str());
+    clsJournal::remove(JournalPath);
+    if (std::rename(TempPath.c_str(), _basePath) != 0)
+        throw std::logic_error(std::string("Unable to replace base snapshot: ") + _basePath);
+
+    this->Checkpoint.JournalSize = clsJournal::create(JournalPath, Header);
+    this->Checkpoint.BaseSize = Header.FileSize;
+    this->Checkpoint.Generation = this->Generation;
+    this->Checkpoint.CompactionEpoch = this->CompactionEpoch;
+    this->Checkpoint.BasePath = _basePath;
+    for (CellIndex_t CellIndex = 0; CellIndex < this->Pool.size(); ++CellIndex)
+        this->cell(CellIndex)->takeDirty();
+    this->Columns.setDirtyTracking(true);
+}
 
-    delete this->column(_loc.ColID)->at(_loc.ZIndex);*/
+/*************************************************************************************************************/
+void clsASMPrivate::replayJournal(const char *_basePath, const stuSnapshotHeader &_base)
+{
+    //Destination of new cells is kept by location as it may be journaled later
+    std::vector<std::pair<CellIndex_t, clsCell::stuLocation>> NewCells;
+    uint64_t JournalSize = clsJournal::replay(
+                clsJournal::path(_basePath),
+                _base,
+                [this, &NewCells](ColID_t _colID, const stuJournalCell* _cells, uint32_t _cellCount){
+        if (_colID == 0 || _colID == NOT_ASSIGNED)
+            throw std::logic_error("Invalid journaled column: " + std::to_string(_colID));
+        clsColumn& Column = this->Columns.get(_colID);
+        for (uint32_t i = 0; i < _cellCount; ++i){
+            const stuJournalCell& JournalCell = _cells[i];
+            if (JournalCell.Loc.ColID != _colID || JournalCell.Loc.ZIndex > Column.size())
+                throw std::logic_error("Invalid location for journaled cell on column: " + std::to_string(_colID));
+            CellIndex_t CellIndex;
+            if (JournalCell.Loc.ZIndex < Column.size()){
+                if (fitsCell(_colID, JournalCell.Permanence) == false)
+                    throw std::logic_error("Journaled permanence does not fit on this build on column: " +
+                                           std::to_string(_colID));
+                CellIndex = Column[JournalCell.Loc.ZIndex];
+                this->cell(CellIndex)->setPermanence(JournalCell.Permanence);
+            }else{
+                CellIndex = this->addCell(Column, _colID, JournalCell.States, INVALID_CELL_INDEX, JournalCell.Permanence);
+                NewCells.push_back(std::make_pair(CellIndex, JournalCell.Destination));
+            }
+            if (JournalCell.Flags & JOURNAL_CELL_REMOVED)
+                this->removeCell(CellIndex);
+        }
+    });
+
+    //Successors are linked after all records have been replayed as destination may be journaled later
+    for (auto& NewCell : NewCells){
+        const clsCell::stuLocation& Dest = NewCell.second;
+        if (Dest.ColID == NOT_ASSIGNED)
+            continue;
+        CellIndex_t Destination = this->cellAt(Dest);
+        if (Destination == INVALID_CELL_INDEX)
+            throw std::logic_error("Invalid connection destination " +
+                                   std::to_string(Dest.ColID) + ":" + std::to_string(Dest.ZIndex) +
+                                   " on journaled column: " + std::to_string(this->cell(NewCell.first)->colID()));
+        this->cell(NewCell.first)->setDestination(Destination);
+        this->appendSuccessor(Destination, NewCell.first);
+    }
+
+    this->Checkpoint.JournalSize = JournalSize;
+    this->Checkpoint.BaseSize = _base.FileSize;
+    this->Checkpoint.Generation = this->Generation;
+    this->Checkpoint.CompactionEpoch = this->CompactionEpoch;
+    this->Checkpoint.BasePath = _basePath;
+    this->Columns.setDirtyTracking(true);
+}
+
+/*************************************************************************************************************/
+bool clsASMPrivate::startWAL(const char *_snapshotPath,
+                             const char *_walPath,
+                             clsASM::enuFileFormat _format,
+                             uint32_t _groupCommitSize,
+                             bool _syncOnCommit)
+{
+    std::lock_guard<std::mutex> CheckpointLock(this->CheckpointLock);
+    std::unique_lock<std::shared_mutex> ModelLock(this->ModelLock, std::defer_lock);
+    std::unique_lock<std::mutex> WALLock(this->WALLock, std::defer_lock);
+    if (this->Configs.ConcurrentLearning){
+        ModelLock.lock();
+        WALLock.lock();
+    }
+    try{
+        this->WAL.close();
+        this->ensureInMemory();
+        this->compactInLock();
+
+        //Snapshot is replaced atomically so a crash while writing it leaves the previous snapshot and it's WAL
+        std::string TempPath = std::string(_snapshotPath) + ".tmp";
+        if (_format == clsASM::FormatBinary)
+            this->saveBinary(TempPath.c_str());
+        else
+            this->saveText(TempPath.c_str());
+        if (_syncOnCommit)
+            clsWAL::syncFile(TempPath);
+        uint64_t Fingerprint = clsWAL::fingerprint(TempPath);
+        clsJournal::remove(clsJournal::path(_snapshotPath));
+        if (this->Checkpoint.BasePath == _snapshotPath)
+            this->Checkpoint.BasePath.clear();
+        if (std::rename(TempPath.c_str(), _snapshotPath) != 0)
+            throw std::logic_error(std::string("Unable to replace snapshot: ") + _snapshotPath);
+
+        this->WAL.open(_walPath,
+                       Fingerprint,
+                       this->Configs.MaintenanceInterval,
+                       this->Configs.MaintenanceDecay,
+                       _groupCommitSize,
+                       _syncOnCommit);
+        this->MaintenanceSteps = 0;
+    }catch(std::exception &e){
+        std::cerr<<e.what()<<std::endl;
+        return false;
+    }
+    return true;
+}
+
+/*************************************************************************************************************/
+bool clsASMPrivate::commitWAL()
+{
+    std::unique_lock<std::mutex> WALLock(this->WALLock, std::defer_lock);
+    if (this->Configs.ConcurrentLearning)
+        WALLock.lock();
+    try{
+        this->WAL.commit();
+    }catch(std::exception &e){
+        std::cerr<<e.what()<<std::endl;
+        return false;
+    }
+    return true;
+}
+
+/*************************************************************************************************************/
+bool clsASMPrivate::stopWAL()
+{
+    std::unique_lock<std::mutex> WALLock(this->WALLock, std::defer_lock);
+    if (this->Configs.ConcurrentLearning)
+        WALLock.lock();
+    try{
+        this->WAL.close();
+    }catch(std::exception &e){
+        std::cerr<<e.what()<<std::endl;
+        return false;
+    }
+    return true;
+}
+
+/*************************************************************************************************************/
+bool clsASMPrivate::recover(const char *_snapshotPath, const char *_walPath, bool _throw)
+{
+    try{
+        this->load(_snapshotPath, true);
+
+        //Sessions other than the default one are kept just while replaying
+        std::vector<std::unique_ptr<clsSessionPrivate>> ReplaySessions;
+        std::vector<clsSessionPrivate*> Sessions;
+        clsWAL::replay(_walPath,
+                       clsWAL::fingerprint(_snapshotPath),
+                       this->Configs.MaintenanceInterval,
+                       this->Configs.MaintenanceDecay,
+                       [this, &ReplaySessions, &Sessions](const stuWALRecord& _record, const char* _body){
+            if (_record.Type == WAL_RECORD_Compaction)
+                return this->compact();
+            if (_record.Type == WAL_RECORD_Maintenance){
+                this->maintain(_record.Count);
+                return;
+            }
+
+            if (_record.Type == WAL_RECORD_Session){
+                if (_record.SessionID != Sessions.size())
+                    throw std::logic_error("Invalid WAL session: " + std::to_string(_record.SessionID));
+                if (_record.Flags & WAL_SESSION_DEFAULT)
+                    Sessions.push_back(&this->DefaultSession);
+                else{
+                    ReplaySessions.emplace_back(new clsSessionPrivate);
+                    Sessions.push_back(ReplaySessions.back().get());
+                }
+                stuWALSession State;
+                memcpy(&State, _body, sizeof(State));
+                return this->restoreSession(*Sessions.back(),
+                                            State,
+                                            (const stuWALLocation*)(_body + sizeof(State)),
+                                            _record.Count);
+            }
+
+            if (_record.SessionID >= Sessions.size())
+                throw std::logic_error("WAL record of an unknown session: " + std::to_string(_record.SessionID));
+            clsSessionPrivate& Session = *Sessions[_record.SessionID];
+            if (_record.Type == WAL_RECORD_Steps){
+                if (_record.Flags > clsASM::LearningFull)
+                    throw std::logic_error("Invalid learning level on WAL: " + std::to_string(_record.Flags));
+                this->executeBulk(Session,
+                                  (const ColID_t*)_body,
+                                  _record.Count,
+                                  (clsASM::enuLearningLevel)_record.Flags);
+            }else{
+                stuWALFeedback Feedback;
+                memcpy(&Feedback, _body, sizeof(Feedback));
+                this->feedback(Session, Feedback.ColID, Feedback.Score);
+            }
+        });
+    }catch(std::exception &e){
+        if (_throw)
+            throw;
+        std::cerr<<e.what()<<std::endl;
+        return false;
+    }
+    return true;
+}
+
+/*************************************************************************************************************/
+template <typename Fn_t>
+void clsASMPrivate::logToWAL(clsSessionPrivate &_session, Fn_t _fn)
+{
+    //WAL is started just while model is locked exclusively so it's epoch will not change meanwhile
+    std::shared_lock<std::shared_mutex> ModelLock(this->ModelLock, std::defer_lock);
+    if (this->Configs.ConcurrentLearning)
+        ModelLock.lock();
+
+    //Position of the session is logged before it's first record so replay continues the same sequence
+    bool NewSession = _session.WALEpoch != this->WAL.epoch();
+    stuWALSession State;
+    std::vector<stuWALLocation> Predicted;
+    if (NewSession){
+        this->syncSession(_session);
+        memset(&State, 0, sizeof(State));
+        State.SumPathPermanence = _session.SumPathPermanence;
+        State.PathItems = _session.PathItems;
+        State.LastActiveColumn = _session.LastActiveColumn;
+        State.LastLearningCell.ColID = NOT_ASSIGNED;
+        if (_session.LastLearningCell != INVALID_CELL_INDEX){
+            clsCell::stuLocation Loc = this->lockedLocation(_session.LastLearningCell);
+            State.LastLearningCell.ColID = Loc.ColID;
+            State.LastLearningCell.ZIndex = Loc.ZIndex;
+        }
+        State.FirstPattern = _session.FirstPattern;
+        for (auto CellIter = _session.PredictedCells.begin(); CellIter != _session.PredictedCells.end(); CellIter++){
+            clsCell::stuLocation Loc = this->lockedLocation(CellIter->Index);
+            Predicted.push_back(stuWALLocation{Loc.ColID, Loc.ZIndex});
+        }
+    }
+
+    std::unique_lock<std::mutex> WALLock(this->WALLock, std::defer_lock);
+    if (this->Configs.ConcurrentLearning)
+        WALLock.lock();
+    if (this->WAL.isOpen() == false)
+        return;
+    if (NewSession){
+        _session.WALSessionID = this->WAL.appendSession(&_session == &this->DefaultSession, State, Predicted);
+        _session.WALEpoch = this->WAL.epoch();
+    }
+    _fn(_session.WALSessionID);
+}
+
+/*************************************************************************************************************/
+void clsASMPrivate::logSteps(clsSessionPrivate &_session,
+                             const ColID_t *_inputs,
+                             size_t _count,
+                             clsASM::enuLearningLevel _learningLevel)
+{
+    this->logToWAL(_session, [this, _inputs, _count, _learningLevel](uint32_t _sessionID){
+        this->WAL.appendSteps(_sessionID, _learningLevel, _inputs, _count);
+    });
+}
+
+/*************************************************************************************************************/
+void clsASMPrivate::logFeedback(clsSessionPrivate &_session, ColID_t _colID, double _score)
+{
+    this->logToWAL(_session, [this, _colID, _score](uint32_t _sessionID){
+        this->WAL.appendFeedback(_sessionID, _colID, _score);
+    });
+}
+
+/*************************************************************************************************************/
+void clsASMPrivate::restoreSession(clsSessionPrivate &_session,
+                                   const stuWALSession &_state,
+                                   const stuWALLocation *_predicted,
+                                   uint32_t _predictedCount)
+{
+    _session.restart();
+    _session.Generation = this->Generation;
+    _session.CompactionEpoch = this->CompactionEpoch;
+    _session.SumPathPermanence = _state.SumPathPermanence;
+    _session.PathItems = _state.PathItems;
+    _session.LastActiveColumn = _state.LastActiveColumn;
+    _session.FirstPattern = _state.FirstPattern != 0;
+    if (_state.LastLearningCell.ColID != NOT_ASSIGNED)
+        _session.LastLearningCell = this->walCell(_state.LastLearningCell);
+    for (uint32_t i = 0; i < _predictedCount; ++i){
+        stuWALLocation Loc;
+        memcpy(&Loc, _predicted + i, sizeof(Loc));
+        CellIndex_t CellIndex = this->walCell(Loc);
+        _session.PredictedCells.push_back(clsSessionPrivate::stuPredictedCell(Loc.ColID, CellIndex));
+    }
+}
+
+/*************************************************************************************************************/
+CellIndex_t clsASMPrivate::walCell(const stuWALLocation &_loc)
+{
+    CellIndex_t CellIndex = this->cellAt(clsCell::stuLocation(_loc.ColID, _loc.ZIndex));
+    if (CellIndex == INVALID_CELL_INDEX)
+        throw std::logic_error("Invalid cell location on WAL: " +
+                               std::to_string(_loc.ColID) + ":" + std::to_string(_loc.ZIndex));
+    return CellIndex;
+}
+
+/*************************************************************************************************************/
+void clsASMPrivate::loadSnapshot(const clsMappedSnapshot &_snapshot)
+{
+    const stuSnapshotHeader& Header = _snapshot.header();
+    this->Columns.reserve(Header.ColumnCount);
+    for (uint32_t Slot = 0; Slot < _snapshot.columnCount(); ++Slot){
+        ColID_t ColID = _snapshot.slotColID(Slot);
+        if (_snapshot.slotFirstCell(Slot) == _snapshot.slotFirstCell(Slot + 1))
+            continue;
+        clsColumn& Column = this->Columns.get(ColID);
+        for (CellIndex_t CellIndex = _snapshot.slotFirstCell(Slot);
+             CellIndex < _snapshot.slotFirstCell(Slot + 1);
+             ++CellIndex){
+            const stuSnapshotCell& SnapshotCell = _snapshot.cell(CellIndex);
+            if (SnapshotCell.ColID != ColID || CellIndex != this->Pool.size())
+                throw std::logic_error("Invalid location for snapshot cell: " + std::to_string(CellIndex));
+            if (SnapshotCell.Destination != INVALID_CELL_INDEX && SnapshotCell.Destination >= Header.CellCount)
+                throw std::logic_error("Invalid destination for snapshot cell: " + std::to_string(CellIndex));
+            this->addCell(Column, ColID, SnapshotCell.States, SnapshotCell.Destination, SnapshotCell.Permanence);
+        }
+    }
+    if (this->Pool.size() != Header.CellCount)
+        throw std::logic_error("Invalid snapshot cell count");
+
+    //Frozen images lack weak successors. They are restored from destinations (which are complete) after the
+    //stored successors so the ones which can be predicted keep their order
+    if (Header.Flags & SNAPSHOT_FLAG_CONNECTED_SUCCESSORS)
+        for (CellIndex_t CellIndex = Header.CellCount; CellIndex-- > 0; ){
+            const stuSnapshotCell& SnapshotCell = _snapshot.cell(CellIndex);
+            if (SnapshotCell.Destination != INVALID_CELL_INDEX &&
+                    SnapshotCell.Permanence < Header.MinPermanence2Connect)
+                this->cell(SnapshotCell.Destination)->prependSuccessor(*this->cell(CellIndex), CellIndex);
+        }
+
+    //Pool index of each cell is the same as it's snapshot index. Successors are prepended so iterate
+    //backward in order to keep them in the same order as snapshot
+    for (CellIndex_t CellIndex = 0; CellIndex < Header.CellCount; ++CellIndex)
+        for (const CellIndex_t* SuccessorIter = _snapshot.successorsEnd(CellIndex);
+             SuccessorIter-- != _snapshot.successorsBegin(CellIndex); ){
+            if (*SuccessorIter >= Header.CellCount)
+                throw std::logic_error("Invalid successor for snapshot cell: " + std::to_string(CellIndex));
+            this->cell(CellIndex)->prependSuccessor(*this->cell(*SuccessorIter), *SuccessorIter);
+        }
+}
+
+/*************************************************************************************************************/
+void clsASMPrivate::ensureInMemory()
+{
+    if (this->Snapshot == NULL)
+        return;
+
+    //Cells get the same locations as the snapshot so sessions remain valid
+    std::unique_ptr<clsMappedSnapshot> Snapshot(this->Snapshot);
+    this->Snapshot = NULL;
+    this->loadSnapshot(*Snapshot);
+}
+
+/*************************************************************************************************************/
+CellIndex_t clsASMPrivate::executeOnceMapped(clsSessionPrivate& _session, ColID_t _activeColIndex)
+{
+    CellIndex_t FirstCell, EndCell;
+    if (this->Snapshot->columnRange(_activeColIndex, FirstCell, EndCell) == false)
+        return 0;
+
+    CellIndex_t Scanned = 0;
+    if (_session.FirstPattern)
+    {
+        Scanned = EndCell - FirstCell;
+        for (CellIndex_t CellIndex = FirstCell; CellIndex < EndCell; ++CellIndex)
+            Scanned += this->setPredictionStateMapped(_session, CellIndex);
+
+        _session.LastLearningCell = FirstCell;
+        _session.FirstPattern = false;
+        _session.LastActiveColumn = _activeColIndex;
+        return Scanned;
+    }
+
+    const clsSessionPrivate::stuPredictedCell* Predicted = _session.predictedCell(_activeColIndex);
+    if (Predicted == NULL)
+        _session.PredictedCells.clear();
+    else
+    {
+        CellIndex_t PredictiveCellIndex = Predicted->Index;
+        _session.LastLearningCell = PredictiveCellIndex;
+        _session.SumPathPermanence += this->Snapshot->cell(PredictiveCellIndex).Permanence;
+        Scanned = _session.PredictedCells.size();
+        _session.PredictedCells.clear();
+        Scanned += this->setPredictionStateMapped(_session, PredictiveCellIndex);
+    }
+    _session.LastActiveColumn = _activeColIndex;
+    return Scanned;
+}
+
+/*************************************************************************************************************/
+CellIndex_t clsASMPrivate::setPredictionStateMapped(clsSessionPrivate& _session, CellIndex_t _activeCell)
+{
+    for (const CellIndex_t* SuccessorIter = this->Snapshot->successorsBegin(_activeCell);
+         SuccessorIter != this->Snapshot->successorsEnd(_activeCell);
+         ++SuccessorIter)
+    {
+        const stuSnapshotCell& Successor = this->Snapshot->cell(*SuccessorIter);
+        if (Successor.Permanence >= this->Configs.MinPermanence2Connect)
+        {
+            _session.PredictedCells.push_back(clsSessionPrivate::stuPredictedCell(Successor.ColID, *SuccessorIter));
+            _session.addPrediction(clsASM::stuPrediction(
+                                       Successor.ColID,
+                                       (_session.SumPathPermanence + Successor.Permanence) / _session.PathItems),
+                                   this->Configs.MaxPredictions);
+        }
+    }
+    return this->Snapshot->successorsEnd(_activeCell) - this->Snapshot->successorsBegin(_activeCell);
+}
+
+/*************************************************************************************************************/
+clsASM::PathPredictionSpan clsASMPrivate::predictAhead(clsSessionPrivate& _session,
+                                                       uint32_t _steps,
+                                                       uint32_t _beamWidth)
+{
+    static const uint32_t NO_PARENT = UINT32_MAX;
+    std::vector<clsSessionPrivate::stuAheadNode>& Nodes = _session.AheadNodes;
+    std::vector<uint32_t>& Leaves = _session.AheadLeaves;
+    Nodes.clear();
+    Leaves.clear();
+    _session.AheadPaths.clear();
+    if (_steps == 0 || _beamWidth == 0)
+        return clsASM::PathPredictionSpan();
+
+    std::shared_lock<std::shared_mutex> ModelLock(this->ModelLock, std::defer_lock);
+    if (this->Configs.ConcurrentLearning)
+        ModelLock.lock();
+
+    //Session must not be changed so if the model has been compacted since the last step of the session its
+    //predicted cells are patched on the fly as syncSession would do
+    bool Remap = _session.CompactionEpoch != this->CompactionEpoch;
+    if (_session.Generation != this->Generation ||
+        (Remap && _session.CompactionEpoch + 1 != this->CompactionEpoch))
+        return clsASM::PathPredictionSpan();
+
+    for (auto CellIter = _session.PredictedCells.begin(); CellIter != _session.PredictedCells.end(); CellIter++){
+        CellIndex_t Index = Remap ? this->CompactionRemap[CellIter->Index] : CellIter->Index;
+        if (Index == INVALID_CELL_INDEX || (this->Snapshot == NULL && this->cell(Index)->isRemoved()))
+            continue;
+        Permanence_t Permanence = this->Snapshot ? this->Snapshot->cell(Index).Permanence :
+                                                   this->cell(Index)->permanence();
+        Nodes.push_back(clsSessionPrivate::stuAheadNode{Index, NO_PARENT, 1, CellIter->ColID,
+                                                        _session.SumPathPermanence + Permanence});
+    }
+
+    //Beam search: best paths of each depth are kept and expanded to the next depth. Ties are broken by cell
+    //index so results do not depend on the order of successor lists
+    auto Better = [](const clsSessionPrivate::stuAheadNode& _a, const clsSessionPrivate::stuAheadNode& _b){
+        return _a.SumPermanence > _b.SumPermanence || (_a.SumPermanence == _b.SumPermanence && _a.Cell < _b.Cell);
+    };
+    size_t DepthBegin = 0;
+    for (uint32_t Depth = 1; DepthBegin < Nodes.size(); ++Depth){
+        if (Nodes.size() - DepthBegin > _beamWidth){
+            std::nth_element(Nodes.begin() + DepthBegin, Nodes.begin() + DepthBegin + _beamWidth - 1, Nodes.end(),
+                             Better);
+            Nodes.resize(DepthBegin + _beamWidth);
+        }
+        size_t DepthEnd = Nodes.size();
+        for (size_t i = DepthBegin; i < DepthEnd; ++i){
+            if (Depth == _steps){
+                Leaves.push_back(i);
+                continue;
+            }
+            size_t Expanded = Nodes.size();
+            uint64_t SumPermanence = Nodes[i].SumPermanence;
+            this->forEachSuccessor(Nodes[i].Cell,
+                                   [this, &Nodes, i, Depth, SumPermanence](CellIndex_t _index,
+                                                                           ColID_t _colID,
+                                                                           Permanence_t _permanence){
+                if (_permanence >= this->Configs.MinPermanence2Connect)
+                    Nodes.push_back(clsSessionPrivate::stuAheadNode{_index, (uint32_t)i, Depth + 1, _colID,
+                                                                    SumPermanence + _permanence});
+            });
+            if (Nodes.size() == Expanded)
+                Leaves.push_back(i);
+        }
+        DepthBegin = DepthEnd;
+    }
+
+    //Paths of different lengths are ranked by their mean permanence
+    uint32_t PathItems = std::max(_session.PathItems, (u_int32_t)1);
+    auto PathPermanence = [&Nodes, PathItems](uint32_t _leaf){
+        return (Permanence_t)(Nodes[_leaf].SumPermanence / (PathItems + Nodes[_leaf].Depth - 1));
+    };
+    size_t Results = std::min((size_t)_beamWidth, Leaves.size());
+    std::partial_sort(Leaves.begin(), Leaves.begin() + Results, Leaves.end(),
+                      [&PathPermanence](uint32_t _a, uint32_t _b){
+        Permanence_t A = PathPermanence(_a), B = PathPermanence(_b);
+        return A > B || (A == B && _a < _b);
+    });
+
+    _session.AheadColIDs.resize(Results * _steps);
+    for (size_t i = 0; i < Results; ++i){
+        ColID_t* ColIDs = &_session.AheadColIDs[i * _steps];
+        uint32_t Length = Nodes[Leaves[i]].Depth;
+        for (uint32_t Node = Leaves[i]; Node != NO_PARENT; Node = Nodes[Node].Parent)
+            ColIDs[Nodes[Node].Depth - 1] = Nodes[Node].ColID;
+        _session.AheadPaths.push_back(clsASM::stuPathPrediction{ColIDs, Length, PathPermanence(Leaves[i])});
+    }
+    return clsASM::PathPredictionSpan(_session.AheadPaths.data(), _session.AheadPaths.size());
+}
+
+/*************************************************************************************************************/
+void clsASMPrivate::feedback(clsSessionPrivate& _session, ColID_t _colID, double _score)
+{
+    if (this->WAL.isOpen())
+        this->logFeedback(_session, _colID, _score);
+
+    std::shared_lock<std::shared_mutex> ModelLock(this->ModelLock, std::defer_lock);
+    if (this->Configs.ConcurrentLearning)
+        ModelLock.lock();
+    if (this->Snapshot)
+        this->exclusively(ModelLock, [this](){ this->ensureInMemory(); });
+    this->syncSession(_session);
+    if (_score == 0){
+        this->award(_session, _colID, this->Configs.PermanenceIncVal);
+        this->punish(_session, _colID, this->Configs.PermanenceDecVal);
+    }else if (_score > 0){
+        this->award(_session, _colID, this->Configs.PermanenceIncVal * (2 > _score ? _score : 2.0));
+    }else{
+        this->punish(_session, _colID, this->Configs.PermanenceDecVal * -1 * (-2 > _score ? _score : -2.0));
+    }
+    this->compactIfNeeded(ModelLock);
+}
+
+/*************************************************************************************************************/
+void clsASMPrivate::award(clsSessionPrivate& _session, ColID_t _colID, Permanence_t _pVal)
+{
+    //Find cell in prediction list which belongs to the awarded column and reinforce it's connection
+    for(auto CellIter = _session.PredictedCells.begin();
+        CellIter != _session.PredictedCells.end();
+        CellIter ++)
+        if (CellIter->ColID == _colID && this->cell(CellIter->Index)->isRemoved() == false){
+            this->cell(CellIter->Index)->increasePermanence(_pVal);
+            this->cell(CellIter->Index)->touch();
+            this->markDirty(CellIter->Index);
+            ASM_STATS_ADD(COUNTER_CellsRewarded, 1);
+            break;
+        }
+}
+
+/*************************************************************************************************************/
+void clsASMPrivate::punish(clsSessionPrivate& _session, ColID_t _colID, Permanence_t _pVal)
+{
+    CellIndex_t Punished = 0;
+    for(auto CellIter = _session.PredictedCells.begin();
+        CellIter != _session.PredictedCells.end();
+        CellIter ++)
+    {
+        //weaken incorrect prediction on all predicted cells except the cell on specified column
+        clsCell* Cell = this->cell(CellIter->Index);
+        if (CellIter->ColID != _colID){
+            Cell->decreasePermanence(_pVal);
+            this->markDirty(CellIter->Index);
+            Punished++;
+        }
+        if (Cell->permanence() == 0 && this->removeCell(CellIter->Index))
+            ASM_STATS_ADD(COUNTER_CellsDecayed, 1);
+    }
+    ASM_STATS_ADD(COUNTER_CellsScanned, _session.PredictedCells.size());
+    ASM_STATS_ADD(COUNTER_CellsPunished, Punished);
+}
+
+/*************************************************************************************************************/
+CellIndex_t clsASMPrivate::setPredictionState(clsSessionPrivate& _session, CellIndex_t _activeCell)
+{
+    //Only cells connected to the active cell can be predicted so there is no need to scan whole network
+    CellIndex_t Scanned = 0;
+    for(CellIndex_t SuccessorIndex = this->cell(_activeCell)->firstSuccessor();
+        SuccessorIndex != INVALID_CELL_INDEX;
+        SuccessorIndex = this->cell(SuccessorIndex)->nextSibling())
+    {
+        clsCell* Successor = this->cell(SuccessorIndex);
+        Permanence_t Permanence = Successor->permanence();
+        Scanned++;
+        //Evicted cells keep their permanence until compaction but must not be predicted meanwhile
+        if (Permanence >= this->Configs.MinPermanence2Connect && Successor->isRemoved() == false)
+        {
+            _session.PredictedCells.push_back(clsSessionPrivate::stuPredictedCell(Successor->colID(), SuccessorIndex));
+            _session.addPrediction(clsASM::stuPrediction(
+                                       Successor->colID(),
+                                       (_session.SumPathPermanence + Permanence) / _session.PathItems),
+                                   this->Configs.MaxPredictions);
+        }
+    }
+    return Scanned;
+}
+
+/*************************************************************************************************************/
+void clsASMPrivate::appendSuccessor(CellIndex_t _destCell, CellIndex_t _successorIndex)
+{
+    //Successors are kept in creation order so the first predicted cell on each column is the oldest one.
+    //New successor is linked to the tail using CAS so neither concurrent learners nor readers need a lock
+    CellIndex_t Tail = _destCell;
+    CellIndex_t Next = this->cell(_destCell)->firstSuccessor();
+    bool        AsFirst = true;
+    do{
+        for (; Next != INVALID_CELL_INDEX; Next = this->cell(Tail)->nextSibling()){
+            Tail = Next;
+            AsFirst = false;
+        }
+    }while (this->cell(Tail)->linkSuccessor(AsFirst, _successorIndex, Next) == false);
+}
+
+/*************************************************************************************************************/
+void clsASMPrivate::buildSuccessorIndex()
+{
+    //Successors are prepended so iterate backward in order to keep them in pool order
+    for (CellIndex_t CellIndex = this->Pool.size(); CellIndex-- > 0; ){
+        clsCell* Cell = this->cell(CellIndex);
+        if (Cell->hasConnection() == false)
+            continue;
+
+        if (Cell->destination() >= this->Pool.size())
+            throw std::logic_error("Invalid connection destination " + std::to_string(Cell->destination()) +
+                                   " on column: " + std::to_string(Cell->colID()) +
+                                   " for cell: " + std::to_string(CellIndex));
+        this->cell(Cell->destination())->prependSuccessor(*Cell, CellIndex);
+    }
+}
+
+/*************************************************************************************************************/
+bool clsASMPrivate::removeCell(CellIndex_t _index)
+{
+    //Cells are just tombstoned on the hot path and will be reclaimed by compaction
+    if (this->cell(_index)->markRemoved() == false)
+        return false;
+    this->RemovedCells++;
+    this->markDirty(_index);
+    return true;
+}
+
+/*************************************************************************************************************/
+void clsASMPrivate::compact()
+{
+    std::unique_lock<std::shared_mutex> ModelLock(this->ModelLock, std::defer_lock);
+    if (this->Configs.ConcurrentLearning)
+        ModelLock.lock();
+    this->compactOnRequest();
+}
+
+/*************************************************************************************************************/
+void clsASMPrivate::merge(clsASMPrivate &_other, clsASM::enuMergePolicy _policy)
+{
+    if (&_other == this)
+        throw std::logic_error("Model can not be merged into itself");
+
+    //Models are locked in address order so merging two models into each other concurrently will not dead lock
+    std::unique_lock<std::shared_mutex> ModelLock(this->ModelLock, std::defer_lock);
+    std::unique_lock<std::shared_mutex> OtherLock(_other.ModelLock, std::defer_lock);
+    if (_other.Configs.ConcurrentLearning && &_other < this)
+        OtherLock.lock();
+    if (this->Configs.ConcurrentLearning)
+        ModelLock.lock();
+    if (_other.Configs.ConcurrentLearning && OtherLock.owns_lock() == false)
+        OtherLock.lock();
+
+    {
+        //Merged cells can not be reproduced by replaying inputs
+        std::unique_lock<std::mutex> WALLock(this->WALLock, std::defer_lock);
+        if (this->Configs.ConcurrentLearning)
+            WALLock.lock();
+        this->WAL.close();
+    }
+    this->ensureInMemory();
+    this->compactInLock();
+
+    auto keyOf = [](ColID_t _colID, CellIndex_t _dest){
+        return ((uint64_t)_colID << 32) | _dest;
+    };
+    auto combine = [_policy](Permanence_t _current, Permanence_t _other) -> Permanence_t{
+        switch (_policy){
+        case clsASM::MergeSum:
+            return MAX_PERMANENCE - _current < _other ? MAX_PERMANENCE : _current + _other;
+        case clsASM::MergeAverage:
+            return ((uint32_t)_current + _other) / 2;
+        default:
+            return std::max(_current, _other);
+        }
+    };
+
+    //Cells of this model are indexed by column and destination cell (INVALID_CELL_INDEX for the cells which
+    //start sequences). A model may have several cells with the same key (i.e. when a connection has been too weak
+    //to be predicted) so they are chained in ZIndex order and matched one by one. Index keeps the first cell
+    //which has not been matched yet and the last cell of each chain while it is being built.
+    std::unordered_map<uint64_t, std::pair<CellIndex_t, CellIndex_t>> Equivalents;
+    std::vector<CellIndex_t> NextEquivalent(this->Pool.size(), INVALID_CELL_INDEX);
+    Equivalents.reserve(this->Pool.size());
+    this->Columns.forEachUnordered([&](ColID_t _colID, clsColumn& _column){
+        for (CellIndex_t CellIndex : _column){
+            auto Inserted = Equivalents.emplace(keyOf(_colID, this->cell(CellIndex)->destination()),
+                                                std::make_pair(CellIndex, CellIndex));
+            if (Inserted.second == false){
+                NextEquivalent[Inserted.first->second.second] = CellIndex;
+                Inserted.first->second.second = CellIndex;
+            }
+        }
+    });
+
+    //Cells of the other model are visited ordered by column and ZIndex so the result does not depend on the
+    //layout of the other model
+    std::vector<CellIndex_t> OtherOrder;
+    if (_other.Snapshot == NULL){
+        OtherOrder.reserve(_other.Pool.size());
+        _other.Columns.forEach([&OtherOrder](ColID_t, const clsColumn& _column){
+            OtherOrder.insert(OtherOrder.end(), _column.begin(), _column.end());
+        });
+    }
+
+    //The other model may be either in memory or mapped
+    CellIndex_t OtherCount = _other.Snapshot ? _other.Snapshot->header().CellCount : _other.Pool.size();
+    //Destinations are snapshot indexes on mapped models and pool indexes on in-memory ones
+    auto otherIndex = [OtherCount](const stuSnapshotCell& _cell) -> CellIndex_t{
+        if (_cell.Destination >= OtherCount)
+            throw std::logic_error("Invalid connection destination " + std::to_string(_cell.Destination) +
+                                   " on merged column: " + std::to_string(_cell.ColID));
+        return _cell.Destination;
+    };
+
+    //Cells of the other model are mapped after their destination so equivalence is checked from sequence start
+    static const CellIndex_t UNRESOLVED = INVALID_CELL_INDEX;
+    static const CellIndex_t RESOLVING = INVALID_CELL_INDEX - 1;
+    static const CellIndex_t SKIPPED = INVALID_CELL_INDEX - 2;
+    std::vector<CellIndex_t> Mapped(OtherCount, UNRESOLVED);
+    std::vector<CellIndex_t> Pending;
+    std::vector<std::pair<CellIndex_t, CellIndex_t>> NewCells;
+    for (CellIndex_t i = 0; i < OtherCount; ++i){
+        CellIndex_t OtherIndex = _other.Snapshot ? i : OtherOrder[i];
+        if (Mapped[OtherIndex] != UNRESOLVED)
+            continue;
+        Mapped[OtherIndex] = RESOLVING;
+        Pending.push_back(OtherIndex);
+        while (Pending.size()){
+            CellIndex_t Current = Pending.back();
+            stuSnapshotCell Cell = _other.Snapshot ? _other.Snapshot->cell(Current) : _other.snapshotCell(Current);
+            CellIndex_t Dest = INVALID_CELL_INDEX;
+            //Cells connected to removed cells would be removed by compaction so they are not merged
+            if (_other.Snapshot == NULL && _other.cell(Current)->isRemoved())
+                Dest = SKIPPED;
+            else if (Cell.Destination != INVALID_CELL_INDEX){
+                CellIndex_t OtherDest = otherIndex(Cell);
+                if (Mapped[OtherDest] == UNRESOLVED){
+                    Mapped[OtherDest] = RESOLVING;
+                    Pending.push_back(OtherDest);
+                    continue;
+                }
+                if (Mapped[OtherDest] == RESOLVING)
+                    throw std::logic_error("Cyclic connection on merged column: " + std::to_string(Cell.ColID));
+                Dest = Mapped[OtherDest];
+            }
+            Pending.pop_back();
+            if (Dest == SKIPPED){
+                Mapped[Current] = SKIPPED;
+                continue;
+            }
+
+            //Each cell of this model is equivalent to a single cell of the other model
+            auto Found = Equivalents.find(keyOf(Cell.ColID, Dest));
+            if (Found != Equivalents.end() && Found->second.first != INVALID_CELL_INDEX){
+                CellIndex_t EquivalentIndex = Found->second.first;
+                Found->second.first = NextEquivalent[EquivalentIndex];
+                clsCell* Equivalent = this->cell(EquivalentIndex);
+                Permanence_t Permanence = combine(Equivalent->permanence(), Cell.Permanence);
+                if (Permanence != Equivalent->permanence()){
+                    Equivalent->setPermanence(Permanence);
+                    this->markDirty(EquivalentIndex);
+                }
+                Mapped[Current] = EquivalentIndex;
+            }else{
+                Mapped[Current] = this->addCell(this->Columns.get(Cell.ColID),
+                                                Cell.ColID,
+                                                Cell.States,
+                                                Dest,
+                                                Cell.Permanence);
+                this->markDirty(Mapped[Current]);
+                NewCells.push_back(std::make_pair(Mapped[Current], Dest));
+            }
+        }
+    }
+
+    //New cells are linked after the tail of their destination's successors which is found once for each
+    //destination so linking is linear too. They are linked in pool order to keep successors in pool order.
+    std::vector<CellIndex_t> Tails(this->Pool.size(), INVALID_CELL_INDEX);
+    for (auto NewIter = NewCells.begin(); NewIter != NewCells.end(); NewIter++){
+        CellIndex_t Dest = NewIter->second;
+        if (Dest == INVALID_CELL_INDEX)
+            continue;
+        CellIndex_t& Tail = Tails[Dest];
+        if (Tail == INVALID_CELL_INDEX){
+            Tail = Dest;
+            for (CellIndex_t Next = this->cell(Dest)->firstSuccessor();
+                 Next != INVALID_CELL_INDEX;
+                 Next = this->cell(Next)->nextSibling())
+                Tail = Next;
+        }
+        CellIndex_t Next;
+        this->cell(Tail)->linkSuccessor(Tail == Dest, NewIter->first, Next);
+        Tail = NewIter->first;
+    }
+}
+
+/*************************************************************************************************************/
+clsASM::Stats clsASMPrivate::stats()
+{
+    std::shared_lock<std::shared_mutex> ModelLock(this->ModelLock, std::defer_lock);
+    if (this->Configs.ConcurrentLearning)
+        ModelLock.lock();
+
+    clsASM::Stats Current = clsASM::Stats();
+    {
+        std::unique_lock<std::mutex> PoolLock(this->PoolLock, std::defer_lock);
+        if (this->Configs.ConcurrentLearning)
+            PoolLock.lock();
+        Current.RemovedCells = this->RemovedCells;
+        Current.Cells = this->Snapshot ? this->Snapshot->header().CellCount : this->Pool.size() - Current.RemovedCells;
+        Current.PoolBytes = this->Pool.memoryUsage();
+    }
+    Current.Compactions = this->CompactionEpoch;
+#ifdef ASM_STATS
+    this->Stats.aggregate(Current);
+#endif
+    Current.Uptime = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->CreationTime).count();
+    return Current;
+}
+
+/*************************************************************************************************************/
+void clsASMPrivate::compactIfNeeded(std::shared_lock<std::shared_mutex> &_modelLock)
+{
+    if (this->isCompactionNeeded())
+        //Another thread may have compacted the model meanwhile
+        this->exclusively(_modelLock, [this](){
+            if (this->isCompactionNeeded())
+                this->compactInLock();
+        });
+}
+
+/*************************************************************************************************************/
+bool clsASMPrivate::isCompactionNeeded()
+{
+    if (this->RemovedCells < this->compactionThreshold())
+        return false;
+    std::unique_lock<std::mutex> PoolLock(this->PoolLock, std::defer_lock);
+    if (this->Configs.ConcurrentLearning)
+        PoolLock.lock();
+    return this->RemovedCells >= this->Pool.size() / COMPACTION_REMOVED_RATIO;
+}
+
+/*************************************************************************************************************/
+CellIndex_t clsASMPrivate::compactionThreshold() const
+{
+    //Budgeted models are compacted sooner so the pool will not exceed the budget by more than a third
+    if (this->Configs.MaxCells && this->Configs.MaxCells / COMPACTION_REMOVED_RATIO < COMPACTION_MIN_REMOVED_CELLS)
+        return this->Configs.MaxCells / COMPACTION_REMOVED_RATIO + 1;
+    return COMPACTION_MIN_REMOVED_CELLS;
+}
+
+/*************************************************************************************************************/
+void clsASMPrivate::evictIfNeeded(CellIndex_t _protected)
+{
+    if (this->Configs.MaxCells == 0)
+        return;
+
+    std::unique_lock<std::mutex> PoolLock(this->PoolLock, std::defer_lock);
+    if (this->Configs.ConcurrentLearning)
+        PoolLock.lock();
+
+    //CLOCK sweep: Cells used since the last pass get a second chance and the cell with least permanence among
+    //the first unused cells is evicted. Sweep is bounded so a single step never scans the whole pool.
+    //Cells without connection are the first cells of the columns which all the sequences start from so
+    //they are evicted just when there is nothing else to evict.
+    for (CellIndex_t Evictions = 0;
+         Evictions < EVICTIONS_PER_NEW_CELL &&
+         this->Pool.size() - this->RemovedCells >= this->Configs.MaxCells;
+         ++Evictions){
+        CellIndex_t Victim = INVALID_CELL_INDEX;
+        int32_t     VictimScore = INT32_MAX;
+        CellIndex_t Samples = 0;
+        CellIndex_t Scanned = 0;
+        for (; Scanned < EVICTION_SCAN_LIMIT && Samples < EVICTION_SAMPLES; ++Scanned){
+            if (this->EvictionHand >= this->Pool.size())
+                this->EvictionHand = 0;
+            CellIndex_t CellIndex = this->EvictionHand++;
+            clsCell* Cell = this->cell(CellIndex);
+            if (Cell->isRemoved() || CellIndex == _protected)
+                continue;
+            int32_t Score = Cell->hasConnection() ? Cell->permanence() : MAX_PERMANENCE + 1;
+            if (Cell->isReferenced()){
+                Cell->clearReferenced();
+                //Used cells are candidates just when all the scanned cells have been used
+                Score += MAX_PERMANENCE + 2;
+            }else
+                Samples++;
+            if (Score < VictimScore){
+                Victim = CellIndex;
+                VictimScore = Score;
+            }
+        }
+        if (Victim == INVALID_CELL_INDEX)
+            return;
+        this->removeCell(Victim);
+        ASM_STATS_ADD(COUNTER_CellsEvicted, 1);
+        ASM_STATS_ADD(COUNTER_CellsScanned, Scanned);
+    }
+}
+
+/*************************************************************************************************************/
+clsASM::MaintenanceReport clsASMPrivate::maintain(Permanence_t _decay)
+{
+    std::unique_lock<std::shared_mutex> ModelLock(this->ModelLock, std::defer_lock);
+    if (this->Configs.ConcurrentLearning)
+        ModelLock.lock();
+    this->ensureInMemory();
+    clsASM::MaintenanceReport Report = this->maintainInLock(_decay);
+    if (_decay && this->WAL.isOpen()){
+        std::unique_lock<std::mutex> WALLock(this->WALLock, std::defer_lock);
+        if (this->Configs.ConcurrentLearning)
+            WALLock.lock();
+        if (this->WAL.isOpen())
+            this->WAL.appendMaintenance(_decay);
+    }
+    if (this->isCompactionNeeded())
+        this->compactInLock();
+    return Report;
+}
+
+/*************************************************************************************************************/
+clsASM::MaintenanceReport clsASMPrivate::maintainInLock(Permanence_t _decay)
+{
+    clsASM::MaintenanceReport Report;
+    memset(&Report, 0, sizeof(Report));
+    Permanence_t MinPermanence2Connect = this->Configs.MinPermanence2Connect;
+
+    //Decay changes nearly all the cells so they are not tracked one by one. Next checkpoint writes a fresh base
+    //instead of journaling the whole pool and tracking is enabled again by it.
+    if (_decay)
+        this->Columns.setDirtyTracking(false);
+
+    //Pool is swept chunk by chunk. Cells without connection (first cells of the columns) have no permanence
+    this->Pool.forEachChunk([&](clsCell* _cells, CellIndex_t _first, CellIndex_t _count){
+        for (CellIndex_t i = 0; i < _count; ++i){
+            clsCell& Cell = _cells[i];
+            if (Cell.hasConnection() == false || Cell.isRemoved())
+                continue;
+            Report.Connections++;
+            Permanence_t Permanence = Cell.permanence();
+            if (_decay && Permanence){
+                Permanence = Permanence > _decay ? Permanence - _decay : 0;
+                Cell.setPermanence(Permanence);
+                if (Permanence == 0){
+                    this->removeCell(_first + i);
+                    Report.Removed++;
+                    continue;
+                }
+            }
+            Report.Weak += Permanence < MinPermanence2Connect;
+            Report.Permanence.Buckets[clsASM::Stats::Histogram::bucket(Permanence)]++;
+            Report.Permanence.Sum += Permanence;
+        }
+    });
+    Report.Permanence.Count = Report.Connections - Report.Removed;
+    ASM_STATS_ADD(COUNTER_CellsDecayed, Report.Removed);
+    return Report;
+}
+
+/*************************************************************************************************************/
+void clsASMPrivate::compactInLock()
+{
+    if (this->RemovedCells == 0)
+        return;
+
+    //Cells connected to removed cells are kept and connected to the nearest remaining cell on the removed path
+    //so sequences learnt after a forgotten step are not lost with it
+    for (CellIndex_t CellIndex = 0; CellIndex < this->Pool.size(); ++CellIndex){
+        clsCell* Cell = this->cell(CellIndex);
+        if (Cell->isRemoved() || Cell->hasConnection() == false)
+            continue;
+        CellIndex_t Destination = Cell->destination();
+        while (Destination != INVALID_CELL_INDEX && this->cell(Destination)->isRemoved())
+            Destination = this->cell(Destination)->destination();
+        Cell->setDestination(Destination);
+    }
+
+    //Remaining cells keep their creation order so cells of each column stay in pool order. Destination of a
+    //replayed cell may have been created after it so all new indexes are known before cells are copied
+    std::vector<CellIndex_t> Remap(this->Pool.size(), INVALID_CELL_INDEX);
+    CellIndex_t NextIndex = 0;
+    for (CellIndex_t CellIndex = 0; CellIndex < this->Pool.size(); ++CellIndex)
+        if (this->cell(CellIndex)->isRemoved() == false)
+            Remap[CellIndex] = NextIndex++;
+
+    //Copy remaining cells to a new pool patching their connection destination
+    clsCellPool NewPool;
+    if (this->Configs.ConcurrentLearning)
+        NewPool.reserveChunkTable();
+    for (CellIndex_t CellIndex = 0; CellIndex < this->Pool.size(); ++CellIndex){
+        clsCell* Cell = this->cell(CellIndex);
+        if (Cell->isRemoved())
+            continue;
+        NewPool.append(clsCell(Cell->colID(),
+                               Cell->states(),
+                               Cell->hasConnection() ? Remap[Cell->destination()] : INVALID_CELL_INDEX,
+                               Cell->permanence()));
+    }
+
+    this->Columns.forEachUnordered([&Remap](ColID_t, clsColumn& _column){
+        size_t Kept = 0;
+        for (CellIndex_t CellIndex : _column)
+            if (Remap[CellIndex] != INVALID_CELL_INDEX)
+                _column[Kept++] = Remap[CellIndex];
+        _column.resize(Kept);
+        _column.shrink_to_fit();
+    });
+    this->Columns.removeEmpty();
+
+    //Old pool is released here
+    this->Pool.swap(NewPool);
+    this->buildSuccessorIndex();
+
+    //Eviction sweep continues from the first remaining cell after it's last position
+    CellIndex_t Hand = this->EvictionHand;
+    while (Hand < Remap.size() && Remap[Hand] == INVALID_CELL_INDEX)
+        Hand++;
+    this->EvictionHand = Hand < Remap.size() ? Remap[Hand] : 0;
+
+    this->RemovedCells = 0;
+    this->CompactionRemap.swap(Remap);
+    this->CompactionEpoch++;
+}
+
+/*************************************************************************************************************/
+void clsASMPrivate::compactOnRequest()
+{
+    uint64_t Epoch = this->CompactionEpoch;
+    this->compactInLock();
+
+    //Automatic compactions are repeated by replay itself but requested ones renumber cells at arbitrary points
+    if (this->CompactionEpoch != Epoch && this->WAL.isOpen()){
+        std::unique_lock<std::mutex> WALLock(this->WALLock, std::defer_lock);
+        if (this->Configs.ConcurrentLearning)
+            WALLock.lock();
+        if (this->WAL.isOpen())
+            this->WAL.appendCompaction();
+    }
+}
+
+/*************************************************************************************************************/
+void clsASMPrivate::syncSession(clsSessionPrivate &_session)
+{
+    if (_session.Generation == this->Generation && _session.CompactionEpoch == this->CompactionEpoch)
+        return;
+
+    //Cells of the session can be patched just if they belong to the pool before the last compaction
+    bool Patchable = _session.Generation == this->Generation &&
+                     _session.CompactionEpoch + 1 == this->CompactionEpoch &&
+                     (_session.LastLearningCell == INVALID_CELL_INDEX ||
+                      this->CompactionRemap[_session.LastLearningCell] != INVALID_CELL_INDEX);
+    _session.Generation = this->Generation;
+    _session.CompactionEpoch = this->CompactionEpoch;
+    if (Patchable == false)
+        return _session.restart();
+
+    if (_session.LastLearningCell != INVALID_CELL_INDEX)
+        _session.LastLearningCell = this->CompactionRemap[_session.LastLearningCell];
+    size_t Kept = 0;
+    for (size_t i = 0; i < _session.PredictedCells.size(); ++i){
+        CellIndex_t NewIndex = this->CompactionRemap[_session.PredictedCells[i].Index];
+        if (NewIndex != INVALID_CELL_INDEX)
+            _session.PredictedCells[Kept++] = clsSessionPrivate::stuPredictedCell(this->cell(NewIndex)->colID(),
+                                                                                 NewIndex);
+    }
+    _session.PredictedCells.erase(_session.PredictedCells.begin() + Kept, _session.PredictedCells.end());
 }
 }
@@ -23,11 +23,18 @@
 #ifndef CLSASM_H
 #define CLSASM_H
 
+#include <cstddef>
 #include <list>
+#include <string>
+#include <type_traits>
+#include <future>
+#include <functional>
 
 namespace AdaptiveSequenceMemorizer{
 
 class clsASMPrivate;
+class clsSessionPrivate;
+class clsFrozenASM;
 
 typedef uint32_t ColID_t;
 typedef uint16_t Permanence_t;
@@ -59,6 +66,12 @@ public:
         Permanence_t  InitialConnectionPermanence;
         Permanence_t  PermanenceIncVal;
         Permanence_t  PermanenceDecVal;
+        bool          SparseColumns;
+        bool          ConcurrentLearning;
+        uint32_t      MaxCells;
+        uint32_t      MaxPredictions;
+        uint32_t      MaintenanceInterval;
+        Permanence_t  MaintenanceDecay;
 
         /**
          * @brief Configs constructor
@@ -66,18 +79,52 @@ public:
          * @param _minPermanence2Connect Minimum permanence value required in order to suppose cells connected
          * @param _permanenceIncVal Value to be increased to connection permanence value on correct predictions.
          * @param _permanenceDecVal Value to be decreased from connection permanence value on incorrect predictions
+         * @param _sparseColumns Keep columns in a hash table instead of a vector indexed by ColID. Use it when
+         * input IDs are very large or sparse (e.g. hashed features) so memory is proportional to the number of
+         * seen IDs instead of the greatest seen ID.
+         * @param _concurrentLearning Make learning thread safe so several sessions can learn on the same model
+         * in parallel. Columns are guarded by striped locks and permanence values are updated atomically.
+         * Sessions learning the same transition at the same time may create duplicate cells.
+         * @param _maxCells Maximum number of live cells (0 means unlimited). When learning a new cell on a full
+         * model the least valuable cells are evicted: a CLOCK sweep gives a second chance to the cells used since
+         * its last pass and evicts the one with the least connection permanence among the first unused cells it
+         * finds. Memory of evicted cells is reclaimed by compaction so the pool may exceed the budget by a third
+         * meanwhile. Each cell costs about sizeof(clsCell) + sizeof(CellIndex_t) bytes so a byte budget can be
+         * converted to cells by dividing it by 24.
+         * @param _maxPredictions Maximum number of predictions returned on each step (0 means unlimited). When set,
+         * just the predictions having greatest PathPermanence are kept while they are collected and they are
+         * returned in descending order of PathPermanence (and ascending ColID on ties), so the cost of returning
+         * predictions does not grow with the number of successors. Otherwise all of the predictions are returned
+         * in the order cells have been learnt. Learning still considers all of the predicted cells.
+         * @param _maintenanceInterval Number of learning steps between scheduled maintenance sweeps (0 disables
+         * them). Each sweep decays all the connections as maintain() does, so connections which are never
+         * predicted again are forgotten too. It is made by the step which reaches the interval while the model
+         * is locked exclusively.
+         * @param _maintenanceDecay Value to be decreased from all the connections on each scheduled sweep
          */
         Configs(
                 Permanence_t  _initialConnectionPermanence = 500,
                 Permanence_t  _minPermanence2Connect = 300,
                 Permanence_t  _permanenceIncVal= 50,
-                Permanence_t  _permanenceDecVal = 1
+                Permanence_t  _permanenceDecVal = 1,
+                bool          _sparseColumns = false,
+                bool          _concurrentLearning = false,
+                uint32_t      _maxCells = 0,
+                uint32_t      _maxPredictions = 0,
+                uint32_t      _maintenanceInterval = 0,
+                Permanence_t  _maintenanceDecay = 1
                 )
         {
             this->InitialConnectionPermanence = _initialConnectionPermanence;
             this->MinPermanence2Connect = _minPermanence2Connect;
             this->PermanenceDecVal = _permanenceDecVal;
             this->PermanenceIncVal = _permanenceIncVal;
+            this->SparseColumns = _sparseColumns;
+            this->ConcurrentLearning = _concurrentLearning;
+            this->MaxCells = _maxCells;
+            this->MaxPredictions = _maxPredictions;
+            this->MaintenanceInterval = _maintenanceInterval;
+            this->MaintenanceDecay = _maintenanceDecay;
         }
     };
 
@@ -99,6 +146,201 @@ public:
 
     typedef std::list<clsASM::stuPrediction>  Prediction_t;
 
+    /**
+     * @brief The Span struct is a read only view of items which are kept contiguously by the model or a session.
+     * It does not own items and is valid until the next call on the same session.
+     */
+    template <class Item_t>
+    struct Span{
+        const Item_t* Data;
+        size_t        Size;
+
+        Span(const Item_t* _data = NULL, size_t _size = 0){
+            this->Data = _data;
+            this->Size = _size;
+        }
+
+        inline const Item_t* begin() const {return this->Data;}
+        inline const Item_t* end() const {return this->Data + this->Size;}
+        inline size_t size() const {return this->Size;}
+        inline bool empty() const {return this->Size == 0;}
+        inline const Item_t& operator[](size_t _index) const {return this->Data[_index];}
+    };
+
+    typedef Span<clsASM::stuPrediction>  PredictionSpan;
+
+    /**
+     * @brief The stuPathPrediction struct is a path of predicted columns several steps ahead.
+     * PathPermanence is the mean permanence of the whole path including the steps already seen by the session
+     * so it is comparable with stuPrediction::PathPermanence and between paths of different lengths.
+     */
+    struct stuPathPrediction{
+        /// Predicted columns in order. First one is the next step
+        const ColID_t* ColIDs;
+        uint32_t       Length;
+        Permanence_t   PathPermanence;
+    };
+
+    typedef Span<clsASM::stuPathPrediction>  PathPredictionSpan;
+
+    /**
+     * @brief The Stats struct is a snapshot of model counters. Counters are cumulative since the model has been
+     * created so rates (e.g. evictions per second) are computed by diffing two snapshots over their Uptime.
+     * Counters of the steps are kept per thread and aggregated when read. They remain zero when the library has
+     * been built without ASM_STATS. PredictionHits and PredictionMisses are counted on learning steps
+     * (not LearningFrozen) after the first pattern of each sequence depending on whether the input had been
+     * predicted on the previous step.
+     */
+    struct Stats
+    {
+        /**
+         * @brief The Histogram struct counts values on power of two buckets. Bucket zero counts zeros and
+         * bucket i counts values in [2^(i-1), 2^i). Last bucket counts all greater values too.
+         */
+        struct Histogram
+        {
+            enum { BUCKETS = 32 };
+            uint64_t  Buckets[BUCKETS];
+            uint64_t  Count;
+            uint64_t  Sum;
+
+            static inline int bucket(uint64_t _value){
+                int Bucket = _value ? 64 - __builtin_clzll(_value) : 0;
+                return Bucket < BUCKETS ? Bucket : BUCKETS - 1;
+            }
+            /**
+             * @brief upperBound greatest value counted on the bucket (except last bucket which is unbounded)
+             */
+            static inline uint64_t upperBound(int _bucket){
+                return _bucket ? (1ULL << _bucket) - 1 : 0;
+            }
+            /**
+             * @brief percentile returns upper bound of the bucket containing _p-th percentile (0 < _p <= 1)
+             */
+            uint64_t percentile(double _p) const;
+        };
+
+        uint64_t   Cells;
+        uint64_t   RemovedCells;
+        uint64_t   PoolBytes;
+        uint64_t   Compactions;
+        /// Steps indexed by enuLearningLevel. NULL inputs are counted just as SequenceResets
+        uint64_t   Steps[3];
+        uint64_t   SequenceResets;
+        uint64_t   CellsCreated;
+        uint64_t   CellsRewarded;
+        uint64_t   CellsPunished;
+        /// Cells removed because their connection permanence has been decreased to zero
+        uint64_t   CellsDecayed;
+        uint64_t   EvictedCells;
+        uint64_t   PredictionHits;
+        uint64_t   PredictionMisses;
+        uint64_t   PredictionsEmitted;
+        /// Cells visited to find predictions, first cells of the columns and punished cells
+        uint64_t   CellsScanned;
+        /// Heap allocations made by steps: growth of prediction buffers, growth of columns and new columns
+        uint64_t   Allocations;
+        /// Predictions per step
+        Histogram  FanOut;
+        /// Cells scanned per step
+        Histogram  ScannedCells;
+        /// executeOnce latency in nanoseconds sampled on one of each 16 steps of each thread
+        Histogram  LatencyNS;
+        double     Uptime;
+
+        inline double hitRate() const{
+            return PredictionHits + PredictionMisses ?
+                        (double)PredictionHits / (PredictionHits + PredictionMisses) : 0;
+        }
+
+        /**
+         * @brief toText formats all the counters in Prometheus text exposition format so they can be scraped
+         * @param _prefix prefix of the metric names
+         */
+        std::string toText(const std::string& _prefix = "asm") const;
+    };
+
+    /**
+     * @brief The MaintenanceReport struct summarizes the connections swept by maintain()
+     */
+    struct MaintenanceReport
+    {
+        /// Live connections which have been swept
+        uint64_t          Connections;
+        /// Cells removed because their connection permanence has been decreased to zero
+        uint64_t          Removed;
+        /// Remaining connections weaker than MinPermanence2Connect which will not be predicted
+        uint64_t          Weak;
+        /// Permanence of the remaining connections
+        Stats::Histogram  Permanence;
+    };
+
+    /**
+     * @brief The Session class keeps position of a single input stream on the model: last learning cell,
+     * predicted cells and path permanence. Model itself is not copied so a single model can be shared between
+     * as many sessions as needed. Sessions are restarted automatically when the model is reloaded.
+     * @see executeOnce(Session&, ColID_t, enuLearningLevel)
+     */
+    class Session
+    {
+    public:
+        Session();
+        ~Session();
+
+        /**
+         * @brief predictions returns predictions made on the last step of this session
+         */
+        const Prediction_t& predictions() const;
+
+        /**
+         * @brief predictionSpan returns predictions made on the last step of this session without copying them
+         */
+        PredictionSpan predictionSpan() const;
+
+    private:
+        Session(const Session&);
+        Session& operator = (const Session&);
+
+    private:
+        clsSessionPrivate* pPrivate;
+        friend class clsASM;
+    };
+
+    /**
+     * @brief File formats supported by save and convert
+     * FormatText: Human readable line oriented format.
+     * FormatBinary: Versioned flat binary snapshot which can be mapped to memory (@see LoadMapped)
+     */
+    enum enuFileFormat{
+        FormatText,
+        FormatBinary
+    };
+
+    /**
+     * @brief Load modes
+     * LoadToMemory: Model will be read to memory and can be used for both learning and prediction.
+     * LoadMapped: Binary snapshot will be mapped to memory and LearningFrozen predictions will be served
+     *  directly from mapped pages so loading time is independent of model size. First call which needs
+     *  to change the model (learning, feedback or save) will copy model to memory. Snapshots having a
+     *  checkpoint journal (@see checkpoint) are loaded to memory as the journal must be replayed.
+     */
+    enum enuLoadMode{
+        LoadToMemory,
+        LoadMapped
+    };
+
+    /**
+     * @brief Policies used by merge to combine connection permanence of equivalent cells
+     * MergeMax: Greater permanence is kept
+     * MergeSum: Permanences are added saturating on the maximum permanence
+     * MergeAverage: Average of the permanences is kept
+     */
+    enum enuMergePolicy{
+        MergeMax,
+        MergeSum,
+        MergeAverage
+    };
+
 public:
     /**
      * @brief clsASM Base class implementing Adaptive Sequence Memorizer
@@ -139,6 +381,68 @@ public:
     const Prediction_t& executeOnce(ColID_t _input,
                                                    enuLearningLevel _learningLevel = LearningFull);
 
+    /**
+     * @brief executeOnce same as executeOnce(ColID_t, enuLearningLevel) but sequence position and predictions
+     * are kept in @see _session instead of the model's default session.
+     * LearningFrozen calls do not change the model so any number of sessions can be executed on a shared
+     * model from different threads at the same time. Other learning levels and feedback change the model
+     * and can be called concurrently just when Configs::ConcurrentLearning is set. load and save must never
+     * be called concurrently with any other call unless Configs::ConcurrentLearning is set.
+     * @return predictions of the session which are valid until next call on the same session
+     */
+    const Prediction_t& executeOnce(Session& _session,
+                                    ColID_t _input,
+                                    enuLearningLevel _learningLevel = LearningFull);
+
+    /**
+     * @brief executeOnce same as executeOnce(ColID_t, enuLearningLevel) but predictions are copied to the
+     * caller provided @see _output buffer instead of being returned as a list so steps do not allocate once
+     * internal buffers have grown to the greatest fan-out. Predictions can also be read in place with
+     * predictionSpan() by passing an empty buffer.
+     * @param _output buffer to receive predictions. It can be NULL when @see _capacity is zero
+     * @param _capacity number of predictions which fit in @see _output
+     * @return number of predictions made. If it is greater than @see _capacity just the first
+     * @see _capacity predictions have been copied
+     */
+    size_t executeOnce(ColID_t _input,
+                       stuPrediction* _output,
+                       size_t _capacity,
+                       enuLearningLevel _learningLevel = LearningFull);
+
+    /**
+     * @brief executeOnce same as executeOnce(ColID_t, stuPrediction*, size_t, enuLearningLevel) on the
+     * specified session
+     */
+    size_t executeOnce(Session& _session,
+                       ColID_t _input,
+                       stuPrediction* _output,
+                       size_t _capacity,
+                       enuLearningLevel _learningLevel = LearningFull);
+
+    /**
+     * @brief predictionSpan returns predictions made on the last step of the default session without
+     * copying them. @see Session::predictionSpan()
+     */
+    PredictionSpan predictionSpan() const;
+
+    /**
+     * @brief predictAhead predicts paths of up to @see _steps columns following the current position of the
+     * default session by following connections forward from the cells predicted on the last step. The model
+     * and the session are not changed. At each step just the best @see _beamWidth partial paths (by
+     * accumulated permanence) are expanded. Paths reaching a cell with no successor end there so shorter
+     * paths may be returned.
+     * @return at most @see _beamWidth paths ordered by descending PathPermanence. Paths are kept in scratch
+     * buffers of the session which are reused so repeated calls do not allocate. They are valid until the next
+     * call on the same session.
+     */
+    PathPredictionSpan predictAhead(uint32_t _steps, uint32_t _beamWidth) const;
+
+    /**
+     * @brief predictAhead same as predictAhead(uint32_t, uint32_t) on the specified session. It can be called
+     * from different threads on different sessions as LearningFrozen steps can.
+     */
+    PathPredictionSpan predictAhead(Session& _session, uint32_t _steps, uint32_t _beamWidth) const;
+
     /**
      * @brief execute this method will show a sequence of patterns to the network using input generator
      * @param _inputGenerator a derived class from intfInputIterator which will generate inputs
@@ -149,6 +453,60 @@ public:
     const Prediction_t& execute(intfInputIterator* _inputGenerator,
                                                int32_t _ticks = -1,
                                                enuLearningLevel _learningLevel = LearningFull);
+
+    /**
+     * @brief execute same as execute(intfInputIterator*, int32_t, enuLearningLevel) on the specified session
+     */
+    const Prediction_t& execute(Session& _session,
+                                intfInputIterator* _inputGenerator,
+                                int32_t _ticks = -1,
+                                enuLearningLevel _learningLevel = LearningFull);
+
+    /**
+     * @brief executeBulk shows a contiguous buffer of inputs to the model in a tight loop. Inputs continue the
+     * current sequence of the default session (no reset is made before the first input) and @see _input = 0
+     * marks sequence boundaries as in executeOnce. Intermediate predictions are not returned, predictions of
+     * the last input can be read by predictionSpan(). This is intended for offline training on large datasets.
+     * @param _inputs buffer of @see _count inputs
+     */
+    void executeBulk(const ColID_t* _inputs,
+                     size_t _count,
+                     enuLearningLevel _learningLevel = LearningFull);
+
+    /**
+     * @brief executeBulk same as executeBulk(const ColID_t*, size_t, enuLearningLevel) on the specified session
+     */
+    void executeBulk(Session& _session,
+                     const ColID_t* _inputs,
+                     size_t _count,
+                     enuLearningLevel _learningLevel = LearningFull);
+
+    /**
+     * @brief executeBulk reads inputs from a generator of a statically known type until it returns NOT_ASSIGNED
+     * or @see _ticks inputs have been read, and shows them to the model as executeBulk(const ColID_t*, size_t,
+     * enuLearningLevel) does. Generator_t::next() is called without virtual dispatch so generators deriving
+     * intfInputIterator (and any other class with a next() method) are inlined in the read loop.
+     * @param _ticks maximum number of inputs to read. -1 means until end of data
+     * @return number of inputs shown to the model
+     */
+    template <class Generator_t, class = typename std::enable_if<std::is_pointer<Generator_t>::value == false>::type>
+    size_t executeBulk(Generator_t& _generator,
+                       int64_t _ticks = -1,
+                       enuLearningLevel _learningLevel = LearningFull){
+        return this->executeBulk(NULL, _generator, _ticks, _learningLevel);
+    }
+
+    /**
+     * @brief executeBulk same as executeBulk(Generator_t&, int64_t, enuLearningLevel) on the specified session
+     */
+    template <class Generator_t, class = typename std::enable_if<std::is_pointer<Generator_t>::value == false>::type>
+    size_t executeBulk(Session& _session,
+                       Generator_t& _generator,
+                       int64_t _ticks = -1,
+                       enuLearningLevel _learningLevel = LearningFull){
+        return this->executeBulk(&_session, _generator, _ticks, _learningLevel);
+    }
+
     /**
      * @brief feedback external feedback to award or punishment of last prediction.
      * Awarding and Punishment score is controlled using @see _score.
@@ -163,8 +521,200 @@ public:
      */
     void feedback(ColID_t _colID, double _score = 0);
 
-    bool load(const char* _filePath, bool _throw = false);
-    bool save(const char* _filePath);
+    /**
+     * @brief feedback same as feedback(ColID_t, double) applied on last predictions of @see _session
+     */
+    void feedback(Session& _session, ColID_t _colID, double _score = 0);
+
+    /**
+     * @brief compact reclaims memory of the cells which have been removed because their connection permanence
+     * has been decreased to zero. Cells connected to removed cells are kept and connected to the cell which the
+     * removed ones were connected to. Remaining cells of each column will be renumbered so predictions pending on
+     * sessions are patched on their next call.
+     * Compaction runs automatically when removed cells exceed a quarter of the model. It can also be called
+     * from a maintenance thread when Configs::ConcurrentLearning is set.
+     */
+    void compact();
+
+    /**
+     * @brief maintain sweeps all the connections of the model in a single pass over the cell pool. Permanence
+     * of each connection is decreased by @see _decay (saturating on zero) and cells whose permanence reaches
+     * zero are removed, so connections which are never predicted again are forgotten. Zero decay just
+     * summarizes the connections. Model is locked exclusively meanwhile. A decaying sweep changes nearly all the
+     * cells so they are not journaled: next checkpoint() writes a fresh base instead.
+     * @return summary of the connections after the sweep
+     */
+    MaintenanceReport maintain(Permanence_t _decay = 0);
+
+    /**
+     * @brief merge adds sequences learnt by another model (i.e. trained on another partition of data) to this
+     * model. Cells of the same column which are connected to equivalent cells, or both start sequences, are
+     * equivalent so sequences learnt by both models are kept once and their permanence is combined using
+     * @see _policy. Other cells are added to this model and their connections are remapped to cells of this
+     * model. It runs in time linear to the size of both models. Configs of this model are kept, sessions stay
+     * valid and write ahead log is stopped (@see startWAL) as merged cells can not be replayed from inputs.
+     * On concurrent learning both models are locked while merging.
+     */
+    void merge(const clsASM& _other, enuMergePolicy _policy = MergeMax);
+
+    /**
+     * @brief freeze compiles the model to an immutable inference engine (@see clsFrozenASM in clsFrozenASM.h)
+     * which predicts the same as LearningFrozen steps on this model without locking. Removed cells are
+     * compacted first as save() does. The model itself is not changed otherwise and can go on learning
+     * while the engine keeps the point in time state.
+     */
+    clsFrozenASM freeze();
+
+    /**
+     * @brief stats returns current counters of the model. It can be called concurrently with learning when
+     * Configs::ConcurrentLearning is set.
+     */
+    Stats stats();
+
+    /**
+     * @brief load loads a model saved in any of the supported formats. Format is detected automatically.
+     * @param _filePath path to the model file
+     * @param _throw if set errors will be thrown as std::exception else they will be reported on stderr
+     * @param _mode @see enuLoadMode. LoadMapped is supported just for binary snapshots
+     * @return true on success
+     */
+    bool load(const char* _filePath, bool _throw = false, enuLoadMode _mode = LoadToMemory);
+
+    /**
+     * @brief save stores whole model in the specified format. The model is written to <_filePath>.tmp which then
+     * replaces @see _filePath so models which have mapped the old file (@see LoadMapped) can go on using it.
+     * @return true on success
+     */
+    bool save(const char* _filePath, enuFileFormat _format = FormatText);
+
+    /**
+     * @brief checkpoint stores the model incrementally. A checkpoint writes a binary snapshot to @see _basePath
+     * as the base along with an empty journal on <_basePath>.journal when there is no base for this path yet,
+     * the model has been loaded, compacted or decayed by maintenance (@see maintain) since the base has been
+     * written, the journal has grown larger than the base or @see _fold is set. Otherwise just the cells changed
+     * since the previous checkpoint are appended to the journal so cost of a checkpoint depends on the amount of
+     * change instead of the model size. load() replays the journal of a base snapshot and next checkpoints will be appended to it.
+     * It can be called concurrently with learning when Configs::ConcurrentLearning is set. Model is locked just
+     * while the changed cells are copied.
+     * @param _fold fold journal into a fresh base
+     * @return true on success
+     */
+    bool checkpoint(const char* _basePath, bool _fold = false);
+
+    /**
+     * @brief saveAsync same as save but the model is written on a background thread while it can be used.
+     * A point in time copy of the model is taken on the calling thread (holding model lock exclusively on
+     * concurrent learning) which costs a copy of the cells in memory. Formatting and writing the copy is made
+     * on the background thread so the model can learn meanwhile. Saves to the same path must not overlap.
+     * @param _onDone optional callback called on the background thread with the result when the file has been
+     * written. It must not throw.
+     * @return future which will be set to true when the model has been saved successfully
+     */
+    std::future<bool> saveAsync(const char* _filePath,
+                                enuFileFormat _format = FormatText,
+                                std::function<void(bool)> _onDone = std::function<void(bool)>());
+
+    /**
+     * @brief startWAL saves a snapshot of the model to @see _snapshotPath and starts logging inputs of all the
+     * sessions (executeOnce, executeBulk, execute and feedback) to a write ahead log on @see _walPath so learning
+     * made after the snapshot can be restored after a crash by recover(). Logging an input costs a few bytes
+     * appended to a buffer which is written as a single group when it exceeds @see _groupCommitSize or when
+     * commitWAL() is called. Calling startWAL again takes a new snapshot and truncates the log so recovery time is
+     * bounded. Loading a model stops the log. Errors writing the log are thrown as std::logic_error from the call
+     * which has committed it and stop the log.
+     * @param _syncOnCommit sync the snapshot and each committed group to the disk so they survive a system crash
+     * @return true on success
+     */
+    bool startWAL(const char* _snapshotPath,
+                  const char* _walPath,
+                  enuFileFormat _format = FormatBinary,
+                  uint32_t _groupCommitSize = 64 * 1024,
+                  bool _syncOnCommit = false);
+
+    /**
+     * @brief commitWAL writes inputs logged since the last commit to the WAL
+     * @return true on success
+     */
+    bool commitWAL();
+
+    /**
+     * @brief stopWAL commits pending inputs and stops logging
+     * @return true on success
+     */
+    bool stopWAL();
+
+    /**
+     * @brief recover loads a snapshot written by startWAL and replays inputs logged on it's WAL through the bulk
+     * learning loop. Groups which had not been completely written on the crash are ignored. Position of the
+     * default session is restored too while other sessions are replayed just to reproduce the model. Replay
+     * reproduces the model exactly when inputs have been learnt from a single thread without a cell budget
+     * (Configs::MaxCells) as order of concurrent steps and state of the eviction sweep are not logged.
+     * Scheduled maintenance sweeps are repeated by replay so a WAL written by a model with another
+     * Configs::MaintenanceInterval or Configs::MaintenanceDecay is rejected. Recovered model is not logged until
+     * startWAL is called again.
+     * @param _throw if set errors will be thrown as std::exception else they will be reported on stderr
+     * @return true on success
+     */
+    bool recover(const char* _snapshotPath, const char* _walPath, bool _throw = false);
+
+    /**
+     * @brief convert converts a saved model to the specified format
+     * @return true on success
+     */
+    static bool convert(const char* _inFilePath,
+                        const char* _outFilePath,
+                        enuFileFormat _outFormat,
+                        bool _throw = false);
+
+    /**
+     * @brief maxColID returns the greatest ColID which can be learnt by this build of the library
+     * (ASM_COLID_BITS). Greater inputs are rejected with std::logic_error.
+     */
+    static ColID_t maxColID();
+
+    /**
+     * @brief maxPermanence returns the greatest permanence of this build of the library (ASM_PERMANENCE_BITS).
+     * Connections saturate on it and greater Configs or saved permanence values are rejected with
+     * std::logic_error.
+     */
+    static Permanence_t maxPermanence();
+private:
+    enum { BULK_BUFFER_SIZE = 1024 };
+
+    /**
+     * @brief executeBulk executes a buffer of inputs on @see _session or on default session if it is NULL
+     */
+    void executeBulk(Session* _session,
+                     const ColID_t* _inputs,
+                     size_t _count,
+                     enuLearningLevel _learningLevel);
+
+    template <class Generator_t>
+    size_t executeBulk(Session* _session,
+                       Generator_t& _generator,
+                       int64_t _ticks,
+                       enuLearningLevel _learningLevel){
+        ColID_t Buffer[BULK_BUFFER_SIZE];
+        size_t  Total = 0;
+        bool    EndOfData = false;
+        while (EndOfData == false && _ticks != 0){
+            size_t Count = 0;
+            for (; Count < BULK_BUFFER_SIZE && _ticks != 0; ++Count){
+                ColID_t ColID = _generator.Generator_t::next();
+                if (ColID == NOT_ASSIGNED){
+                    EndOfData = true;
+                    break;
+                }
+                Buffer[Count] = ColID;
+                if (_ticks > 0)
+                    _ticks--;
+            }
+            this->executeBulk(_session, &Buffer[0], Count, _learningLevel);
+            Total += Count;
+        }
+        return Total;
+    }
+
 protected:
     clsASMPrivate* pPrivate;
 };
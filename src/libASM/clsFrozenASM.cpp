@@ -0,0 +1,241 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014  S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ */
+
+
+#include <stdexcept>
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <atomic>
+
+#include "clsFrozenASM.h"
+#include "Private/clsFrozenASM_p.h"
+
+namespace AdaptiveSequenceMemorizer{
+
+/// IDs of the compiled models. Zero is kept for cursors which have not been used yet
+static std::atomic<uint64_t> LastFrozenID(0);
+
+/*************************************************************************************************************/
+clsFrozenASM::Cursor::Cursor():
+    pPrivate(new clsSessionPrivate)
+{
+}
+
+/*************************************************************************************************************/
+clsFrozenASM::Cursor::~Cursor()
+{
+    delete this->pPrivate;
+}
+
+/*************************************************************************************************************/
+void clsFrozenASM::Cursor::restart()
+{
+    this->pPrivate->restart();
+    this->pPrivate->PredictedCols.clear();
+}
+
+/*************************************************************************************************************/
+clsASM::PredictionSpan clsFrozenASM::Cursor::predictionSpan() const
+{
+    return this->pPrivate->predictionSpan();
+}
+
+/*************************************************************************************************************/
+clsFrozenASM::clsFrozenASM(uint32_t _maxPredictions):
+    pPrivate(new clsFrozenASMPrivate(_maxPredictions))
+{
+}
+
+/*************************************************************************************************************/
+clsFrozenASM::clsFrozenASM(clsFrozenASMPrivate *_private):
+    pPrivate(_private)
+{
+}
+
+/*************************************************************************************************************/
+clsFrozenASM::~clsFrozenASM()
+{
+}
+
+/*************************************************************************************************************/
+clsASM::PredictionSpan clsFrozenASM::executeOnce(Cursor &_cursor, ColID_t _input) const
+{
+    this->pPrivate->executeStep(*_cursor.pPrivate, _input);
+    _cursor.pPrivate->rankPredictions(this->pPrivate->MaxPredictions);
+    return _cursor.pPrivate->predictionSpan();
+}
+
+/*************************************************************************************************************/
+clsASM::PredictionSpan clsFrozenASM::executeBulk(Cursor &_cursor, const ColID_t *_inputs, size_t _count) const
+{
+    for (size_t i = 0; i < _count; ++i)
+        this->pPrivate->executeStep(*_cursor.pPrivate, _inputs[i]);
+    _cursor.pPrivate->rankPredictions(this->pPrivate->MaxPredictions);
+    return _cursor.pPrivate->predictionSpan();
+}
+
+/*************************************************************************************************************/
+uint64_t clsFrozenASM::cellCount() const
+{
+    return this->pPrivate->Snapshot.isOpen() ? this->pPrivate->Snapshot.header().CellCount : 0;
+}
+
+/*************************************************************************************************************/
+uint64_t clsFrozenASM::connectionCount() const
+{
+    return this->pPrivate->Snapshot.isOpen() ? this->pPrivate->Snapshot.header().SuccessorCount : 0;
+}
+
+/*************************************************************************************************************/
+bool clsFrozenASM::save(const char *_filePath) const
+{
+    //The old file may be mapped by other models so it is replaced instead of being truncated
+    std::string TempPath = std::string(_filePath) + ".tmp";
+    try{
+        if (this->pPrivate->Snapshot.isOpen() == false)
+            throw std::logic_error("Nothing has been frozen to be saved");
+        const stuSnapshotHeader& Header = this->pPrivate->Snapshot.header();
+        std::ofstream File(TempPath.c_str(), std::ios::binary | std::ios::trunc);
+        if (File.is_open() == false)
+            throw std::logic_error(std::string("Unable to open file: ") + TempPath);
+        File.write((const char*)&Header, Header.FileSize);
+        File.close();
+        if (File.fail())
+            throw std::logic_error(std::string("Unable to write snapshot: ") + TempPath);
+        if (std::rename(TempPath.c_str(), _filePath) != 0)
+            throw std::logic_error(std::string("Unable to replace file: ") + _filePath);
+    }catch(std::exception &e){
+        std::remove(TempPath.c_str());
+        std::cerr<<e.what()<<std::endl;
+        return false;
+    }
+    return true;
+}
+
+/*************************************************************************************************************/
+bool clsFrozenASM::load(const char *_filePath, bool _throw)
+{
+    try{
+        std::shared_ptr<clsFrozenASMPrivate> Loaded(new clsFrozenASMPrivate(this->pPrivate->MaxPredictions));
+        Loaded->open(_filePath);
+        this->pPrivate = Loaded;
+    }catch(std::exception &e){
+        if (_throw)
+            throw;
+        std::cerr<<e.what()<<std::endl;
+        return false;
+    }
+    return true;
+}
+
+/*************************************************************************************************************/
+clsFrozenASMPrivate::clsFrozenASMPrivate(uint32_t _maxPredictions)
+{
+    this->ID = ++LastFrozenID;
+    this->MaxPredictions = _maxPredictions;
+    this->MinPermanence2Connect = 0;
+}
+
+/*************************************************************************************************************/
+void clsFrozenASMPrivate::open(std::vector<char> &&_image)
+{
+    this->Snapshot.open(std::move(_image));
+    this->MinPermanence2Connect = this->Snapshot.header().MinPermanence2Connect;
+}
+
+/*************************************************************************************************************/
+void clsFrozenASMPrivate::open(const char *_filePath)
+{
+    this->Snapshot.open(_filePath);
+    this->MinPermanence2Connect = this->Snapshot.header().MinPermanence2Connect;
+}
+
+/*************************************************************************************************************/
+void clsFrozenASMPrivate::executeStep(clsSessionPrivate &_session, ColID_t _input) const
+{
+    if (_session.Generation != this->ID){
+        _session.restart();
+        _session.Generation = this->ID;
+    }
+
+    //On NULL pattern clear all history
+    if (_input == 0)
+        return _session.restart();
+
+    _session.PredictedCols.clear();
+    _session.PathItems++;
+
+    CellIndex_t FirstCell, EndCell;
+    if (this->Snapshot.isOpen() == false || this->Snapshot.columnRange(_input, FirstCell, EndCell) == false)
+        return;
+
+    if (_session.FirstPattern)
+    {
+        for (CellIndex_t CellIndex = FirstCell; CellIndex < EndCell; ++CellIndex)
+            this->setPredictionState(_session, CellIndex);
+
+        _session.LastLearningCell = FirstCell;
+        _session.FirstPattern = false;
+        _session.LastActiveColumn = _input;
+        return;
+    }
+
+    const clsSessionPrivate::stuPredictedCell* Predicted = _session.predictedCell(_input);
+    if (Predicted == NULL)
+        _session.PredictedCells.clear();
+    else
+    {
+        CellIndex_t PredictiveCellIndex = Predicted->Index;
+        _session.LastLearningCell = PredictiveCellIndex;
+        _session.SumPathPermanence += this->Snapshot.cell(PredictiveCellIndex).Permanence;
+        _session.PredictedCells.clear();
+        this->setPredictionState(_session, PredictiveCellIndex);
+    }
+    _session.LastActiveColumn = _input;
+}
+
+/*************************************************************************************************************/
+void clsFrozenASMPrivate::setPredictionState(clsSessionPrivate &_session, CellIndex_t _activeCell) const
+{
+    //Successors are contiguous but their cells are scattered over the model so cells of the next successors
+    //are prefetched while the current one is checked
+    const CellIndex_t* SuccessorsEnd = this->Snapshot.successorsEnd(_activeCell);
+    for (const CellIndex_t* SuccessorIter = this->Snapshot.successorsBegin(_activeCell);
+         SuccessorIter != SuccessorsEnd;
+         ++SuccessorIter)
+    {
+        if (SuccessorsEnd - SuccessorIter > PREFETCH_DISTANCE)
+            __builtin_prefetch(&this->Snapshot.cell(SuccessorIter[PREFETCH_DISTANCE]));
+        const stuSnapshotCell& Successor = this->Snapshot.cell(*SuccessorIter);
+        if (Successor.Permanence >= this->MinPermanence2Connect)
+        {
+            _session.PredictedCells.push_back(clsSessionPrivate::stuPredictedCell(Successor.ColID, *SuccessorIter));
+            _session.addPrediction(clsASM::stuPrediction(
+                                       Successor.ColID,
+                                       (_session.SumPathPermanence + Successor.Permanence) / _session.PathItems),
+                                   this->MaxPredictions);
+        }
+    }
+}
+
+}
@@ -0,0 +1,130 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014  S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ */
+
+
+#ifndef CLSFROZENASM_H
+#define CLSFROZENASM_H
+
+#include <memory>
+#include "clsASM.h"
+
+namespace AdaptiveSequenceMemorizer{
+
+class clsFrozenASMPrivate;
+
+/**
+ * @brief The clsFrozenASM class is an immutable inference engine compiled from a trained model by
+ * clsASM::freeze(). The model is kept in compressed sparse row form: cells of each column are contiguous, each
+ * cell has an offset to a contiguous array of it's successors and connections too weak to be predicted are
+ * dropped. Nothing is written to the engine while predicting so any number of threads can predict on it at the
+ * same time without locking, each one using it's own Cursor. Copies share the same compiled model.
+ * Predictions are the same as LearningFrozen steps on the model which it has been compiled from.
+ */
+class clsFrozenASM
+{
+public:
+    /**
+     * @brief The Cursor class keeps position of a single input stream on the engine. A cursor must be used by
+     * a single thread at a time. It is restarted automatically when it is used on another compiled model.
+     */
+    class Cursor
+    {
+    public:
+        Cursor();
+        ~Cursor();
+
+        /**
+         * @brief restart clears sequence history as if a NULL input has been seen
+         */
+        void restart();
+
+        /**
+         * @brief predictionSpan returns predictions made on the last step of this cursor
+         */
+        clsASM::PredictionSpan predictionSpan() const;
+
+    private:
+        Cursor(const Cursor&);
+        Cursor& operator = (const Cursor&);
+
+    private:
+        clsSessionPrivate* pPrivate;
+        friend class clsFrozenASM;
+    };
+
+public:
+    /**
+     * @brief clsFrozenASM constructs an empty engine which predicts nothing until a model is loaded
+     * @param _maxPredictions bound on predictions of each step. @see clsASM::Configs::MaxPredictions
+     */
+    clsFrozenASM(uint32_t _maxPredictions = 0);
+    ~clsFrozenASM();
+
+    /**
+     * @brief executeOnce executes a single input on @see _cursor. Zero input restarts the sequence.
+     * @return predictions which are valid until the next step of the cursor
+     */
+    clsASM::PredictionSpan executeOnce(Cursor& _cursor, ColID_t _input) const;
+
+    /**
+     * @brief executeBulk executes a buffer of inputs on @see _cursor. Predictions are ranked just once for the
+     * last input.
+     * @return predictions made on the last input
+     */
+    clsASM::PredictionSpan executeBulk(Cursor& _cursor, const ColID_t* _inputs, size_t _count) const;
+
+    /**
+     * @brief cellCount returns number of the cells of the compiled model
+     */
+    uint64_t cellCount() const;
+
+    /**
+     * @brief connectionCount returns number of the connections which can be predicted
+     */
+    uint64_t connectionCount() const;
+
+    /**
+     * @brief save stores the compiled model as a binary snapshot. It can be loaded either by load() or by
+     * clsASM::load() which restores the dropped connections from destinations of the cells.
+     * @return true on success
+     */
+    bool save(const char* _filePath) const;
+
+    /**
+     * @brief load maps a binary snapshot to memory (@see clsASM::LoadMapped) and predicts directly on it.
+     * It must not be called while other threads are predicting on this object. Copies made before the call
+     * keep the previous model.
+     * @param _throw if set errors will be thrown as std::exception else they will be reported on stderr
+     * @return true on success
+     */
+    bool load(const char* _filePath, bool _throw = false);
+
+private:
+    clsFrozenASM(clsFrozenASMPrivate* _private);
+
+private:
+    std::shared_ptr<const clsFrozenASMPrivate> pPrivate;
+    friend class clsASM;
+};
+
+}
+#endif // CLSFROZENASM_H
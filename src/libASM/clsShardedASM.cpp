@@ -0,0 +1,425 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014  S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ */
+
+#include <stdexcept>
+#include <iostream>
+#include <fstream>
+#include <future>
+#include <cstring>
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+#include "clsShardedASM.h"
+#include "Private/clsShardedASM_p.h"
+
+namespace AdaptiveSequenceMemorizer{
+
+static const char* SHARDS_MANIFEST_KEY = "SHARDS:";
+
+/*************************************************************************************************************/
+clsShardedASM::Stream::Stream(clsShardedASM &_owner, PredictionFn_t _onPrediction):
+    pPrivate(new clsShardedStreamPrivate(_owner.shardCount(), _onPrediction))
+{
+}
+
+/*************************************************************************************************************/
+clsShardedASM::Stream::~Stream()
+{
+    this->pPrivate->wait();
+    delete this->pPrivate;
+}
+
+/*************************************************************************************************************/
+void clsShardedASM::Stream::wait()
+{
+    this->pPrivate->wait(true);
+}
+
+/*************************************************************************************************************/
+clsShardedASM::clsShardedASM(uint32_t _shardCount, clsASM::Configs _configs, bool _pinWorkers):
+    pPrivate(new clsShardedASMPrivate(_shardCount, _configs, _pinWorkers))
+{
+}
+
+/*************************************************************************************************************/
+clsShardedASM::~clsShardedASM()
+{
+    delete this->pPrivate;
+}
+
+/*************************************************************************************************************/
+void clsShardedASM::executeOnce(Stream &_stream, ColID_t _input, clsASM::enuLearningLevel _learningLevel)
+{
+    this->pPrivate->executeBulk(*_stream.pPrivate, &_input, 1, _learningLevel);
+}
+
+/*************************************************************************************************************/
+void clsShardedASM::executeBulk(Stream &_stream,
+                                const ColID_t *_inputs,
+                                size_t _count,
+                                clsASM::enuLearningLevel _learningLevel)
+{
+    this->pPrivate->executeBulk(*_stream.pPrivate, _inputs, _count, _learningLevel);
+}
+
+/*************************************************************************************************************/
+void clsShardedASM::flush()
+{
+    clsShardedASMPrivate* Private = this->pPrivate;
+    this->pPrivate->runOnAll([Private](uint32_t _shard, clsASM&){
+        Private->Shards[_shard]->rethrowError();
+    });
+}
+
+/*************************************************************************************************************/
+uint32_t clsShardedASM::shardCount() const
+{
+    return (uint32_t)this->pPrivate->Shards.size();
+}
+
+/*************************************************************************************************************/
+uint32_t clsShardedASM::shardOf(ColID_t _colID) const
+{
+    return this->pPrivate->shardOf(_colID);
+}
+
+/*************************************************************************************************************/
+clsASM::Stats clsShardedASM::stats(uint32_t _shard)
+{
+    if (_shard >= this->pPrivate->Shards.size())
+        throw std::logic_error("Invalid shard number");
+    std::promise<clsASM::Stats> Promise;
+    std::future<clsASM::Stats> Result = Promise.get_future();
+    this->pPrivate->Shards[_shard]->run([&Promise](clsASM& _asm){
+        Promise.set_value(_asm.stats());
+    });
+    return Result.get();
+}
+
+/*************************************************************************************************************/
+bool clsShardedASM::save(const char *_filePath, clsASM::enuFileFormat _format)
+{
+    return this->pPrivate->save(_filePath, _format);
+}
+
+/*************************************************************************************************************/
+bool clsShardedASM::load(const char *_filePath, bool _throw)
+{
+    return this->pPrivate->load(_filePath, _throw);
+}
+
+/*************************************************************************************************************/
+clsShardedASMPrivate::clsShardedASMPrivate(uint32_t _shardCount, clsASM::Configs _configs, bool _pinWorkers) :
+    LoadGeneration(0)
+{
+    if (_shardCount == 0)
+        _shardCount = std::max(1U, std::thread::hardware_concurrency());
+    //Each shard is used just by it's own worker
+    _configs.ConcurrentLearning = false;
+    for (uint32_t i = 0; i < _shardCount; ++i)
+        this->Shards.emplace_back(new clsShard(i, _configs));
+    for (auto& Shard : this->Shards)
+        Shard->start(_pinWorkers);
+}
+
+/*************************************************************************************************************/
+clsShardedASMPrivate::~clsShardedASMPrivate()
+{
+    for (auto& Shard : this->Shards)
+        Shard->stop();
+}
+
+/*************************************************************************************************************/
+void clsShardedASMPrivate::executeBulk(clsShardedStreamPrivate &_stream,
+                                       const ColID_t *_inputs,
+                                       size_t _count,
+                                       clsASM::enuLearningLevel _learningLevel)
+{
+    uint64_t Generation = this->LoadGeneration.load(std::memory_order_acquire);
+    if (_stream.LoadGeneration != Generation){
+        _stream.LoadGeneration = Generation;
+        _stream.CurrentShard = NO_SHARD;
+    }
+
+    //Each sequence is queued to it's shard along with the reset which ends it. Resets between sequences are
+    //dropped as sessions of the other shards are already at the start of a sequence.
+    size_t Start = 0;
+    for (size_t i = 0; i < _count; ++i){
+        if (_stream.CurrentShard == NO_SHARD){
+            if (_inputs[i] == 0)
+                continue;
+            _stream.CurrentShard = this->shardOf(_inputs[i]);
+            Start = i;
+            //Callbacks are kept in order by waiting for inputs queued on the previous shard
+            if (_stream.OnPrediction && _stream.CurrentShard != _stream.LastShard){
+                _stream.wait();
+                _stream.LastShard = _stream.CurrentShard;
+            }
+        }else if (_inputs[i] == 0){
+            this->Shards[_stream.CurrentShard]->enqueue(&_stream, _learningLevel, _inputs + Start, i + 1 - Start);
+            _stream.CurrentShard = NO_SHARD;
+        }
+    }
+    if (_stream.CurrentShard != NO_SHARD)
+        this->Shards[_stream.CurrentShard]->enqueue(&_stream, _learningLevel, _inputs + Start, _count - Start);
+}
+
+/*************************************************************************************************************/
+void clsShardedASMPrivate::runOnAll(const std::function<void (uint32_t, clsASM &)> &_task)
+{
+    std::vector<std::promise<void>> Promises(this->Shards.size());
+    for (uint32_t i = 0; i < this->Shards.size(); ++i)
+        this->Shards[i]->run([&_task, &Promises, i](clsASM& _asm){
+            try{
+                _task(i, _asm);
+                Promises[i].set_value();
+            }catch(...){
+                Promises[i].set_exception(std::current_exception());
+            }
+        });
+
+    //All of the shards are waited before reporting the first error
+    std::exception_ptr Error;
+    for (auto& Promise : Promises)
+        try{
+            Promise.get_future().get();
+        }catch(...){
+            if (Error == nullptr)
+                Error = std::current_exception();
+        }
+    if (Error)
+        std::rethrow_exception(Error);
+}
+
+/*************************************************************************************************************/
+bool clsShardedASMPrivate::save(const char *_filePath, clsASM::enuFileFormat _format)
+{
+    try{
+        this->runOnAll([_filePath, _format](uint32_t _shard, clsASM& _asm){
+            if (_asm.save(shardPath(_filePath, _shard).c_str(), _format) == false)
+                throw std::logic_error("Unable to save shard: " + shardPath(_filePath, _shard));
+        });
+
+        //Manifest is written last so a failed save does not leave a manifest of partial shards
+        std::ofstream File(_filePath, std::ios::trunc);
+        if (File.is_open() == false)
+            throw std::logic_error(std::string("Unable to open file: ") + _filePath);
+        File<<SHARDS_MANIFEST_KEY<<this->Shards.size()<<std::endl;
+        if (File.fail())
+            throw std::logic_error(std::string("Unable to write file: ") + _filePath);
+    }catch(std::exception &e){
+        std::cerr<<e.what()<<std::endl;
+        return false;
+    }
+    return true;
+}
+
+/*************************************************************************************************************/
+bool clsShardedASMPrivate::load(const char *_filePath, bool _throw)
+{
+    try{
+        std::ifstream File(_filePath);
+        if (File.is_open() == false)
+            throw std::logic_error(std::string("Unable to open file: ") + _filePath);
+        std::string Line;
+        std::getline(File, Line);
+        if (Line.compare(0, strlen(SHARDS_MANIFEST_KEY), SHARDS_MANIFEST_KEY) != 0)
+            throw std::logic_error(std::string("Invalid sharded model manifest: ") + _filePath);
+        if (std::stoul(Line.substr(strlen(SHARDS_MANIFEST_KEY))) != this->Shards.size())
+            throw std::logic_error("Sharded model has been saved by " + Line.substr(strlen(SHARDS_MANIFEST_KEY)) +
+                                   " shards instead of " + std::to_string(this->Shards.size()));
+
+        this->runOnAll([_filePath](uint32_t _shard, clsASM& _asm){
+            _asm.load(shardPath(_filePath, _shard).c_str(), true);
+        });
+        this->LoadGeneration.fetch_add(1, std::memory_order_release);
+    }catch(std::exception &e){
+        //Sequences of the streams are restarted as shards may have been loaded partially
+        this->LoadGeneration.fetch_add(1, std::memory_order_release);
+        if (_throw)
+            throw;
+        else{
+            std::cerr<<e.what()<<std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/*************************************************************************************************************/
+std::string clsShardedASMPrivate::shardPath(const char *_filePath, uint32_t _shard)
+{
+    return std::string(_filePath) + "." + std::to_string(_shard);
+}
+
+/*************************************************************************************************************/
+clsShard::clsShard(uint32_t _index, const clsASM::Configs &_configs) :
+    Index(_index),
+    ASM(_configs),
+    Stopping(false)
+{
+}
+
+/*************************************************************************************************************/
+clsShard::~clsShard()
+{
+    this->stop();
+}
+
+/*************************************************************************************************************/
+void clsShard::start(bool _pin)
+{
+    this->Worker = std::thread(&clsShard::work, this);
+#ifdef __linux__
+    if (_pin){
+        cpu_set_t CPUSet;
+        CPU_ZERO(&CPUSet);
+        CPU_SET(this->Index % std::max(1U, std::thread::hardware_concurrency()), &CPUSet);
+        //Pinning is just a hint so workers keep running unpinned when it is not permitted
+        pthread_setaffinity_np(this->Worker.native_handle(), sizeof(CPUSet), &CPUSet);
+    }
+#else
+    (void)_pin;
+#endif
+}
+
+/*************************************************************************************************************/
+void clsShard::stop()
+{
+    if (this->Worker.joinable() == false)
+        return;
+    {
+        std::lock_guard<std::mutex> Lock(this->QueueLock);
+        this->Stopping = true;
+    }
+    this->NotEmpty.notify_one();
+    this->Worker.join();
+}
+
+/*************************************************************************************************************/
+void clsShard::enqueue(clsShardedStreamPrivate *_stream,
+                       clsASM::enuLearningLevel _learningLevel,
+                       const ColID_t *_inputs,
+                       size_t _count)
+{
+    _stream->Pending.fetch_add(_count, std::memory_order_relaxed);
+    while (_count){
+        std::unique_lock<std::mutex> Lock(this->QueueLock);
+        this->NotFull.wait(Lock, [this](){ return this->Inputs.size() < MAX_QUEUED_INPUTS; });
+        size_t Count = std::min(_count, MAX_QUEUED_INPUTS - this->Inputs.size());
+        bool WasEmpty = this->Batches.empty();
+        if (WasEmpty == false &&
+            this->Batches.back().Stream == _stream &&
+            this->Batches.back().LearningLevel == (uint32_t)_learningLevel)
+            this->Batches.back().Count += Count;
+        else
+            this->Batches.push_back({_stream, (uint32_t)_learningLevel, Count});
+        this->Inputs.insert(this->Inputs.end(), _inputs, _inputs + Count);
+        Lock.unlock();
+        if (WasEmpty)
+            this->NotEmpty.notify_one();
+        _inputs += Count;
+        _count -= Count;
+    }
+}
+
+/*************************************************************************************************************/
+void clsShard::run(Task_t _task)
+{
+    {
+        std::lock_guard<std::mutex> Lock(this->QueueLock);
+        this->Tasks.push_back(std::move(_task));
+        this->Batches.push_back({NULL, 0, 0});
+    }
+    this->NotEmpty.notify_one();
+}
+
+/*************************************************************************************************************/
+void clsShard::rethrowError()
+{
+    std::exception_ptr Error = nullptr;
+    std::swap(Error, this->Error);
+    if (Error)
+        std::rethrow_exception(Error);
+}
+
+/*************************************************************************************************************/
+void clsShard::work()
+{
+    std::vector<stuBatch> Batches;
+    std::vector<ColID_t>  Inputs;
+    std::deque<Task_t>    Tasks;
+    for(;;){
+        {
+            std::unique_lock<std::mutex> Lock(this->QueueLock);
+            this->NotEmpty.wait(Lock, [this](){ return this->Batches.size() || this->Stopping; });
+            if (this->Batches.empty())
+                return;
+            //Whole queue is taken at once so producers are blocked just while swapping buffers
+            Batches.swap(this->Batches);
+            Inputs.swap(this->Inputs);
+            Tasks.swap(this->Tasks);
+        }
+        this->NotFull.notify_all();
+
+        const ColID_t* Input = Inputs.data();
+        for (const stuBatch& Batch : Batches){
+            if (Batch.Stream == NULL){
+                Tasks.front()(this->ASM);
+                Tasks.pop_front();
+                continue;
+            }
+            //Errors are reported by the stream and flush() so the worker goes on with the next batches
+            try{
+                this->execute(Batch, Input);
+            }catch(...){
+                if (this->Error == nullptr)
+                    this->Error = std::current_exception();
+                Batch.Stream->fail(std::current_exception());
+                //Rest of the failed batch is dropped so the session is restarted
+                Batch.Stream->Sessions[this->Index].reset(new clsASM::Session);
+            }
+            Input += Batch.Count;
+            Batch.Stream->done(Batch.Count);
+        }
+        Batches.clear();
+        Inputs.clear();
+    }
+}
+
+/*************************************************************************************************************/
+void clsShard::execute(const stuBatch &_batch, const ColID_t *_inputs)
+{
+    clsASM::Session& Session = *_batch.Stream->Sessions[this->Index];
+    clsASM::enuLearningLevel LearningLevel = (clsASM::enuLearningLevel)_batch.LearningLevel;
+    if (_batch.Stream->OnPrediction){
+        for (size_t i = 0; i < _batch.Count; ++i){
+            this->ASM.executeOnce(Session, _inputs[i], NULL, 0, LearningLevel);
+            if (_inputs[i])
+                _batch.Stream->OnPrediction(_inputs[i], Session.predictionSpan());
+        }
+    }else
+        this->ASM.executeBulk(Session, _inputs, _batch.Count, LearningLevel);
+}
+
+}
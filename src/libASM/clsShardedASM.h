@@ -0,0 +1,168 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014  S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.M.Mohammadzadeh <mehran.m@aut.ac.ir>
+ */
+
+#ifndef CLSSHARDEDASM_H
+#define CLSSHARDEDASM_H
+
+#include "clsASM.h"
+
+namespace AdaptiveSequenceMemorizer{
+
+class clsShardedASMPrivate;
+class clsShardedStreamPrivate;
+
+/**
+ * @brief The clsShardedASM class spreads learning and prediction over several independent models (shards).
+ * Each shard is owned by a worker thread which is the only one using it, so shards learn in parallel without
+ * any locking on the model. Sequences are routed to a shard chosen by their first column: after each reset
+ * (NULL input) next input of a stream selects the shard which receives the rest of the sequence. Sequences
+ * sharing their first column are learnt by the same shard but each shard knows just the sequences routed to
+ * it, so the first input of a sequence predicts what has followed that column on the sequences of it's shard
+ * while a single model would predict what has followed it on any sequence.
+ * Inputs are queued to the shards and executed asynchronously. Predictions are delivered to the stream
+ * callback on the worker thread of the shard.
+ */
+class clsShardedASM
+{
+public:
+    /**
+     * @brief PredictionFn_t receives each input of a stream along with predictions made on it. It is called on
+     * the worker thread of the shard, predictions are valid just during the call and it must not block on
+     * inputs of the same sharded model. Errors thrown by it fail the batch as other errors of the stream do. Callbacks of a stream are called one at a time in order of the
+     * inputs: a sequence routed to another shard is queued after the previous one has been executed, so streams
+     * having a callback are executed on a single shard at a time.
+     */
+    typedef std::function<void(ColID_t _input, const clsASM::PredictionSpan& _predictions)> PredictionFn_t;
+
+    /**
+     * @brief The Stream class keeps position of an independent input stream on all of the shards. Inputs of a
+     * stream must be executed from a single thread at a time. Destroying a stream waits for it's queued inputs.
+     * When executing inputs of a stream fails on a shard, the rest of the inputs taken by the shard with them is
+     * dropped and the session of the stream on that shard is restarted. The error is kept on the stream and the
+     * shard goes on with the next inputs.
+     */
+    class Stream
+    {
+    public:
+        /**
+         * @brief Stream constructor
+         * @param _onPrediction optional callback receiving predictions made on each non NULL input
+         */
+        Stream(clsShardedASM& _owner, PredictionFn_t _onPrediction = PredictionFn_t());
+        ~Stream();
+
+        /**
+         * @brief wait blocks until inputs queued on this stream have been executed and rethrows the first error
+         * of the inputs executed since the previous call
+         */
+        void wait();
+
+    private:
+        Stream(const Stream&);
+        Stream& operator = (const Stream&);
+
+    private:
+        clsShardedStreamPrivate* pPrivate;
+        friend class clsShardedASM;
+    };
+
+public:
+    /**
+     * @brief clsShardedASM constructor starts a worker thread for each shard
+     * @param _shardCount number of shards. Zero uses number of hardware threads.
+     * @param _configs configuration of all the shards. Concurrent learning is disabled as each shard is
+     * used just by it's own worker.
+     * @param _pinWorkers bind worker of each shard to a single CPU (where supported)
+     */
+    clsShardedASM(uint32_t _shardCount = 0,
+                  clsASM::Configs _configs = clsASM::Configs(),
+                  bool _pinWorkers = false);
+
+    /**
+     * @brief ~clsShardedASM executes queued inputs and stops workers
+     */
+    ~clsShardedASM();
+
+    /**
+     * @brief executeOnce queues an input of @see _stream to the shard of it's sequence
+     */
+    void executeOnce(Stream& _stream,
+                     ColID_t _input,
+                     clsASM::enuLearningLevel _learningLevel = clsASM::LearningFull);
+
+    /**
+     * @brief executeBulk queues a buffer of inputs of @see _stream. Consecutive inputs of the same sequence are
+     * queued together and executed by the bulk learning loop of the shard when the stream has no callback.
+     */
+    void executeBulk(Stream& _stream,
+                     const ColID_t* _inputs,
+                     size_t _count,
+                     clsASM::enuLearningLevel _learningLevel = clsASM::LearningFull);
+
+    /**
+     * @brief flush blocks until inputs queued before the call on all the streams have been executed and
+     * rethrows the first error of the inputs executed by any of the shards since the previous flush
+     */
+    void flush();
+
+    /**
+     * @brief shardCount returns number of the shards
+     */
+    uint32_t shardCount() const;
+
+    /**
+     * @brief shardOf returns shard which learns sequences starting with @see _colID
+     */
+    uint32_t shardOf(ColID_t _colID) const;
+
+    /**
+     * @brief stats returns counters of a shard. It is executed on the worker of the shard after inputs queued
+     * before the call.
+     */
+    clsASM::Stats stats(uint32_t _shard);
+
+    /**
+     * @brief save stores all the shards in parallel. A manifest is written on @see _filePath and each shard on
+     * <_filePath>.<ShardNumber>. Inputs queued before the call are saved.
+     * @return true on success
+     */
+    bool save(const char* _filePath, clsASM::enuFileFormat _format = clsASM::FormatBinary);
+
+    /**
+     * @brief load loads shards saved by save() in parallel. Number of shards must be the same as the saved one
+     * as sequences are routed by it. Positions of all the streams are reset.
+     * @param _throw if set errors will be thrown as std::exception else they will be reported on stderr
+     * @return true on success
+     */
+    bool load(const char* _filePath, bool _throw = false);
+
+private:
+    clsShardedASM(const clsShardedASM&);
+    clsShardedASM& operator = (const clsShardedASM&);
+
+private:
+    clsShardedASMPrivate* pPrivate;
+    friend class Stream;
+};
+
+}
+#endif // CLSSHARDEDASM_H
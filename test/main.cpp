@@ -58,6 +58,8 @@ int main()
     ASM.save("asm.txt");
     ASM.load("asm.txt");
     ASM.save("asm2.txt");
+    ASM.save("asm.bin", clsASM::FormatBinary);
+    ASM.load("asm.bin", false, clsASM::LoadMapped);
 
     printPrediction(0, false);
 //    printPrediction(1, false);
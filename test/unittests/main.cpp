@@ -0,0 +1,51 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014  S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ */
+
+#include <iostream>
+#include <cstring>
+#include "testing.h"
+
+using namespace AdaptiveSequenceMemorizer::Testing;
+
+/**
+ * Runs all the registered test cases or just the ones named on the command line
+ * @return number of failed test cases
+ */
+int main(int _argc, char** _argv)
+{
+    int Failed = 0;
+    for (const stuTestCase& Case : testCases()){
+        bool Selected = _argc == 1;
+        for (int i = 1; i < _argc; ++i)
+            Selected |= strcmp(_argv[i], Case.Name) == 0;
+        if (Selected == false)
+            continue;
+        try{
+            Case.Fn();
+            std::cout<<"[PASSED] "<<Case.Name<<std::endl;
+        }catch(std::exception& e){
+            std::cout<<"[FAILED] "<<Case.Name<<": "<<e.what()<<std::endl;
+            Failed++;
+        }
+    }
+    return Failed;
+}
@@ -0,0 +1,148 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014  S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ */
+
+#ifndef TESTING_H
+#define TESTING_H
+
+#include <string>
+#include <vector>
+#include <random>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include "clsASM.h"
+
+namespace AdaptiveSequenceMemorizer{
+namespace Testing{
+
+typedef void (*TestFn_t)();
+
+struct stuTestCase{
+    const char* Name;
+    TestFn_t    Fn;
+};
+
+inline std::vector<stuTestCase>& testCases(){
+    static std::vector<stuTestCase> Cases;
+    return Cases;
+}
+
+struct stuTestRegistrar{
+    stuTestRegistrar(const char* _name, TestFn_t _fn){
+        testCases().push_back(stuTestCase{_name, _fn});
+    }
+};
+
+/**
+ * @brief ASM_TEST defines a test case which is registered to be run by the unittests runner
+ */
+#define ASM_TEST(_name) \
+    static void _name(); \
+    static AdaptiveSequenceMemorizer::Testing::stuTestRegistrar _name##Registrar(#_name, _name); \
+    static void _name()
+
+/**
+ * @brief ASM_CHECK fails current test case when _cond does not hold
+ */
+#define ASM_CHECK(_cond) \
+    if ((_cond) == false) \
+        throw std::logic_error(std::string(__FILE__) + ":" + std::to_string(__LINE__) + ": " + #_cond)
+
+typedef std::vector<std::pair<ColID_t, Permanence_t>> Trace_t;
+
+/**
+ * @brief patternSequences generates NULL separated repetitions of random patterns. It is deterministic so
+ * models trained on it can be compared between runs.
+ */
+inline std::vector<ColID_t> patternSequences(size_t _count,
+                                             uint32_t _alphabet = 100,
+                                             uint32_t _patterns = 20,
+                                             uint32_t _seed = 7){
+    std::mt19937 Random(_seed);
+    std::vector<std::vector<ColID_t>> Patterns(_patterns);
+    for (auto& Pattern : Patterns)
+        for (int i = 0; i < 8; ++i)
+            Pattern.push_back(1 + Random() % _alphabet);
+
+    std::vector<ColID_t> Sequence;
+    while (Sequence.size() < _count){
+        const std::vector<ColID_t>& Pattern = Patterns[Random() % Patterns.size()];
+        Sequence.push_back(0);
+        for (ColID_t ColID : Pattern)
+            Sequence.push_back(Random() % 8 ? ColID : 1 + Random() % _alphabet);
+    }
+    return Sequence;
+}
+
+/**
+ * @brief learn shows inputs to the model one by one
+ */
+inline void learn(clsASM& _asm, const std::vector<ColID_t>& _inputs, size_t _first = 0, size_t _count = SIZE_MAX){
+    for (size_t i = _first; i < _inputs.size() && i - _first < _count; ++i)
+        _asm.executeOnce(_inputs[i]);
+}
+
+/**
+ * @brief scaled scales permanence values of the tests down on builds which can not store the default configs
+ * (ASM_PERMANENCE_BITS=8)
+ */
+inline Permanence_t scaled(Permanence_t _permanence){
+    return clsASM::maxPermanence() < 500 ? _permanence / 5 : _permanence;
+}
+
+/**
+ * @brief testConfigs returns the default configs scaled to fit this build
+ */
+inline clsASM::Configs testConfigs(uint32_t _maxCells = 0, uint32_t _maxPredictions = 0){
+    return clsASM::Configs(scaled(500), scaled(300), scaled(50), 1, false, false, _maxCells, _maxPredictions);
+}
+
+/**
+ * @brief trace executes inputs as LearningFrozen steps and collects all the predictions
+ */
+inline Trace_t trace(clsASM& _asm, const std::vector<ColID_t>& _inputs){
+    Trace_t Trace;
+    for (ColID_t Input : _inputs){
+        for (const clsASM::stuPrediction& Prediction : _asm.executeOnce(Input, clsASM::LearningFrozen))
+            Trace.push_back(std::make_pair(Prediction.ColID, Prediction.PathPermanence));
+        Trace.push_back(std::make_pair(NOT_ASSIGNED, (Permanence_t)0));
+    }
+    return Trace;
+}
+
+/**
+ * @brief unordered sorts predictions of each step. Models rebuilt from text files or by merge keep successors
+ * ordered by column instead of by learning time so just the set of predictions of each step is the same.
+ */
+inline Trace_t unordered(Trace_t _trace){
+    auto StepBegin = _trace.begin();
+    for (auto Iter = _trace.begin(); Iter != _trace.end(); ++Iter)
+        if (Iter->first == NOT_ASSIGNED){
+            std::sort(StepBegin, Iter);
+            StepBegin = Iter + 1;
+        }
+    return _trace;
+}
+
+}
+}
+#endif // TESTING_H
@@ -0,0 +1,89 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014  S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "testing.h"
+
+using namespace AdaptiveSequenceMemorizer;
+using namespace AdaptiveSequenceMemorizer::Testing;
+
+//Global allocations of the test binary and the library are counted so steps can be checked to not allocate
+static std::atomic<size_t> gAllocations(0);
+
+void* operator new(size_t _size){
+    gAllocations++;
+    void* Block = std::malloc(_size ? _size : 1);
+    if (Block == NULL)
+        throw std::bad_alloc();
+    return Block;
+}
+
+void operator delete(void* _block) noexcept {
+    std::free(_block);
+}
+
+void operator delete(void* _block, size_t) noexcept {
+    std::free(_block);
+}
+
+/**
+ * @brief inferSpan runs inputs as LearningFrozen steps reading predictions in place and sums their columns
+ */
+static size_t inferSpan(clsASM& _asm, clsASM::Session& _session, const std::vector<ColID_t>& _inputs){
+    size_t Sum = 0;
+    for (ColID_t Input : _inputs){
+        _asm.executeOnce(_session, Input, NULL, 0, clsASM::LearningFrozen);
+        for (const clsASM::stuPrediction& Prediction : _session.predictionSpan())
+            Sum += Prediction.ColID;
+    }
+    return Sum;
+}
+
+/*************************************************************************************************************/
+ASM_TEST(predictionSpanDoesNotAllocateOnceWarm)
+{
+    std::vector<ColID_t> Inputs = patternSequences(20000);
+    std::vector<ColID_t> Probe = patternSequences(3000, 100, 20, 11);
+    clsASM ASM(testConfigs());
+    learn(ASM, Inputs);
+
+    //Buffers of a new session grow on the first steps
+    clsASM::Session Session;
+    size_t Before = gAllocations;
+    size_t Expected = inferSpan(ASM, Session, Probe);
+    ASM_CHECK(Expected > 0);
+    ASM_CHECK(gAllocations > Before);
+
+    Before = gAllocations;
+    ASM_CHECK(inferSpan(ASM, Session, Probe) == Expected);
+    ASM_CHECK(gAllocations == Before);
+
+    //Copying to a caller provided buffer does not allocate either
+    std::vector<clsASM::stuPrediction> Output(1024);
+    Before = gAllocations;
+    for (ColID_t Input : Probe)
+        ASM_CHECK(ASM.executeOnce(Session, Input, Output.data(), Output.size(), clsASM::LearningFrozen) <=
+                  Output.size());
+    ASM_CHECK(gAllocations == Before);
+}
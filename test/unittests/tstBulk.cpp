@@ -0,0 +1,86 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014  S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ */
+
+#include "testing.h"
+
+using namespace AdaptiveSequenceMemorizer;
+using namespace AdaptiveSequenceMemorizer::Testing;
+
+/**
+ * @brief The clsVectorGenerator class generates inputs of a vector then NOT_ASSIGNED
+ */
+class clsVectorGenerator : public intfInputIterator
+{
+public:
+    clsVectorGenerator(const std::vector<ColID_t>& _inputs) :
+        Inputs(_inputs){
+        this->Position = 0;
+    }
+
+    ColID_t next(){
+        return this->Position < this->Inputs.size() ? this->Inputs[this->Position++] : NOT_ASSIGNED;
+    }
+
+private:
+    const std::vector<ColID_t>& Inputs;
+    size_t Position;
+};
+
+static std::vector<ColID_t> lastPredictions(const clsASM::PredictionSpan& _span){
+    std::vector<ColID_t> ColIDs;
+    for (const clsASM::stuPrediction& Prediction : _span)
+        ColIDs.push_back(Prediction.ColID);
+    return ColIDs;
+}
+
+/*************************************************************************************************************/
+ASM_TEST(executeBulkMatchesExecuteOnce)
+{
+    std::vector<ColID_t> Inputs = patternSequences(20000);
+    std::vector<ColID_t> Probe = patternSequences(3000, 100, 20, 11);
+    clsASM Stepped(testConfigs());
+    learn(Stepped, Inputs);
+    Trace_t Expected = trace(Stepped, Probe);
+    ASM_CHECK(Expected.size() > Probe.size());
+
+    clsASM FromBuffer(testConfigs());
+    FromBuffer.executeBulk(Inputs.data(), Inputs.size());
+    ASM_CHECK(lastPredictions(FromBuffer.predictionSpan()) == lastPredictions(Stepped.predictionSpan()));
+    ASM_CHECK(trace(FromBuffer, Probe) == Expected);
+
+    clsASM FromGenerator(testConfigs());
+    clsVectorGenerator Generator(Inputs);
+    ASM_CHECK(FromGenerator.executeBulk(Generator) == Inputs.size());
+    ASM_CHECK(lastPredictions(FromGenerator.predictionSpan()) == lastPredictions(Stepped.predictionSpan()));
+    ASM_CHECK(trace(FromGenerator, Probe) == Expected);
+
+    //Limited reads continue the sequence on the next call, also across internal buffer boundaries
+    clsASM InChunks(testConfigs());
+    clsASM::Session Session;
+    clsVectorGenerator ChunkGenerator(Inputs);
+    ASM_CHECK(InChunks.executeBulk(Session, ChunkGenerator, 1500) == 1500);
+    ASM_CHECK(InChunks.executeBulk(Session, ChunkGenerator, 7) == 7);
+    ASM_CHECK(InChunks.executeBulk(Session, ChunkGenerator) == Inputs.size() - 1507);
+    ASM_CHECK(InChunks.executeBulk(Session, ChunkGenerator) == 0);
+    ASM_CHECK(lastPredictions(Session.predictionSpan()) == lastPredictions(Stepped.predictionSpan()));
+    ASM_CHECK(trace(InChunks, Probe) == Expected);
+}
@@ -0,0 +1,55 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014  S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ */
+
+#include "testing.h"
+
+using namespace AdaptiveSequenceMemorizer;
+using namespace AdaptiveSequenceMemorizer::Testing;
+
+/*************************************************************************************************************/
+ASM_TEST(sparseAndDenseColumnsMatch)
+{
+    //Wide alphabet so most of the dense slots stay empty
+    ColID_t Alphabet = std::min((ColID_t)50000, clsASM::maxColID());
+    std::vector<ColID_t> Inputs = patternSequences(20000, Alphabet);
+    std::vector<ColID_t> Probe = patternSequences(3000, Alphabet, 20, 11);
+    clsASM::Configs SparseConfigs = testConfigs();
+    SparseConfigs.SparseColumns = true;
+    clsASM Dense(testConfigs());
+    clsASM Sparse(SparseConfigs);
+    learn(Dense, Inputs);
+    learn(Sparse, Inputs);
+
+    Trace_t Expected = trace(Dense, Probe);
+    ASM_CHECK(Expected.size() > Probe.size());
+    ASM_CHECK(trace(Sparse, Probe) == Expected);
+
+    //Both modes save the same model
+    ASM_CHECK(Dense.save("ut_dense.bin", clsASM::FormatBinary));
+    ASM_CHECK(Sparse.save("ut_sparse.bin", clsASM::FormatBinary));
+    clsASM FromDense(SparseConfigs);
+    ASM_CHECK(FromDense.load("ut_dense.bin", true));
+    ASM_CHECK(trace(FromDense, Probe) == Expected);
+    clsASM FromSparse(testConfigs());
+    ASM_CHECK(FromSparse.load("ut_sparse.bin", true));
+    ASM_CHECK(trace(FromSparse, Probe) == Expected);
+}
@@ -0,0 +1,85 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014  S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ */
+
+#include <thread>
+#include "testing.h"
+
+using namespace AdaptiveSequenceMemorizer;
+using namespace AdaptiveSequenceMemorizer::Testing;
+
+/**
+ * @brief hits counts steps of _inputs whose input was predicted by the previous step of a new session
+ */
+static size_t hits(clsASM& _asm, const std::vector<ColID_t>& _inputs){
+    clsASM::Session Session;
+    size_t Hits = 0;
+    const clsASM::Prediction_t* Last = NULL;
+    for (ColID_t Input : _inputs){
+        if (Last && Input)
+            for (const clsASM::stuPrediction& Prediction : *Last)
+                if (Prediction.ColID == Input){
+                    ++Hits;
+                    break;
+                }
+        Last = &_asm.executeOnce(Session, Input, clsASM::LearningFrozen);
+    }
+    return Hits;
+}
+
+/*************************************************************************************************************/
+ASM_TEST(concurrentSessionsLearnSharedModel)
+{
+    const size_t Threads = 4;
+    std::vector<std::vector<ColID_t>> Inputs;
+    for (size_t i = 0; i < Threads; ++i)
+        Inputs.push_back(patternSequences(20000, 100, 20, 7 + i));
+
+    clsASM::Configs Configs = testConfigs();
+    Configs.ConcurrentLearning = true;
+    clsASM Shared(Configs);
+    std::vector<std::thread> Workers;
+    for (size_t i = 0; i < Threads; ++i)
+        Workers.push_back(std::thread([&Shared, &Inputs, i](){
+            clsASM::Session Session;
+            for (ColID_t Input : Inputs[i])
+                Shared.executeOnce(Session, Input);
+        }));
+    for (std::thread& Worker : Workers)
+        Worker.join();
+
+    //Each stream is predicted about as well as by a model which learnt it alone. Streams interleave differently
+    //on each run and permanences saturate sooner on narrow builds (ASM_PERMANENCE_BITS=8) so some margin is left
+    for (size_t i = 0; i < Threads; ++i){
+        clsASM Alone(testConfigs());
+        learn(Alone, Inputs[i]);
+        size_t Expected = hits(Alone, Inputs[i]);
+        ASM_CHECK(Expected > Inputs[i].size() / 3);
+        ASM_CHECK(hits(Shared, Inputs[i]) * 5 >= Expected * 4);
+    }
+
+    //Model is consistent enough to be saved and loaded back
+    std::vector<ColID_t> Probe = patternSequences(3000, 100, 20, 11);
+    ASM_CHECK(Shared.save("ut_concurrent.bin", clsASM::FormatBinary));
+    clsASM Loaded(testConfigs());
+    ASM_CHECK(Loaded.load("ut_concurrent.bin", true));
+    ASM_CHECK(trace(Loaded, Probe) == trace(Shared, Probe));
+}
@@ -0,0 +1,81 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014  S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ */
+
+#include "clsFrozenASM.h"
+#include "testing.h"
+
+using namespace AdaptiveSequenceMemorizer;
+using namespace AdaptiveSequenceMemorizer::Testing;
+
+/*************************************************************************************************************/
+ASM_TEST(freezeMatchesFrozenSteps)
+{
+    std::vector<ColID_t> Inputs = patternSequences(20000);
+    std::vector<ColID_t> Probe = patternSequences(3000, 100, 20, 11);
+    for (uint32_t MaxPredictions : {0, 3}){
+        clsASM::Configs Configs = testConfigs(0, MaxPredictions);
+        clsASM Live(Configs);
+        Live.executeBulk(Inputs.data(), Inputs.size());
+        //Some connections are decayed below MinPermanence2Connect so they are dropped by freeze
+        Live.maintain(scaled(220));
+        Trace_t Expected = trace(Live, Probe);
+
+        clsFrozenASM Frozen = Live.freeze();
+        ASM_CHECK(Frozen.cellCount() == Live.stats().Cells);
+        clsFrozenASM::Cursor Cursor;
+        Trace_t Actual;
+        for (ColID_t Input : Probe){
+            for (const clsASM::stuPrediction& Prediction : Frozen.executeOnce(Cursor, Input))
+                Actual.push_back(std::make_pair(Prediction.ColID, Prediction.PathPermanence));
+            Actual.push_back(std::make_pair(NOT_ASSIGNED, (Permanence_t)0));
+        }
+        ASM_CHECK(Actual == Expected);
+
+        //A model loaded from the frozen image restores the dropped connections
+        ASM_CHECK(Frozen.save("ut_frozen.bin"));
+        clsASM Thawed(Configs);
+        ASM_CHECK(Thawed.load("ut_frozen.bin", true));
+        ASM_CHECK(Live.save("ut_frozen_live.txt"));
+        ASM_CHECK(Thawed.save("ut_frozen_thawed.txt"));
+        clsASM LiveText(Configs), ThawedText(Configs);
+        ASM_CHECK(LiveText.load("ut_frozen_live.txt", true));
+        ASM_CHECK(ThawedText.load("ut_frozen_thawed.txt", true));
+        ASM_CHECK(trace(ThawedText, Probe) == trace(LiveText, Probe));
+        ASM_CHECK(unordered(trace(Thawed, Probe)) == unordered(Expected));
+    }
+}
+
+/*************************************************************************************************************/
+ASM_TEST(mergeIntoEmptyModel)
+{
+    std::vector<ColID_t> Inputs = patternSequences(20000);
+    std::vector<ColID_t> Probe = patternSequences(3000, 100, 20, 11);
+    clsASM Source(testConfigs());
+    Source.executeBulk(Inputs.data(), Inputs.size());
+
+    for (clsASM::enuMergePolicy Policy : {clsASM::MergeMax, clsASM::MergeSum, clsASM::MergeAverage}){
+        clsASM Target(testConfigs());
+        Target.merge(Source, Policy);
+        ASM_CHECK(Target.stats().Cells == Source.stats().Cells);
+        ASM_CHECK(unordered(trace(Target, Probe)) == unordered(trace(Source, Probe)));
+    }
+}
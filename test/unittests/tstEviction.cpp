@@ -0,0 +1,148 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014  S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ */
+
+#include <set>
+#include "testing.h"
+
+using namespace AdaptiveSequenceMemorizer;
+using namespace AdaptiveSequenceMemorizer::Testing;
+
+static std::set<ColID_t> predictedAfter(clsASM& _asm, ColID_t _input){
+    std::set<ColID_t> Predicted;
+    clsASM::Session Session;
+    _asm.executeOnce(Session, 0, clsASM::LearningFrozen);
+    for (const clsASM::stuPrediction& Prediction : _asm.executeOnce(Session, _input, clsASM::LearningFrozen))
+        Predicted.insert(Prediction.ColID);
+    return Predicted;
+}
+
+/*************************************************************************************************************/
+ASM_TEST(evictedCellsAreNotPredicted)
+{
+    //Each sequence adds a cell to column 1's successors so the budget evicts the oldest ones
+    clsASM ASM(testConfigs(64));
+    for (ColID_t ColID = 2; ColID < 200; ++ColID){
+        ASM.executeOnce(0);
+        ASM.executeOnce(1);
+        ASM.executeOnce(ColID);
+    }
+    clsASM::Stats Stats = ASM.stats();
+    ASM_CHECK(Stats.Cells <= 64);
+    ASM_CHECK(Stats.RemovedCells > 0);
+
+    std::set<ColID_t> Predicted = predictedAfter(ASM, 1);
+    ASM_CHECK(Predicted.size() < Stats.Cells);
+    //Columns learnt first are the ones evicted
+    ASM_CHECK(Predicted.count(2) == 0);
+    ASM_CHECK(Predicted.count(199) == 1);
+
+    //Cells evicted after a session has been positioned are not followed by paths ahead either
+    clsASM::Session Session;
+    ASM.executeOnce(Session, 0, clsASM::LearningFrozen);
+    ASM.executeOnce(Session, 1, clsASM::LearningFrozen);
+    for (ColID_t ColID = 200; ColID < 205; ++ColID){
+        ASM.executeOnce(0);
+        ASM.executeOnce(1);
+        ASM.executeOnce(ColID);
+    }
+    Predicted = predictedAfter(ASM, 1);
+    std::set<ColID_t> Followed;
+    for (const clsASM::stuPathPrediction& Path : ASM.predictAhead(Session, 1, 1000))
+        Followed.insert(Path.ColIDs[0]);
+    ASM_CHECK(Followed.size() > 0);
+    ASM_CHECK(Followed.size() < Predicted.size());
+    ASM_CHECK(std::includes(Predicted.begin(), Predicted.end(), Followed.begin(), Followed.end()));
+
+    //Tombstoned cells predict the same as the compacted model
+    ASM.compact();
+    ASM_CHECK(ASM.stats().RemovedCells == 0);
+    ASM_CHECK(predictedAfter(ASM, 1) == Predicted);
+}
+
+/*************************************************************************************************************/
+ASM_TEST(punishedCellKeepsLearntSuffix)
+{
+    clsASM ASM(testConfigs());
+    for (size_t i = 0; i < 10; ++i)
+        for (ColID_t ColID : {0, 1, 2, 3, 4, 5})
+            ASM.executeOnce(ColID);
+    ASM_CHECK(predictedAfter(ASM, 3).count(4) == 1);
+    ASM_CHECK(predictedAfter(ASM, 4).count(5) == 1);
+
+    //Step 2 is punished after step 1 until it's cell is removed, cells of the first sequences predicted after
+    //step 1 are removed too
+    clsASM::Session Session;
+    ASM.executeOnce(Session, 0);
+    ASM.executeOnce(Session, 1);
+    for (size_t i = 0; i < clsASM::maxPermanence(); ++i)
+        ASM.feedback(Session, 0, -2);
+    ASM_CHECK(predictedAfter(ASM, 1).count(2) == 0);
+    size_t Cells = ASM.stats().Cells;
+    ASM.compact();
+
+    //Just the punished cells are removed and the steps learnt after them are still predicted
+    ASM_CHECK(ASM.stats().Cells == Cells);
+    ASM_CHECK(predictedAfter(ASM, 3).count(4) == 1);
+    ASM_CHECK(predictedAfter(ASM, 4).count(5) == 1);
+}
+
+/*************************************************************************************************************/
+ASM_TEST(learntStepIsNotEvicted)
+{
+    //On such a small budget the cell a new step is connected to is often the best eviction candidate
+    clsASM ASM(testConfigs(4));
+    std::vector<ColID_t> Inputs = patternSequences(3000, 20, 5);
+    for (size_t i = 1; i < Inputs.size(); ++i){
+        if (Inputs[i - 1] == 0 || Inputs[i] == 0)
+            continue;
+        ASM.executeOnce(0);
+        ASM.executeOnce(Inputs[i - 1]);
+        ASM.executeOnce(Inputs[i]);
+        ASM_CHECK(predictedAfter(ASM, Inputs[i - 1]).count(Inputs[i]) == 1);
+    }
+}
+
+/*************************************************************************************************************/
+ASM_TEST(removedPredictionIsSkipped)
+{
+    //Column 1 has two cells both predicting column 2, the older one with a weaker connection
+    clsASM::Configs Configs = testConfigs();
+    Configs.PermanenceDecVal = scaled(250);
+    clsASM ASM(Configs);
+    for (ColID_t ColID : {0, 1, 2})
+        ASM.executeOnce(ColID);
+    for (size_t i = 0; i < 10; ++i)
+        for (ColID_t ColID : {0, 3, 1, 2})
+            ASM.executeOnce(ColID);
+
+    //Punishment removes the weaker cell while the stronger one is still predicted
+    clsASM::Session Session;
+    ASM.executeOnce(Session, 0);
+    ASM.executeOnce(Session, 1);
+    ASM.feedback(Session, 0, -2);
+    ASM_CHECK(ASM.stats().RemovedCells == 1);
+
+    //Step is a hit on the remaining cell so nothing new is learnt
+    size_t Cells = ASM.stats().Cells;
+    ASM.executeOnce(Session, 2);
+    ASM_CHECK(ASM.stats().Cells == Cells);
+}
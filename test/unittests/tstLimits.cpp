@@ -0,0 +1,68 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014  S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ */
+
+#include "testing.h"
+
+using namespace AdaptiveSequenceMemorizer;
+using namespace AdaptiveSequenceMemorizer::Testing;
+
+/*************************************************************************************************************/
+ASM_TEST(configsBeyondBuildLimitsAreRejected)
+{
+    Permanence_t MaxPermanence = clsASM::maxPermanence();
+    clsASM Fitting(clsASM::Configs(MaxPermanence, MaxPermanence, MaxPermanence, MaxPermanence));
+    bool Rejected = false;
+    try{
+        clsASM Exceeding(clsASM::Configs(MaxPermanence + 1, MaxPermanence));
+    }catch(std::logic_error&){
+        Rejected = true;
+    }
+    ASM_CHECK(Rejected);
+
+    if (clsASM::maxColID() < NOT_ASSIGNED - 1){
+        Rejected = false;
+        try{
+            Fitting.executeOnce(clsASM::maxColID() + 1);
+        }catch(std::logic_error&){
+            Rejected = true;
+        }
+        ASM_CHECK(Rejected);
+    }
+}
+
+/*************************************************************************************************************/
+ASM_TEST(rewardNeverLowersPermanence)
+{
+    //Initial permanence close to the limit so rewards saturate
+    Permanence_t MaxPermanence = clsASM::maxPermanence();
+    clsASM ASM(clsASM::Configs(MaxPermanence - 10, MaxPermanence / 2, 20, 1));
+    std::vector<ColID_t> Sequence = {0, 1, 2};
+    Permanence_t Previous = 0;
+    for (int i = 0; i < 4; ++i){
+        ASM.executeBulk(Sequence.data(), Sequence.size());
+        Trace_t Trace = trace(ASM, {0, 1});
+        ASM_CHECK(Trace.size() == 3 && Trace[1].first == 2);
+        ASM_CHECK(Trace[1].second >= Previous);
+        Previous = Trace[1].second;
+    }
+    ASM_CHECK(Previous == MaxPermanence);
+}
@@ -0,0 +1,232 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014  S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ */
+
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include "testing.h"
+
+using namespace AdaptiveSequenceMemorizer;
+using namespace AdaptiveSequenceMemorizer::Testing;
+
+static std::string readFile(const char* _filePath){
+    std::ifstream File(_filePath, std::ios::binary);
+    std::stringstream Content;
+    Content<<File.rdbuf();
+    return Content.str();
+}
+
+/*************************************************************************************************************/
+ASM_TEST(textBinaryAndMappedLoadsMatch)
+{
+    std::vector<ColID_t> Inputs = patternSequences(20000);
+    std::vector<ColID_t> Probe = patternSequences(3000, 100, 20, 11);
+    clsASM Live(testConfigs());
+    learn(Live, Inputs);
+    Trace_t Expected = trace(Live, Probe);
+    ASM_CHECK(Expected.size() > Probe.size());
+
+    ASM_CHECK(Live.save("ut_model.txt"));
+    ASM_CHECK(Live.save("ut_model.bin", clsASM::FormatBinary));
+
+    clsASM FromText(testConfigs()), FromBinary(testConfigs()), Mapped(testConfigs());
+    ASM_CHECK(FromText.load("ut_model.txt", true));
+    ASM_CHECK(FromBinary.load("ut_model.bin", true));
+    ASM_CHECK(Mapped.load("ut_model.bin", true, clsASM::LoadMapped));
+    ASM_CHECK(unordered(trace(FromText, Probe)) == unordered(Expected));
+    ASM_CHECK(trace(FromBinary, Probe) == Expected);
+    ASM_CHECK(trace(Mapped, Probe) == Expected);
+
+    //Saving a loaded model reproduces the same file
+    ASM_CHECK(FromBinary.save("ut_model2.txt"));
+    ASM_CHECK(Mapped.save("ut_model3.txt"));
+    ASM_CHECK(readFile("ut_model.txt") == readFile("ut_model2.txt"));
+    ASM_CHECK(readFile("ut_model.txt") == readFile("ut_model3.txt"));
+}
+
+/*************************************************************************************************************/
+ASM_TEST(saveReplacesMappedFile)
+{
+    std::vector<ColID_t> Inputs = patternSequences(20000);
+    std::vector<ColID_t> Probe = patternSequences(3000, 100, 20, 11);
+    clsASM Live(testConfigs());
+    learn(Live, Inputs, 0, 10000);
+    ASM_CHECK(Live.save("ut_replaced.bin", clsASM::FormatBinary));
+    clsASM Mapped(testConfigs());
+    ASM_CHECK(Mapped.load("ut_replaced.bin", true, clsASM::LoadMapped));
+    Trace_t Expected = trace(Mapped, Probe);
+
+    //Mapped pages of the old file stay valid while it is overwritten by a larger or a smaller model
+    learn(Live, Inputs, 10000);
+    ASM_CHECK(Live.save("ut_replaced.bin", clsASM::FormatBinary));
+    ASM_CHECK(trace(Mapped, Probe) == Expected);
+    clsASM Empty(testConfigs());
+    ASM_CHECK(Empty.save("ut_replaced.bin", clsASM::FormatBinary));
+    ASM_CHECK(trace(Mapped, Probe) == Expected);
+
+    clsASM Reloaded(testConfigs());
+    ASM_CHECK(Reloaded.load("ut_replaced.bin", true, clsASM::LoadMapped));
+    ASM_CHECK(Reloaded.stats().Cells == 0);
+}
+
+/*************************************************************************************************************/
+ASM_TEST(checkpointReplayMatchesLive)
+{
+    std::vector<ColID_t> Inputs = patternSequences(30000);
+    std::vector<ColID_t> Probe = patternSequences(3000, 100, 20, 11);
+    clsASM Live(testConfigs());
+    Live.executeBulk(Inputs.data(), 10000);
+    ASM_CHECK(Live.checkpoint("ut_checkpoint.bin"));
+    Live.executeBulk(Inputs.data() + 10000, 10000);
+    ASM_CHECK(Live.checkpoint("ut_checkpoint.bin"));
+    Live.executeBulk(Inputs.data() + 20000, 10000);
+    ASM_CHECK(Live.checkpoint("ut_checkpoint.bin"));
+
+    clsASM Replayed(testConfigs());
+    ASM_CHECK(Replayed.load("ut_checkpoint.bin", true));
+    ASM_CHECK(trace(Replayed, Probe) == trace(Live, Probe));
+    ASM_CHECK(Replayed.stats().Cells == Live.stats().Cells);
+}
+
+/*************************************************************************************************************/
+ASM_TEST(saveAsyncWritesPointInTimeCopy)
+{
+    std::vector<ColID_t> Inputs = patternSequences(30000);
+    std::vector<ColID_t> Probe = patternSequences(3000, 100, 20, 11);
+    clsASM Live(testConfigs()), AtCall(testConfigs());
+    Live.executeBulk(Inputs.data(), 10000);
+    AtCall.executeBulk(Inputs.data(), 10000);
+
+    std::atomic<int> Done(-1);
+    std::future<bool> Saved = Live.saveAsync("ut_async.bin", clsASM::FormatBinary,
+                                             [&Done](bool _result){ Done = _result; });
+    //Model keeps learning while the copy is written
+    Live.executeBulk(Inputs.data() + 10000, 20000);
+    ASM_CHECK(Saved.get());
+    ASM_CHECK(Done == 1);
+    ASM_CHECK(Live.stats().Cells > AtCall.stats().Cells);
+
+    ASM_CHECK(AtCall.save("ut_sync.bin", clsASM::FormatBinary));
+    ASM_CHECK(readFile("ut_async.bin") == readFile("ut_sync.bin"));
+    clsASM Loaded(testConfigs());
+    ASM_CHECK(Loaded.load("ut_async.bin", true));
+    ASM_CHECK(trace(Loaded, Probe) == trace(AtCall, Probe));
+}
+
+/*************************************************************************************************************/
+ASM_TEST(recoverMatchesLive)
+{
+    std::vector<ColID_t> Inputs = patternSequences(30000);
+    std::vector<ColID_t> Probe = patternSequences(3000, 100, 20, 11);
+    clsASM Live(testConfigs());
+    Live.executeBulk(Inputs.data(), 10000);
+    ASM_CHECK(Live.startWAL("ut_wal.bin", "ut_wal.log"));
+    Live.executeBulk(Inputs.data() + 10000, 10000);
+    for (size_t i = 20000; i < Inputs.size(); ++i)
+        Live.executeOnce(Inputs[i]);
+    Live.feedback(0, -1);
+    ASM_CHECK(Live.commitWAL());
+
+    clsASM Recovered(testConfigs());
+    ASM_CHECK(Recovered.recover("ut_wal.bin", "ut_wal.log", true));
+    ASM_CHECK(Live.stopWAL());
+    ASM_CHECK(trace(Recovered, Probe) == trace(Live, Probe));
+    ASM_CHECK(Recovered.stats().Cells == Live.stats().Cells);
+}
+
+/*************************************************************************************************************/
+ASM_TEST(recoverRepeatsScheduledSweeps)
+{
+    std::vector<ColID_t> Inputs = patternSequences(30000);
+    std::vector<ColID_t> Probe = patternSequences(3000, 100, 20, 11);
+    clsASM::Configs Configs = testConfigs();
+    Configs.MaintenanceInterval = 1000;
+    Configs.MaintenanceDecay = scaled(20);
+    clsASM Live(Configs);
+    Live.executeBulk(Inputs.data(), 10000);
+    ASM_CHECK(Live.startWAL("ut_wal_sweeps.bin", "ut_wal_sweeps.log"));
+    Live.executeBulk(Inputs.data() + 10000, 20000);
+    ASM_CHECK(Live.stopWAL());
+
+    clsASM Recovered(Configs);
+    ASM_CHECK(Recovered.recover("ut_wal_sweeps.bin", "ut_wal_sweeps.log", true));
+    ASM_CHECK(trace(Recovered, Probe) == trace(Live, Probe));
+
+    //Sweeps are not repeated by a model with other configs so it's WAL is rejected
+    Configs.MaintenanceDecay = scaled(10);
+    clsASM OtherDecay(Configs);
+    ASM_CHECK(OtherDecay.recover("ut_wal_sweeps.bin", "ut_wal_sweeps.log") == false);
+    clsASM Unscheduled(testConfigs());
+    ASM_CHECK(Unscheduled.recover("ut_wal_sweeps.bin", "ut_wal_sweeps.log") == false);
+}
+
+/*************************************************************************************************************/
+ASM_TEST(walOfAnotherSnapshotIsRejected)
+{
+    std::vector<ColID_t> Inputs = patternSequences(20000);
+    clsASM Live(testConfigs());
+    Live.executeBulk(Inputs.data(), 10000);
+    ASM_CHECK(Live.startWAL("ut_wal_pair.bin", "ut_wal_pair.log"));
+    Live.executeBulk(Inputs.data(), 10000, clsASM::AwardAndPunishment);
+    ASM_CHECK(Live.commitWAL());
+
+    //A crash after the next snapshot has replaced the previous one leaves the previous WAL. Inputs just changed
+    //permanences so the snapshot has the same size
+    std::string Previous = readFile("ut_wal_pair.bin");
+    ASM_CHECK(Live.save("ut_wal_pair.bin", clsASM::FormatBinary));
+    ASM_CHECK(readFile("ut_wal_pair.bin").size() == Previous.size());
+    ASM_CHECK(readFile("ut_wal_pair.bin") != Previous);
+
+    clsASM Recovered(testConfigs());
+    ASM_CHECK(Recovered.recover("ut_wal_pair.bin", "ut_wal_pair.log") == false);
+    ASM_CHECK(Live.stopWAL());
+}
+
+/*************************************************************************************************************/
+ASM_TEST(checkpointAfterMaintenanceWritesBase)
+{
+    std::vector<ColID_t> Inputs = patternSequences(20000);
+    std::vector<ColID_t> Probe = patternSequences(3000, 100, 20, 11);
+    clsASM Live(testConfigs());
+    Live.executeBulk(Inputs.data(), 19000);
+    ASM_CHECK(Live.checkpoint("ut_maintained.bin"));
+    size_t EmptyJournal = readFile("ut_maintained.bin.journal").size();
+    Live.executeBulk(Inputs.data() + 19000, 1000);
+    ASM_CHECK(Live.checkpoint("ut_maintained.bin"));
+    ASM_CHECK(readFile("ut_maintained.bin.journal").size() > EmptyJournal);
+
+    //Decayed cells are not journaled so the base is written again
+    Live.maintain(1);
+    ASM_CHECK(Live.checkpoint("ut_maintained.bin"));
+    ASM_CHECK(readFile("ut_maintained.bin.journal").size() == EmptyJournal);
+
+    //Changes made after the new base are journaled again
+    Live.executeBulk(Inputs.data(), 1000);
+    ASM_CHECK(Live.checkpoint("ut_maintained.bin"));
+    ASM_CHECK(readFile("ut_maintained.bin.journal").size() > EmptyJournal);
+
+    clsASM Replayed(testConfigs());
+    ASM_CHECK(Replayed.load("ut_maintained.bin", true));
+    //Journaled cells are added column by column so successors may be predicted in another order
+    ASM_CHECK(unordered(trace(Replayed, Probe)) == unordered(trace(Live, Probe)));
+    ASM_CHECK(Replayed.stats().Cells == Live.stats().Cells);
+}
@@ -0,0 +1,90 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014  S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ */
+
+#include "testing.h"
+
+using namespace AdaptiveSequenceMemorizer;
+using namespace AdaptiveSequenceMemorizer::Testing;
+
+static std::vector<ColID_t> pathColIDs(const clsASM::stuPathPrediction& _path){
+    return std::vector<ColID_t>(_path.ColIDs, _path.ColIDs + _path.Length);
+}
+
+/*************************************************************************************************************/
+ASM_TEST(predictAheadFollowsBestPaths)
+{
+    //Column 1 is followed by three branches of different lengths. Each sequence adds one step to a branch and
+    //the longer branches are seen more so they are stronger
+    clsASM ASM(testConfigs());
+    std::vector<ColID_t> Inputs = {0, 1, 2, 0, 1, 2, 3, 0, 1, 2, 3, 4, 0, 1, 2, 3, 4, 5,
+                                   0, 1, 6, 0, 1, 6, 7,
+                                   0, 1, 8,
+                                   0, 1, 2, 3, 4, 5, 0, 1, 6, 7, 0, 1, 2, 3, 4, 5};
+    learn(ASM, Inputs);
+
+    clsASM::Session Session;
+    ASM.executeOnce(Session, 0, clsASM::LearningFrozen);
+    ASM.executeOnce(Session, 1, clsASM::LearningFrozen);
+    clsASM::PredictionSpan Predictions = Session.predictionSpan();
+    ASM_CHECK(Predictions.size() == 3);
+
+    //Single step paths are the predictions of the session ordered by permanence
+    clsASM::PathPredictionSpan Paths = ASM.predictAhead(Session, 1, 10);
+    ASM_CHECK(Paths.size() == 3);
+    ASM_CHECK(pathColIDs(Paths[0]) == std::vector<ColID_t>({2}));
+    ASM_CHECK(pathColIDs(Paths[1]) == std::vector<ColID_t>({6}));
+    ASM_CHECK(pathColIDs(Paths[2]) == std::vector<ColID_t>({8}));
+    for (const clsASM::stuPathPrediction& Path : Paths)
+        for (const clsASM::stuPrediction& Prediction : Predictions)
+            if (Prediction.ColID == Path.ColIDs[0])
+                ASM_CHECK(Prediction.PathPermanence == Path.PathPermanence);
+    ASM_CHECK(Paths[0].PathPermanence > Paths[1].PathPermanence);
+    ASM_CHECK(Paths[1].PathPermanence > Paths[2].PathPermanence);
+
+    //Paths stop at the requested depth or where a branch ends
+    Paths = ASM.predictAhead(Session, 3, 10);
+    ASM_CHECK(Paths.size() == 3);
+    ASM_CHECK(pathColIDs(Paths[0]) == std::vector<ColID_t>({2, 3, 4}));
+    ASM_CHECK(pathColIDs(Paths[1]) == std::vector<ColID_t>({6, 7}));
+    ASM_CHECK(pathColIDs(Paths[2]) == std::vector<ColID_t>({8}));
+    Paths = ASM.predictAhead(Session, 10, 10);
+    ASM_CHECK(pathColIDs(Paths[0]) == std::vector<ColID_t>({2, 3, 4, 5}));
+    for (size_t i = 1; i < Paths.size(); ++i)
+        ASM_CHECK(Paths[i - 1].PathPermanence >= Paths[i].PathPermanence);
+
+    //Narrow beams keep just the best partial paths
+    Paths = ASM.predictAhead(Session, 10, 2);
+    ASM_CHECK(Paths.size() == 2);
+    ASM_CHECK(pathColIDs(Paths[0]) == std::vector<ColID_t>({2, 3, 4, 5}));
+    ASM_CHECK(pathColIDs(Paths[1]) == std::vector<ColID_t>({6, 7}));
+    Paths = ASM.predictAhead(Session, 10, 1);
+    ASM_CHECK(Paths.size() == 1);
+    ASM_CHECK(pathColIDs(Paths[0]) == std::vector<ColID_t>({2, 3, 4, 5}));
+    ASM_CHECK(ASM.predictAhead(Session, 0, 10).empty());
+    ASM_CHECK(ASM.predictAhead(Session, 10, 0).empty());
+
+    //Session is not moved
+    ASM_CHECK(Session.predictionSpan().size() == 3);
+    ASM.executeOnce(Session, 2, clsASM::LearningFrozen);
+    ASM_CHECK(Session.predictionSpan().size() == 1);
+    ASM_CHECK(Session.predictionSpan()[0].ColID == 3);
+}
@@ -0,0 +1,66 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014  S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ */
+
+#include "testing.h"
+
+using namespace AdaptiveSequenceMemorizer;
+using namespace AdaptiveSequenceMemorizer::Testing;
+
+static void appendStep(Trace_t& _trace, const clsASM::Prediction_t& _predictions){
+    for (const clsASM::stuPrediction& Prediction : _predictions)
+        _trace.push_back(std::make_pair(Prediction.ColID, Prediction.PathPermanence));
+    _trace.push_back(std::make_pair(NOT_ASSIGNED, (Permanence_t)0));
+}
+
+/*************************************************************************************************************/
+ASM_TEST(interleavedSessionsAreIsolated)
+{
+    std::vector<ColID_t> Inputs = patternSequences(20000);
+    std::vector<ColID_t> ProbeA = patternSequences(3000, 100, 20, 11);
+    std::vector<ColID_t> ProbeB = patternSequences(3000, 100, 20, 13);
+    clsASM ASM(testConfigs());
+    learn(ASM, Inputs);
+    Trace_t ExpectedA = trace(ASM, ProbeA);
+    Trace_t ExpectedB = trace(ASM, ProbeB);
+
+    //Default session is left in the middle of a sequence
+    ASM.executeOnce(0, clsASM::LearningFrozen);
+    ASM.executeOnce(Inputs[1], clsASM::LearningFrozen);
+    Trace_t ExpectedDefault;
+    appendStep(ExpectedDefault, ASM.executeOnce(Inputs[2], clsASM::LearningFrozen));
+    ASM_CHECK(ExpectedDefault.size() > 1);
+    ASM.executeOnce(0, clsASM::LearningFrozen);
+    ASM.executeOnce(Inputs[1], clsASM::LearningFrozen);
+
+    clsASM::Session SessionA, SessionB;
+    Trace_t ActualA, ActualB;
+    for (size_t i = 0; i < ProbeA.size(); ++i){
+        appendStep(ActualA, ASM.executeOnce(SessionA, ProbeA[i], clsASM::LearningFrozen));
+        appendStep(ActualB, ASM.executeOnce(SessionB, ProbeB[i], clsASM::LearningFrozen));
+    }
+    ASM_CHECK(ActualA == ExpectedA);
+    ASM_CHECK(ActualB == ExpectedB);
+
+    Trace_t ActualDefault;
+    appendStep(ActualDefault, ASM.executeOnce(Inputs[2], clsASM::LearningFrozen));
+    ASM_CHECK(ActualDefault == ExpectedDefault);
+}
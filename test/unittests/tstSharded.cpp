@@ -0,0 +1,67 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014  S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ */
+
+#include "clsShardedASM.h"
+#include "testing.h"
+
+using namespace AdaptiveSequenceMemorizer;
+using namespace AdaptiveSequenceMemorizer::Testing;
+
+template <typename Fn_t>
+static bool throws(Fn_t _fn){
+    try{
+        _fn();
+    }catch(std::logic_error&){
+        return true;
+    }
+    return false;
+}
+
+/*************************************************************************************************************/
+ASM_TEST(failedBatchesAreReportedOnce)
+{
+    clsShardedASM Sharded(2, testConfigs());
+    size_t Called = 0;
+    clsShardedASM::Stream Stream(Sharded, [&Called](ColID_t _input, const clsASM::PredictionSpan&){
+        Called++;
+        if (_input == 13 && Called < 5)
+            throw std::logic_error("Failed on purpose");
+    });
+
+    std::vector<ColID_t> Inputs = {0, 5, 13, 7, 0, 6, 8, 0};
+    Sharded.executeBulk(Stream, Inputs.data(), Inputs.size());
+    ASM_CHECK(throws([&Stream](){ Stream.wait(); }));
+    ASM_CHECK(throws([&Stream](){ Stream.wait(); }) == false);
+    ASM_CHECK(throws([&Sharded](){ Sharded.flush(); }));
+    ASM_CHECK(throws([&Sharded](){ Sharded.flush(); }) == false);
+    //Input following the failed one has been dropped while the next sequence has been executed
+    ASM_CHECK(Called == 4);
+
+    //Workers go on with the next inputs
+    Sharded.executeBulk(Stream, Inputs.data(), Inputs.size());
+    ASM_CHECK(throws([&Stream](){ Stream.wait(); }) == false);
+    ASM_CHECK(Called == 9);
+    uint64_t Cells = 0;
+    for (uint32_t Shard = 0; Shard < Sharded.shardCount(); ++Shard)
+        Cells += Sharded.stats(Shard).Cells;
+    ASM_CHECK(Cells > 0);
+}
@@ -0,0 +1,49 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014  S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ */
+
+#include <memory>
+#include "testing.h"
+
+using namespace AdaptiveSequenceMemorizer;
+using namespace AdaptiveSequenceMemorizer::Testing;
+
+/*************************************************************************************************************/
+ASM_TEST(interleavedModelsCountTheirOwnSteps)
+{
+    //More models than a thread caches counters of
+    std::vector<std::unique_ptr<clsASM>> Models;
+    for (size_t i = 0; i < 12; ++i)
+        Models.emplace_back(new clsASM(testConfigs()));
+    std::vector<ColID_t> Inputs = patternSequences(2000);
+    for (size_t i = 0; i < Inputs.size(); ++i)
+        for (size_t Model = 0; Model <= i % Models.size(); ++Model)
+            Models[Model]->executeOnce(Inputs[i]);
+
+    //Counters are all zero on builds without ASM_STATS
+    bool Counting = Models.front()->stats().Steps[clsASM::LearningFull] != 0;
+    for (size_t Model = 0; Model < Models.size(); ++Model){
+        uint64_t Executed = 0;
+        for (size_t i = 0; i < Inputs.size(); ++i)
+            Executed += Inputs[i] && Model <= i % Models.size();
+        ASM_CHECK(Models[Model]->stats().Steps[clsASM::LearningFull] == (Counting ? Executed : 0));
+    }
+}
@@ -0,0 +1,69 @@
+/*************************************************************************
+ * ASM : An Adaptive Sequence Memorizer
+ * Copyright (C) 2013-2014  S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *************************************************************************/
+/**
+ @author S.Mohammad M. Ziabary <mehran.m@aut.ac.ir>
+ */
+
+#include "testing.h"
+
+using namespace AdaptiveSequenceMemorizer;
+using namespace AdaptiveSequenceMemorizer::Testing;
+
+/**
+ * @brief steps splits a trace to predictions of each step
+ */
+static std::vector<Trace_t> steps(const Trace_t& _trace){
+    std::vector<Trace_t> Steps(1);
+    for (const auto& Item : _trace)
+        if (Item.first == NOT_ASSIGNED)
+            Steps.push_back(Trace_t());
+        else
+            Steps.back().push_back(Item);
+    Steps.pop_back();
+    return Steps;
+}
+
+/*************************************************************************************************************/
+ASM_TEST(topPredictionsAreTheBestOnes)
+{
+    //A small alphabet with noise makes a large fan-out with different permanence values
+    std::vector<ColID_t> Inputs = patternSequences(20000, 30, 40);
+    std::vector<ColID_t> Probe = patternSequences(3000, 30, 40, 11);
+    const uint32_t K = 3;
+    clsASM All(testConfigs()), Top(testConfigs(0, K));
+    All.executeBulk(Inputs.data(), Inputs.size());
+    Top.executeBulk(Inputs.data(), Inputs.size());
+
+    std::vector<Trace_t> AllSteps = steps(trace(All, Probe));
+    std::vector<Trace_t> TopSteps = steps(trace(Top, Probe));
+    ASM_CHECK(AllSteps.size() == Probe.size() && TopSteps.size() == Probe.size());
+    size_t Truncated = 0;
+    for (size_t i = 0; i < Probe.size(); ++i){
+        Trace_t Best = AllSteps[i];
+        std::sort(Best.begin(), Best.end(), [](const Trace_t::value_type& _a, const Trace_t::value_type& _b){
+            return _a.second > _b.second || (_a.second == _b.second && _a.first < _b.first);
+        });
+        if (Best.size() > K){
+            Best.resize(K);
+            Truncated++;
+        }
+        ASM_CHECK(TopSteps[i] == Best);
+    }
+    ASM_CHECK(Truncated > Probe.size() / 10);
+}